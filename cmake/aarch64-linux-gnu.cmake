@@ -0,0 +1,30 @@
+# Cross toolchain for the host tools on aarch64 Linux (glibc), e.g. to run
+# hook_bench on an x86 box under qemu-aarch64 user mode:
+#
+#   apt install g++-aarch64-linux-gnu qemu-user
+#   cmake -S . -B build-a64 -DCMAKE_TOOLCHAIN_FILE=cmake/aarch64-linux-gnu.cmake
+#   cmake --build build-a64 --target bench_hooks
+#
+# Override SFROTATE_A64_SYSROOT if the target libraries live elsewhere.
+
+set(CMAKE_SYSTEM_NAME Linux)
+set(CMAKE_SYSTEM_PROCESSOR aarch64)
+
+set(SFROTATE_A64_PREFIX aarch64-linux-gnu- CACHE STRING "aarch64 cross compiler prefix")
+set(SFROTATE_A64_SYSROOT /usr/aarch64-linux-gnu CACHE PATH "aarch64 target libraries, for qemu")
+
+set(CMAKE_C_COMPILER ${SFROTATE_A64_PREFIX}gcc)
+set(CMAKE_CXX_COMPILER ${SFROTATE_A64_PREFIX}g++)
+set(CMAKE_ASM_COMPILER ${SFROTATE_A64_PREFIX}gcc)
+
+set(CMAKE_FIND_ROOT_PATH ${SFROTATE_A64_SYSROOT})
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_PACKAGE ONLY)
+
+# custom targets that run a built tool go through qemu when the host can't
+# run it
+if (NOT CMAKE_HOST_SYSTEM_PROCESSOR MATCHES "^(aarch64|arm64)")
+  set(CMAKE_CROSSCOMPILING_EMULATOR qemu-aarch64 -L ${SFROTATE_A64_SYSROOT})
+endif()
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Strips a stand-in surfaceflinger the way Android strips the real one: the
+# given symbols go into an XZ-compressed mini ELF in .gnu_debugdata, and
+# .symtab and debug info are removed.
+#
+# usage: add_gnu_debugdata.sh <objcopy> <xz> <in> <out> <symbol>...
+
+set -e
+
+if [ $# -lt 5 ]; then
+  echo "usage: $0 <objcopy> <xz> <in> <out> <symbol>..." >&2
+  exit 1
+fi
+
+OBJCOPY=$1
+XZ=$2
+IN=$3
+OUT=$4
+shift 4
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+for sym in "$@"; do
+  echo "$sym"
+done > "$TMP/keep_symbols"
+
+# mini debuginfo: section headers plus .symtab/.strtab with only the kept
+# symbols
+"$OBJCOPY" --only-keep-debug "$IN" "$TMP/mini_debuginfo"
+"$OBJCOPY" -S --remove-section .gdb_index --remove-section .comment \
+  --keep-symbols="$TMP/keep_symbols" "$TMP/mini_debuginfo"
+"$XZ" --check=crc64 -f "$TMP/mini_debuginfo"
+
+"$OBJCOPY" --strip-all "$IN" "$TMP/stripped"
+"$OBJCOPY" --add-section .gnu_debugdata="$TMP/mini_debuginfo.xz" "$TMP/stripped" "$OUT"
@@ -0,0 +1,353 @@
+// End-to-end injection harness: starts fake_surfaceflinger, injects
+// libsf_rotate.so into it with dlopen64 and watches the frame loop.
+//
+// Usage (as root, on an arm64 device or emulator):
+//   sfrotate_e2e [--runs N] [--expect T] [--timeout-ms N]
+//                <fake_surfaceflinger> <dlopen64> <libsf_rotate.so>
+//
+// For each run it reports:
+//  - time to hooked: dlopen64 start until the frame loop first sees the
+//    forced isSupported() and the expected Transform
+//  - dlopen64's own wall time and exit status
+//  - the longest frame-loop iteration, i.e. the hiccup the injection caused
+//  - the stop window dlopen64 reports, from PTRACE_INTERRUPT to detach
+// and checks that every Transform the loop saw after hooking is the
+// expected one, and that dlopen64's per-phase stop times add up to its
+// stop window. A last run passes dlopen64 a budget no injection can meet
+// (--budget-ms 0.001): it must still hook, and exit with status 13. T defaults to what persist.panel.rds.orientation asks for
+// (270 if unset); per-display overrides are not taken into account.
+//
+// SFROTATE_SF_BIN points the injector and the library at the stand-in.
+// SFROTATE_OFFSET_CACHE, SFROTATE_OFFSET_MANIFEST and SFROTATE_HANDOFF point
+// at files next to it, so a device's real cache, manifest and handoff are
+// neither read nor overwritten. The manifest does not exist: run 1 is cold,
+// later runs use the cache.
+//
+// Exits non-zero if any run fails.
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+// ui::Transform::RotationFlags, as returned by getPhysicalDisplayOrientation
+static int transform_for_degree(int degree) {
+  switch (degree) {
+    case 0: return 0;
+    case 90: return 4;
+    case 180: return 3;
+    case 270: return 7;
+    default: return -1;
+  }
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static double ms(uint64_t ns) { return (double)ns / 1e6; }
+
+// Line reader over the fake's stdout, with a deadline.
+struct LineReader {
+  int fd;
+  char buf[4096];
+  size_t len = 0;
+
+  explicit LineReader(int f) : fd(f) {}
+
+  // false on EOF or timeout
+  bool next(char* out, size_t cap, uint64_t deadline_ns) {
+    for (;;) {
+      char* nl = (char*)memchr(buf, '\n', len);
+      if (nl) {
+        size_t n = std::min((size_t)(nl - buf), cap - 1);
+        memcpy(out, buf, n);
+        out[n] = 0;
+        len -= (size_t)(nl - buf) + 1;
+        memmove(buf, nl + 1, len);
+        return true;
+      }
+      uint64_t now = now_ns();
+      if (now >= deadline_ns || len == sizeof(buf)) return false;
+      struct pollfd p = { fd, POLLIN, 0 };
+      int r = poll(&p, 1, (int)((deadline_ns - now) / 1000000) + 1);
+      if (r < 0 && errno == EINTR) continue;
+      if (r <= 0) return false;
+      ssize_t got = read(fd, buf + len, sizeof(buf) - len);
+      if (got <= 0) return false;
+      len += (size_t)got;
+    }
+  }
+};
+
+struct RunResult {
+  bool ok = false;
+  uint64_t hooked_ns = 0;   // dlopen64 start -> hooked
+  uint64_t injector_ns = 0; // dlopen64 wall time
+  uint64_t max_gap_ns = 0;
+  int injector_status = -1;
+  double window_ms = -1;    // dlopen64's stop window, -1 if not reported
+};
+
+// Check dlopen64's stop report (stdout):
+//   [*] stopped time per phase:
+//   [*]   <phase>                               <ms> ms
+//   [*]   stop window (interrupt to detach)     <ms> ms
+// The phases are consecutive intervals, so they must sum to the window up
+// to the rounding of the printed values.
+static bool check_phases(FILE* out, double* window_ms) {
+  static const char WINDOW[] = "stop window (interrupt to detach)";
+  char line[512];
+  bool in_report = false;
+  int nphases = 0;
+  double sum = 0;
+  rewind(out);
+  while (fgets(line, sizeof line, out)) {
+    if (strstr(line, "stopped time per phase:")) {
+      in_report = true;
+      nphases = 0;
+      sum = 0;
+      continue;
+    }
+    char* unit = strstr(line, " ms\n");
+    if (!in_report || strncmp(line, "[*]   ", 6) != 0 || !unit) continue;
+    *unit = 0;
+    char* num = strrchr(line, ' ');
+    const double v = num ? atof(num + 1) : -1;
+    if (v < 0) continue;
+    if (strstr(line, WINDOW)) {
+      *window_ms = v;
+      const double slack = 0.0005 * (nphases + 1) + 1e-9;
+      if (nphases == 0 || sum - v > slack || v - sum > slack) {
+        fprintf(stderr, "%d phases sum to %.3f ms, stop window is %.3f ms\n", nphases, sum, v);
+        return false;
+      }
+      return true;
+    }
+    sum += v;
+    nphases++;
+  }
+  fprintf(stderr, "dlopen64 printed no stop window\n");
+  return false;
+}
+
+static pid_t spawn(const char* const argv[], int stdout_fd) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (stdout_fd >= 0) {
+      dup2(stdout_fd, STDOUT_FILENO);
+    }
+    execv(argv[0], (char* const*)argv);
+    fprintf(stderr, "exec %s: %s\n", argv[0], strerror(errno));
+    _exit(127);
+  }
+  return pid;
+}
+
+// budget_ms > 0 is passed on as dlopen64 --budget-ms, expect_status is the
+// exit status dlopen64 must return.
+static RunResult run_once(const char* fake, const char* injector, const char* lib,
+                          int expect, uint64_t timeout_ns, const char* budget_ms,
+                          int expect_status) {
+  RunResult r;
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    return r;
+  }
+  const char* fake_argv[] = { fake, nullptr };
+  pid_t sf = spawn(fake_argv, fds[1]);
+  close(fds[1]);
+  if (sf < 0) {
+    close(fds[0]);
+    return r;
+  }
+
+  LineReader in(fds[0]);
+  char line[256];
+  bool started = in.next(line, sizeof line, now_ns() + timeout_ns) && line[0] == 'R';
+  // the loop's first change line (the unhooked values)
+  started = started && in.next(line, sizeof line, now_ns() + timeout_ns) && line[0] == 'T';
+  if (!started) {
+    fprintf(stderr, "fake surfaceflinger did not start\n");
+  }
+
+  bool hooked = false, wrong = false, phases_ok = false;
+  if (started) {
+    // let the frame loop settle before stopping it
+    usleep(100 * 1000);
+
+    char pid_arg[16];
+    snprintf(pid_arg, sizeof pid_arg, "%d", (int)sf);
+    const char* inj_argv[] = { injector, pid_arg, lib, nullptr, nullptr, nullptr };
+    if (budget_ms) {
+      inj_argv[1] = "--budget-ms";
+      inj_argv[2] = budget_ms;
+      inj_argv[3] = pid_arg;
+      inj_argv[4] = lib;
+    }
+    // its report goes to a file, read once it has exited
+    FILE* inj_out = tmpfile();
+    const uint64_t t0 = now_ns();
+    pid_t inj = inj_out ? spawn(inj_argv, fileno(inj_out)) : -1;
+
+    const uint64_t deadline = t0 + timeout_ns;
+    while (!hooked && in.next(line, sizeof line, deadline)) {
+      unsigned long long ts;
+      int supported, transform;
+      if (sscanf(line, "T %llu %d %d", &ts, &supported, &transform) != 3) continue;
+      // the hooks land one after another, the loop may see a mix for an
+      // iteration; only the final state has to match
+      if (supported && transform == expect) {
+        hooked = true;
+        r.hooked_ns = ts - t0;
+      }
+    }
+
+    int status = 0;
+    if (inj > 0 && waitpid(inj, &status, 0) == inj) {
+      r.injector_ns = now_ns() - t0;
+      r.injector_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    if (inj_out) {
+      phases_ok = check_phases(inj_out, &r.window_ms);
+      fclose(inj_out);
+    }
+  }
+
+  // stop the loop and collect its summary; any further T line is a change
+  // after hooking, which should not happen
+  kill(sf, SIGTERM);
+  const uint64_t deadline = now_ns() + timeout_ns;
+  while (in.next(line, sizeof line, deadline)) {
+    unsigned long long gap, at, frames;
+    if (line[0] == 'T') {
+      if (hooked) {
+        fprintf(stderr, "transform changed after hooking: %s\n", line);
+        wrong = true;
+      }
+    } else if (sscanf(line, "F %llu %llu %llu", &gap, &at, &frames) == 3) {
+      r.max_gap_ns = gap;
+    }
+  }
+  close(fds[0]);
+  waitpid(sf, nullptr, 0);
+
+  if (!hooked && !wrong) {
+    fprintf(stderr, "not hooked within %.0f ms\n", ms(timeout_ns));
+  }
+  r.ok = hooked && !wrong && phases_ok && r.injector_status == expect_status;
+  return r;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--runs N] [--expect T] [--timeout-ms N]\n"
+          "          <fake_surfaceflinger> <dlopen64> <libsf_rotate.so>\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  int runs = 3;
+  int expect = -1;
+  uint64_t timeout_ns = 5000ull * 1000000ull;
+  const char* paths[3];
+  int npaths = 0;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (a[0] != '-') {
+      if (npaths == 3) { usage(argv[0]); return 1; }
+      paths[npaths++] = a;
+      continue;
+    }
+    if (i + 1 >= argc) { usage(argv[0]); return 1; }
+    const char* v = argv[++i];
+    if (!strcmp(a, "--runs")) runs = atoi(v);
+    else if (!strcmp(a, "--expect")) expect = atoi(v);
+    else if (!strcmp(a, "--timeout-ms")) timeout_ns = strtoull(v, nullptr, 10) * 1000000ull;
+    else { usage(argv[0]); return 1; }
+  }
+  if (npaths != 3 || runs < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // maps and the library match surfaceflinger by absolute path
+  char fake[PATH_MAX], injector[PATH_MAX], lib[PATH_MAX];
+  if (!realpath(paths[0], fake) || !realpath(paths[1], injector) || !realpath(paths[2], lib)) {
+    perror("realpath");
+    return 1;
+  }
+
+  if (expect < 0) {
+    char v[PROP_VALUE_MAX] = {0};
+    int degree = __system_property_get("persist.panel.rds.orientation", v) > 0 ? atoi(v) : 270;
+    expect = transform_for_degree(degree);
+    if (expect <= 0) {
+      fprintf(stderr, "orientation %d would not change the transform, use --expect\n", degree);
+      return 1;
+    }
+  }
+
+  char cache[PATH_MAX + 8], manifest[PATH_MAX + 8], handoff[PATH_MAX + 8];
+  snprintf(cache, sizeof cache, "%s.cache", fake);
+  snprintf(manifest, sizeof manifest, "%s.offsets", fake);
+  snprintf(handoff, sizeof handoff, "%s.handoff", fake);
+  unlink(cache);
+  unlink(manifest);
+  unlink(handoff);
+  setenv("SFROTATE_SF_BIN", fake, 1);
+  setenv("SFROTATE_OFFSET_CACHE", cache, 1);
+  setenv("SFROTATE_OFFSET_MANIFEST", manifest, 1);
+  setenv("SFROTATE_HANDOFF", handoff, 1);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%-6s %12s %12s %12s %12s %s\n", "run", "hooked ms", "dlopen64 ms", "stopped ms",
+         "hiccup ms", "result");
+  std::vector<uint64_t> hooked, gaps;
+  bool ok = true;
+  // the runs, then one over budget (status 13), which is not in the medians
+  for (int i = 0; i <= runs; i++) {
+    const bool budget = i == runs;
+    RunResult r = run_once(fake, injector, lib, expect, timeout_ns, budget ? "0.001" : nullptr,
+                           budget ? 13 : 0);
+    char name[16];
+    if (budget) {
+      snprintf(name, sizeof name, "budget");
+    } else {
+      snprintf(name, sizeof name, "%d", i + 1);
+    }
+    printf("%-6s %12.3f %12.3f %12.3f %12.3f %s", name, ms(r.hooked_ns), ms(r.injector_ns),
+           r.window_ms, ms(r.max_gap_ns), r.ok ? "ok" : "FAIL");
+    if (r.injector_status != (budget ? 13 : 0)) {
+      printf(" (dlopen64 exit %d)", r.injector_status);
+    }
+    printf("\n");
+    ok = ok && r.ok;
+    if (r.ok && !budget) {
+      hooked.push_back(r.hooked_ns);
+      gaps.push_back(r.max_gap_ns);
+    }
+  }
+
+  if (!hooked.empty()) {
+    std::sort(hooked.begin(), hooked.end());
+    std::sort(gaps.begin(), gaps.end());
+    printf("median: hooked %.3f ms, hiccup %.3f ms (max %.3f ms)\n",
+           ms(hooked[hooked.size() / 2]), ms(gaps[gaps.size() / 2]), ms(gaps.back()));
+  }
+  unlink(cache);
+  unlink(handoff);
+  return ok ? 0 : 1;
+}
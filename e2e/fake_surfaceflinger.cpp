@@ -0,0 +1,140 @@
+// Stand-in surfaceflinger for the end-to-end injection harness.
+//
+// Defines the functions sfrotate hooks, with the same mangled names as the
+// real ones (the build moves them into .gnu_debugdata and strips the rest,
+// see add_gnu_debugdata.sh), and calls them in a tight loop like a
+// compositor's frame loop. Reports on stdout, one line per event:
+//
+//   R <ns>                  loop running
+//   T <ns> <supported> <t>  isSupported(PhysicalDisplayOrientation) or
+//                           getPhysicalDisplayOrientation() changed
+//   F <max_gap_ns> <at_ns> <frames>
+//                           on SIGTERM/SIGINT: longest loop iteration
+//                           (e.g. while ptrace-stopped) and when it ended
+//
+// Timestamps are CLOCK_MONOTONIC, so the harness can compare them with its
+// own.
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+namespace android {
+
+struct PhysicalDisplayId {
+  uint64_t value;
+};
+
+// volatile, so the compiler can't see what the hooked functions return
+static volatile bool g_hidl_supported[8];
+static volatile bool g_aidl_supported[8];
+static volatile int g_orientation; // ui::Transform::ROT_0
+
+namespace Hwc2 {
+
+class Composer {
+public:
+  enum class OptionalFeature : uint32_t {
+    RefreshRateSwitching = 0,
+    ExpectedPresentTime = 1,
+    DisplayBrightnessCommands = 2,
+    BootDisplayConfig = 3,
+    PhysicalDisplayOrientation = 4,
+  };
+};
+
+class HidlComposer {
+public:
+  __attribute__((noinline)) bool isSupported(Composer::OptionalFeature f) const;
+};
+
+class AidlComposer {
+public:
+  __attribute__((noinline)) bool isSupported(Composer::OptionalFeature f) const;
+};
+
+// separate tables, so the linker can't fold the two into one function
+bool HidlComposer::isSupported(Composer::OptionalFeature f) const {
+  return g_hidl_supported[(uint32_t)f & 7];
+}
+
+bool AidlComposer::isSupported(Composer::OptionalFeature f) const {
+  return g_aidl_supported[(uint32_t)f & 7];
+}
+
+} // namespace Hwc2
+
+namespace impl {
+
+class HWComposer {
+public:
+  __attribute__((noinline)) int getPhysicalDisplayOrientation(PhysicalDisplayId id) const;
+};
+
+int HWComposer::getPhysicalDisplayOrientation(PhysicalDisplayId) const {
+  return g_orientation;
+}
+
+} // namespace impl
+} // namespace android
+
+using namespace android;
+
+static volatile sig_atomic_t g_stop;
+
+static void on_stop(int) {
+  g_stop = 1;
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int main() {
+  signal(SIGTERM, on_stop);
+  signal(SIGINT, on_stop);
+
+  // called through volatile pointers, like the real compositor does via
+  // its HWComposer / Composer objects
+  Hwc2::HidlComposer hidl;
+  Hwc2::AidlComposer aidl;
+  impl::HWComposer hwc;
+  Hwc2::HidlComposer* volatile hidl_p = &hidl;
+  Hwc2::AidlComposer* volatile aidl_p = &aidl;
+  impl::HWComposer* volatile hwc_p = &hwc;
+  const PhysicalDisplayId display = { 0 };
+
+  uint64_t prev = now_ns();
+  uint64_t max_gap = 0, max_gap_at = 0, frames = 0;
+  int last_supported = -1, last_transform = -1;
+  printf("R %llu\n", (unsigned long long)prev);
+  fflush(stdout);
+
+  while (!g_stop) {
+    const uint64_t t = now_ns();
+    if (t - prev > max_gap) {
+      max_gap = t - prev;
+      max_gap_at = t;
+    }
+    prev = t;
+    frames++;
+
+    const auto feature = Hwc2::Composer::OptionalFeature::PhysicalDisplayOrientation;
+    const int supported = hidl_p->isSupported(feature) && aidl_p->isSupported(feature);
+    const int transform = hwc_p->getPhysicalDisplayOrientation(display);
+    if (supported != last_supported || transform != last_transform) {
+      printf("T %llu %d %d\n", (unsigned long long)now_ns(), supported, transform);
+      fflush(stdout);
+      last_supported = supported;
+      last_transform = transform;
+    }
+  }
+
+  printf("F %llu %llu %llu\n", (unsigned long long)max_gap, (unsigned long long)max_gap_at,
+         (unsigned long long)frames);
+  fflush(stdout);
+  return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// C versions of the ACLE CRC32 intrinsics xz_crc_arm64.c uses, for building
+// it on a host that is not arm64 (XZ_CRC_ARM64_HOST, see crc_bench.cpp). Bit
+// by bit, as the architecture defines CRC32B / CRC32X: reflected IEEE
+// polynomial, no inversion in or out.
+
+#include <stdint.h>
+
+static inline uint32_t __crc32b(uint32_t crc, uint8_t v) {
+  crc ^= v;
+  for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  return crc;
+}
+
+static inline uint32_t __crc32d(uint32_t crc, uint64_t v) {
+  for (int i = 0; i < 8; i++) crc = __crc32b(crc, (uint8_t)(v >> (8 * i)));
+  return crc;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// C versions of the NEON types and intrinsics xz_crc_arm64.c uses, for
+// building it on a host that is not arm64 (XZ_CRC_ARM64_HOST, see
+// crc_bench.cpp). Lane 0 is the low half, as on a little-endian arm64.
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t          poly64_t;
+typedef unsigned __int128 poly128_t;
+typedef struct { uint64_t v[2]; } uint64x2_t;
+typedef struct { uint64_t v[2]; } poly64x2_t;
+typedef struct { uint8_t v[16]; } uint8x16_t;
+typedef struct { uint64_t v[1]; } uint64x1_t;
+
+// PMULL: carry-less 64 x 64 -> 128 bit multiply
+static inline poly128_t vmull_p64(poly64_t a, poly64_t b) {
+  poly128_t r = 0;
+  for (int i = 0; i < 64; i++) {
+    if ((b >> i) & 1) r ^= (poly128_t)a << i;
+  }
+  return r;
+}
+
+static inline poly128_t vmull_high_p64(poly64x2_t a, poly64x2_t b) {
+  return vmull_p64(a.v[1], b.v[1]);
+}
+
+static inline uint64x2_t vreinterpretq_u64_p128(poly128_t a) {
+  uint64x2_t r = { { (uint64_t)a, (uint64_t)(a >> 64) } };
+  return r;
+}
+
+static inline poly64x2_t vreinterpretq_p64_u64(uint64x2_t a) {
+  poly64x2_t r = { { a.v[0], a.v[1] } };
+  return r;
+}
+
+static inline uint64x2_t vreinterpretq_u64_u8(uint8x16_t a) {
+  uint64x2_t r;
+  memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+static inline uint8x16_t vreinterpretq_u8_u64(uint64x2_t a) {
+  uint8x16_t r;
+  memcpy(r.v, a.v, sizeof(r.v));
+  return r;
+}
+
+static inline uint64_t vgetq_lane_u64(uint64x2_t a, int lane) {
+  return a.v[lane];
+}
+
+static inline uint64x1_t vcreate_u64(uint64_t a) {
+  uint64x1_t r = { { a } };
+  return r;
+}
+
+static inline uint64x2_t vcombine_u64(uint64x1_t lo, uint64x1_t hi) {
+  uint64x2_t r = { { lo.v[0], hi.v[0] } };
+  return r;
+}
+
+static inline uint64x2_t veorq_u64(uint64x2_t a, uint64x2_t b) {
+  uint64x2_t r = { { a.v[0] ^ b.v[0], a.v[1] ^ b.v[1] } };
+  return r;
+}
+
+static inline uint8x16_t vld1q_u8(const uint8_t* p) {
+  uint8x16_t r;
+  memcpy(r.v, p, sizeof(r.v));
+  return r;
+}
+
+static inline void vst1q_u8(uint8_t* p, uint8x16_t a) {
+  memcpy(p, a.v, sizeof(a.v));
+}
@@ -0,0 +1,202 @@
+// xzdec's CRC32 / CRC64 implementations against each other: the bytewise
+// definition, slicing-by-8 (xz_crc*_generic) and the arm64 kernels of
+// xz_crc_arm64.c (CRC32X, PMULL folding).
+//
+// Usage:
+//   crc_bench [--iters N]
+//
+// On arm64 (natively, or under qemu-aarch64 as part of bench_hooks) the
+// kernels are the real ones, run if AT_HWCAP has the instructions. On other
+// hosts xz_crc_arm64.c is built against C versions of the intrinsics
+// (a64_shim/): that checks the kernels' logic bit for bit, but says nothing
+// about their speed, so their MiB/s are marked "emulated".
+//
+// Every implementation must give the bytewise result for every length up to
+// 1200 at every alignment 0..15, from a zero and a nonzero starting CRC, and
+// over 16 MiB. Then MiB/s over the 16 MiB, min / median over N runs.
+// Exits non-zero on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+  #include "xz.h"
+
+  // xzdec internals (xz_private.h)
+  uint32_t xz_crc32_generic(const uint8_t* buf, size_t size, uint32_t crc);
+  uint64_t xz_crc64_generic(const uint8_t* buf, size_t size, uint64_t crc);
+  uint32_t xz_crc32_arm64(const uint8_t* buf, size_t size, uint32_t crc);
+  size_t xz_crc64_pmull_fold(const uint8_t* buf, size_t size, uint64_t crc, uint8_t folded[16]);
+#if defined(__aarch64__)
+  bool xz_crc_arm64_have_crc32(void);
+  bool xz_crc_arm64_have_pmull(void);
+#endif
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t ref_crc32(const uint8_t* p, size_t n, uint32_t crc) {
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint64_t ref_crc64(const uint8_t* p, size_t n, uint64_t crc) {
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xC96C5795D7870F42ull & (0ull - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// what xz_crc64() does when it has PMULL
+static uint64_t pmull_crc64(const uint8_t* p, size_t n, uint64_t crc) {
+  if (n >= 32) {
+    uint8_t folded[16];
+    const size_t used = xz_crc64_pmull_fold(p, n, ~crc, folded);
+    crc = xz_crc64_generic(folded, sizeof folded, ~0ull);
+    p += used;
+    n -= used;
+  }
+  return xz_crc64_generic(p, n, crc);
+}
+
+struct Impl32 {
+  const char* name;
+  uint32_t (*fn)(const uint8_t*, size_t, uint32_t);
+  bool kernel;
+};
+
+struct Impl64 {
+  const char* name;
+  uint64_t (*fn)(const uint8_t*, size_t, uint64_t);
+  bool kernel;
+};
+
+static const Impl32 IMPLS32[] = {
+  { "bytewise", ref_crc32, false },
+  { "slice8",   xz_crc32_generic, false },
+  { "crc32x",   xz_crc32_arm64, true },
+  { "xz_crc32", xz_crc32, false }, // what xzdec uses (checked only)
+};
+
+static const Impl64 IMPLS64[] = {
+  { "bytewise", ref_crc64, false },
+  { "slice8",   xz_crc64_generic, false },
+  { "pmull",    pmull_crc64, true },
+  { "xz_crc64", xz_crc64, false },
+};
+
+static const size_t BENCH_IMPLS = 3; // the first three of each are timed
+
+static bool g_have_crc32 = true, g_have_pmull = true;
+static volatile uint64_t g_sink;
+#if defined(__aarch64__)
+static const char* const KERNEL_NOTE = "";
+#else
+static const char* const KERNEL_NOTE = " (emulated)";
+#endif
+
+template <typename Impl, typename Crc>
+static bool check(const Impl* impls, size_t nimpls, bool have_kernel, const uint8_t* buf,
+                  size_t n, const char* what) {
+  for (size_t i = 0; i < nimpls; i++) {
+    const Impl& im = impls[i];
+    if (im.kernel && !have_kernel) continue;
+    for (size_t off = 0; off < 16; off++) {
+      for (size_t len = 0; len <= 1200; len++) {
+        const uint8_t* p = buf + off;
+        for (Crc start : { (Crc)0, (Crc)0x0123456789abcdefull }) {
+          const Crc want = impls[0].fn(p, len, start);
+          const Crc got = im.fn(p, len, start);
+          if (got != want) {
+            fprintf(stderr, "FAIL: %s %s at offset %zu length %zu: %llx, want %llx\n", what,
+                    im.name, off, len, (unsigned long long)got, (unsigned long long)want);
+            return false;
+          }
+        }
+      }
+    }
+    if (im.fn(buf, n, 0) != impls[0].fn(buf, n, 0)) {
+      fprintf(stderr, "FAIL: %s %s over %zu bytes\n", what, im.name, n);
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Impl>
+static void bench(const Impl* impls, bool have_kernel, const uint8_t* buf, size_t n, int iters,
+                  const char* what) {
+  const double mb = (double)n / (1 << 20);
+  for (size_t i = 0; i < BENCH_IMPLS; i++) {
+    const Impl& im = impls[i];
+    if (im.kernel && !have_kernel) {
+      printf("  %s %-20s %12s\n", what, im.name, "no hwcap");
+      continue;
+    }
+    std::vector<uint64_t> ns;
+    for (int k = 0; k < iters; k++) {
+      uint64_t t0 = now_ns();
+      g_sink = g_sink + (uint64_t)im.fn(buf, n, 0);
+      ns.push_back(now_ns() - t0);
+    }
+    std::sort(ns.begin(), ns.end());
+    char name[64];
+    snprintf(name, sizeof name, "%s%s", im.name, im.kernel ? KERNEL_NOTE : "");
+    printf("  %s %-20s %12.1f %12.1f\n", what, name, mb / ((double)ns.front() / 1e9),
+           mb / ((double)ns[ns.size() / 2] / 1e9));
+  }
+}
+
+int main(int argc, char** argv) {
+  int iters = 5;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iters") && i + 1 < argc) {
+      iters = std::max(1, atoi(argv[++i]));
+    } else {
+      fprintf(stderr, "usage: %s [--iters N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  xz_crc32_init();
+  xz_crc64_init();
+#if defined(__aarch64__)
+  g_have_crc32 = xz_crc_arm64_have_crc32();
+  g_have_pmull = xz_crc_arm64_have_pmull();
+#endif
+
+  const size_t n = 16 << 20;
+  std::vector<uint8_t> buf(n + 16);
+  uint64_t x = 0x9E3779B97F4A7C15ull;
+  for (auto& b : buf) {
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    b = (uint8_t)((x * 0x2545F4914F6CDD1Dull) >> 56);
+  }
+
+  const size_t n32 = sizeof(IMPLS32) / sizeof(IMPLS32[0]);
+  const size_t n64 = sizeof(IMPLS64) / sizeof(IMPLS64[0]);
+  if (!check<Impl32, uint32_t>(IMPLS32, n32, g_have_crc32, buf.data(), n, "crc32") ||
+      !check<Impl64, uint64_t>(IMPLS64, n64, g_have_pmull, buf.data(), n, "crc64")) {
+    return 1;
+  }
+
+  printf("crc (%zu MiB, bit-exact, %d runs)   min MiB/s  median MiB/s\n", n >> 20, iters);
+  bench(IMPLS32, g_have_crc32, buf.data(), n, iters, "crc32");
+  bench(IMPLS64, g_have_pmull, buf.data(), n, iters, "crc64");
+  return 0;
+}
@@ -0,0 +1,497 @@
+// Writes a synthetic "surfaceflinger" ELF for the host benchmarks: a stripped
+// binary whose .gnu_debugdata holds an XZ-compressed mini ELF with tens of
+// thousands of C++ mangled function symbols, laid out like the mini debug
+// info produced by the Android build (objcopy --only-keep-debug, section
+// headers at the end, xz --block-size=64k, CRC64).
+//
+// Usage:
+//   fixture_gen <out.elf> [--symbols N] [--seed S] [--target-at F]
+//                         [--block-size BYTES] [--text-size BYTES]
+//                         [--exported N] [--symoffset 0|1]
+//
+// The real hook symbols (see sf_symbols.h) are placed at fraction F of the
+// symbol table (0 = first, 1 = last) so the lookup and early-exit paths can
+// be measured with targets early or late in the table. --exported N also
+// puts the first N of them in a .dynsym / .gnu.hash, like builds that export
+// them, so the resolver's fast tier can be measured. --symoffset 0 writes a
+// .gnu.hash whose chain also covers the null symbol (symoffset 0, legal but
+// unusual; the default is 1, as the linkers write it). The code at each
+// target starts with a known prologue (fixture_sigs.h) for the signature
+// scanner.
+
+#include <elf.h>
+#include <lzma.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "fixture_sigs.h"
+#include "sf_symbols.h"
+
+// hook targets planted in the symbol table
+static const char* const FIXTURE_TARGETS[] = {
+  SYM_HIDL_IS_SUPPORTED, SYM_AIDL_IS_SUPPORTED, SYM_IMPL,
+};
+static const size_t FIXTURE_TARGET_COUNT = sizeof(FIXTURE_TARGETS) / sizeof(FIXTURE_TARGETS[0]);
+static_assert(sizeof(FIXTURE_PROLOGUES) / sizeof(FIXTURE_PROLOGUES[0]) == FIXTURE_TARGET_COUNT,
+              "one prologue per hook target");
+
+struct Options {
+  const char* out = nullptr;
+  size_t   symbols = 40000;
+  uint64_t seed = 1;
+  double   target_at = 0.5;
+  size_t   block_size = 64 * 1024;
+  size_t   text_size = 4 * 1024 * 1024;
+  size_t   exported = 0;
+  uint32_t symoffset = 1;
+};
+
+// xorshift64*, deterministic across hosts
+struct Rng {
+  uint64_t s;
+  explicit Rng(uint64_t seed) : s(seed ? seed : 0x9e3779b97f4a7c15ull) {}
+  uint64_t next() {
+    s ^= s >> 12; s ^= s << 25; s ^= s >> 27;
+    return s * 2685821657736338717ull;
+  }
+  size_t below(size_t n) { return (size_t)(next() % n); }
+};
+
+static const char* const NAMESPACES[] = {
+  "android", "aidl", "hardware", "graphics", "composer3", "compositionengine",
+  "renderengine", "scheduler", "frametimeline", "gui", "ui", "base", "impl",
+  "Hwc2", "FlagManager", "sysprop", "binder", "os", "internal", "detail",
+};
+
+static const char* const CLASSES[] = {
+  "SurfaceFlinger", "HWComposer", "HidlComposer", "AidlComposer", "Layer",
+  "DisplayDevice", "RenderEngine", "Scheduler", "VsyncSchedule", "FrameTracker",
+  "LayerSnapshotBuilder", "TransactionHandler", "RefreshRateSelector",
+  "CompositionEngine", "Output", "OutputLayer", "DisplaySurface", "BufferQueue",
+  "FramebufferSurface", "VirtualDisplaySurface", "TimeStats", "LayerTracing",
+  "EventThread", "MessageQueue", "PowerAdvisor", "RegionSamplingThread",
+};
+
+static const char* const METHODS[] = {
+  "commit", "composite", "onMessageInvalidate", "setPowerMode", "getDisplayAttribute",
+  "presentAndGetReleaseFences", "validateDisplay", "setActiveConfig", "onHotplug",
+  "getPhysicalDisplayOrientation", "isSupported", "updateLayerGeometry",
+  "prepareFrame", "finishFrame", "latchBuffer", "onFirstRef", "dump", "setClientTarget",
+  "getDisplayCapabilities", "setLayerBuffer", "applyTransactionState", "doComposition",
+  "handlePageFlip", "computeBounds", "getSupportedContentTypes", "requestNextVsync",
+};
+
+static const char* const PARAMS[] = {
+  "v", "i", "j", "m", "b", "f", "PKc", "RKNS_2spINS_5LayerEEE", "NS_17PhysicalDisplayIdE",
+  "RKNS_6RegionE", "PNS_7DisplayE", "NSt3__110shared_ptrINS_13DisplayDeviceEEE",
+  "RKNSt3__16vectorINS_14LayerFESettingsENS0_9allocatorIS2_EEEE", "mPNS0_9TransformE",
+};
+
+static void append_id(std::string& s, const std::string& id) {
+  s += std::to_string(id.size());
+  s += id;
+}
+
+// A plausible Itanium-mangled member function name; idx keeps names unique.
+static std::string make_name(Rng& rng, size_t idx) {
+  std::string s = rng.below(3) == 0 ? "_ZNK" : "_ZN";
+  size_t depth = 1 + rng.below(3);
+  for (size_t i = 0; i < depth; i++) {
+    append_id(s, NAMESPACES[rng.below(sizeof(NAMESPACES) / sizeof(NAMESPACES[0]))]);
+  }
+  append_id(s, CLASSES[rng.below(sizeof(CLASSES) / sizeof(CLASSES[0]))]);
+  std::string method = METHODS[rng.below(sizeof(METHODS) / sizeof(METHODS[0]))];
+  method += std::to_string(idx);
+  append_id(s, method);
+  s += 'E';
+  size_t nparams = 1 + rng.below(3);
+  for (size_t i = 0; i < nparams; i++) {
+    s += PARAMS[rng.below(sizeof(PARAMS) / sizeof(PARAMS[0]))];
+  }
+  return s;
+}
+
+struct Section {
+  std::string name;
+  Elf64_Shdr  hdr{};
+  std::vector<uint8_t> data;
+};
+
+// Lay out sections back to back after the ELF header, section header table
+// last, like objcopy does.
+static std::vector<uint8_t> write_elf(std::vector<Section>& secs, uint16_t type) {
+  // section 0 is SHT_NULL, shstrtab is appended last
+  Section shstr;
+  shstr.name = ".shstrtab";
+  shstr.hdr.sh_type = SHT_STRTAB;
+  shstr.hdr.sh_addralign = 1;
+  shstr.data.push_back(0);
+  for (auto& s : secs) {
+    s.hdr.sh_name = (uint32_t)shstr.data.size();
+    shstr.data.insert(shstr.data.end(), s.name.begin(), s.name.end());
+    shstr.data.push_back(0);
+  }
+  shstr.hdr.sh_name = (uint32_t)shstr.data.size();
+  shstr.data.insert(shstr.data.end(), shstr.name.begin(), shstr.name.end());
+  shstr.data.push_back(0);
+  secs.push_back(shstr);
+
+  std::vector<uint8_t> out(sizeof(Elf64_Ehdr));
+  for (auto& s : secs) {
+    size_t align = s.hdr.sh_addralign ? s.hdr.sh_addralign : 1;
+    out.resize((out.size() + align - 1) / align * align);
+    s.hdr.sh_offset = out.size();
+    if (s.hdr.sh_type != SHT_NOBITS) {
+      s.hdr.sh_size = s.data.size();
+      out.insert(out.end(), s.data.begin(), s.data.end());
+    }
+  }
+  out.resize((out.size() + 7) & ~(size_t)7);
+
+  Elf64_Ehdr eh{};
+  memcpy(eh.e_ident, ELFMAG, SELFMAG);
+  eh.e_ident[EI_CLASS] = ELFCLASS64;
+  eh.e_ident[EI_DATA] = ELFDATA2LSB;
+  eh.e_ident[EI_VERSION] = EV_CURRENT;
+  eh.e_type = type;
+  eh.e_machine = EM_AARCH64;
+  eh.e_version = EV_CURRENT;
+  eh.e_ehsize = sizeof(Elf64_Ehdr);
+  eh.e_shoff = out.size();
+  eh.e_shentsize = sizeof(Elf64_Shdr);
+  eh.e_shnum = (uint16_t)(secs.size() + 1);
+  eh.e_shstrndx = (uint16_t)secs.size();
+  memcpy(out.data(), &eh, sizeof eh);
+
+  Elf64_Shdr null_hdr{};
+  out.insert(out.end(), (uint8_t*)&null_hdr, (uint8_t*)(&null_hdr + 1));
+  for (auto& s : secs) {
+    out.insert(out.end(), (uint8_t*)&s.hdr, (uint8_t*)(&s.hdr + 1));
+  }
+  return out;
+}
+
+// target_values receives the st_value of each planted hook target.
+static std::vector<uint8_t> build_mini_elf(const Options& o, std::vector<uint64_t>& target_values) {
+  Rng rng(o.seed);
+  const uint64_t text_addr = 0x100000;
+
+  Section text;
+  text.name = ".text";
+  text.hdr.sh_type = SHT_NOBITS; // --only-keep-debug drops the code
+  text.hdr.sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  text.hdr.sh_addr = text_addr;
+  text.hdr.sh_size = o.text_size;
+  text.hdr.sh_addralign = 16;
+
+  Section strtab;
+  strtab.name = ".strtab";
+  strtab.hdr.sh_type = SHT_STRTAB;
+  strtab.hdr.sh_addralign = 1;
+  strtab.data.push_back(0);
+
+  Section symtab;
+  symtab.name = ".symtab";
+  symtab.hdr.sh_type = SHT_SYMTAB;
+  symtab.hdr.sh_addralign = 8;
+  symtab.hdr.sh_entsize = sizeof(Elf64_Sym);
+  symtab.hdr.sh_link = 3; // .strtab (NULL, .text, .symtab, .strtab)
+  symtab.hdr.sh_info = 1; // all but the null symbol are global
+  std::vector<Elf64_Sym> syms(1);
+
+  const size_t last = o.symbols > FIXTURE_TARGET_COUNT ? o.symbols - FIXTURE_TARGET_COUNT : 0;
+  size_t target_pos = (size_t)(o.target_at * (double)last);
+  size_t next_target = 0;
+  uint64_t addr = text_addr;
+  const uint64_t text_end = text_addr + o.text_size;
+
+  for (size_t i = 0; i < o.symbols; i++) {
+    std::string name;
+    if (i >= target_pos && next_target < FIXTURE_TARGET_COUNT) {
+      name = FIXTURE_TARGETS[next_target++];
+    } else {
+      name = make_name(rng, i);
+    }
+
+    Elf64_Sym s{};
+    s.st_name = (uint32_t)strtab.data.size();
+    strtab.data.insert(strtab.data.end(), name.begin(), name.end());
+    strtab.data.push_back(0);
+
+    // mostly functions, with some data objects and locals mixed in
+    unsigned kind = (unsigned)rng.below(16);
+    s.st_info = ELF64_ST_INFO(kind == 0 ? STB_LOCAL : STB_GLOBAL,
+                              kind == 1 ? STT_OBJECT : STT_FUNC);
+    s.st_shndx = 1;
+    s.st_size = 16 + 4 * rng.below(256);
+    if (addr + s.st_size > text_end) {
+      addr = text_addr; // wrap; overlapping addresses are fine for lookups
+    }
+    s.st_value = addr;
+    addr += (s.st_size + 15) & ~15ull;
+    syms.push_back(s);
+  }
+  // the hook symbols must always be functions
+  target_values.assign(next_target, 0);
+  for (auto& s : syms) {
+    for (size_t t = 0; t < next_target; t++) {
+      if (s.st_name && strcmp((const char*)strtab.data.data() + s.st_name, FIXTURE_TARGETS[t]) == 0) {
+        s.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        target_values[t] = s.st_value;
+      }
+    }
+  }
+  symtab.data.assign((uint8_t*)syms.data(), (uint8_t*)(syms.data() + syms.size()));
+
+  std::vector<Section> secs;
+  secs.push_back(std::move(text));
+  secs.push_back(std::move(symtab));
+  secs.push_back(std::move(strtab));
+  return write_elf(secs, ET_DYN);
+}
+
+static bool xz_compress(const std::vector<uint8_t>& in, size_t block_size,
+                        std::vector<uint8_t>& out) {
+  lzma_stream strm = LZMA_STREAM_INIT;
+  lzma_ret ret;
+  if (block_size) {
+    lzma_mt mt{};
+    mt.threads = 1;
+    mt.block_size = block_size;
+    mt.preset = 6;
+    mt.check = LZMA_CHECK_CRC64;
+    ret = lzma_stream_encoder_mt(&strm, &mt);
+  } else {
+    ret = lzma_easy_encoder(&strm, 6, LZMA_CHECK_CRC64);
+  }
+  if (ret != LZMA_OK) {
+    fprintf(stderr, "lzma encoder init failed: %d\n", (int)ret);
+    return false;
+  }
+
+  out.resize(in.size() + in.size() / 2 + 4096);
+  strm.next_in = in.data();
+  strm.avail_in = in.size();
+  strm.next_out = out.data();
+  strm.avail_out = out.size();
+  ret = lzma_code(&strm, LZMA_FINISH);
+  out.resize(strm.total_out);
+  lzma_end(&strm);
+  if (ret != LZMA_STREAM_END) {
+    fprintf(stderr, "lzma_code failed: %d\n", (int)ret);
+    return false;
+  }
+  return true;
+}
+
+static uint32_t gnu_hash(const char* s) {
+  uint32_t h = 5381;
+  for (; *s; s++) h = h * 33 + (uint8_t)*s;
+  return h;
+}
+
+// .dynsym, .dynstr and .gnu.hash with the first `exported` hook targets and
+// some filler exports. Appended to secs; dynsym_index is the section index
+// .dynsym will get.
+static void add_dynamic(const Options& o, const std::vector<uint64_t>& target_values,
+                        uint32_t dynsym_index, std::vector<Section>& secs) {
+  Rng rng(o.seed ^ 0xd15ea5e);
+  std::vector<std::string> names;
+  std::vector<uint64_t> values;
+  for (size_t t = 0; t < o.exported && t < target_values.size(); t++) {
+    names.push_back(FIXTURE_TARGETS[t]);
+    values.push_back(target_values[t]);
+  }
+  for (size_t i = 0; i < 256; i++) {
+    names.push_back(make_name(rng, o.symbols + i));
+    values.push_back(0x100000 + 16 * i);
+  }
+
+  // .gnu.hash needs the symbols sorted by bucket
+  const uint32_t nbuckets = (uint32_t)(names.size() / 4 + 1);
+  std::vector<size_t> order(names.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::vector<uint32_t> hashes(names.size());
+  for (size_t i = 0; i < names.size(); i++) hashes[i] = gnu_hash(names[i].c_str());
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return hashes[a] % nbuckets < hashes[b] % nbuckets;
+  });
+
+  Section dynstr;
+  dynstr.name = ".dynstr";
+  dynstr.hdr.sh_type = SHT_STRTAB;
+  dynstr.hdr.sh_flags = SHF_ALLOC;
+  dynstr.hdr.sh_addralign = 1;
+  dynstr.data.push_back(0);
+
+  std::vector<Elf64_Sym> syms(1);
+  for (size_t k : order) {
+    Elf64_Sym s{};
+    s.st_name = (uint32_t)dynstr.data.size();
+    dynstr.data.insert(dynstr.data.end(), names[k].begin(), names[k].end());
+    dynstr.data.push_back(0);
+    s.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+    s.st_shndx = 2; // .text
+    s.st_value = values[k];
+    s.st_size = 16;
+    syms.push_back(s);
+  }
+
+  Section dynsym;
+  dynsym.name = ".dynsym";
+  dynsym.hdr.sh_type = SHT_DYNSYM;
+  dynsym.hdr.sh_flags = SHF_ALLOC;
+  dynsym.hdr.sh_addralign = 8;
+  dynsym.hdr.sh_entsize = sizeof(Elf64_Sym);
+  dynsym.hdr.sh_link = dynsym_index + 1; // .dynstr
+  dynsym.hdr.sh_info = 1;
+  dynsym.data.assign((uint8_t*)syms.data(), (uint8_t*)(syms.data() + syms.size()));
+
+  // header, bloom filter (~8 bits per symbol), buckets, chain. Symbol k of
+  // order is .dynsym entry k + 1 (0 is the null symbol); the chain starts
+  // at entry symoffset.
+  const uint32_t symoffset = o.symoffset, shift = 6;
+  uint32_t bloom_size = 1;
+  while (bloom_size * 64 < names.size() * 8) bloom_size <<= 1;
+  std::vector<uint64_t> bloom(bloom_size, 0);
+  std::vector<uint32_t> buckets(nbuckets, 0), chain(names.size() + 1 - symoffset, 0);
+  if (symoffset == 0) {
+    chain[0] = 1; // the null symbol, a chain of its own that no bucket points to
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    uint32_t h = hashes[order[i]];
+    bloom[(h / 64) % bloom_size] |= (1ull << (h % 64)) | (1ull << ((h >> shift) % 64));
+    uint32_t b = h % nbuckets;
+    if (!buckets[b]) buckets[b] = (uint32_t)(i + 1);
+    bool last = i + 1 == order.size() || hashes[order[i + 1]] % nbuckets != b;
+    chain[i + 1 - symoffset] = (h & ~1u) | (last ? 1u : 0u);
+  }
+
+  Section gh;
+  gh.name = ".gnu.hash";
+  gh.hdr.sh_type = SHT_GNU_HASH;
+  gh.hdr.sh_flags = SHF_ALLOC;
+  gh.hdr.sh_addralign = 8;
+  gh.hdr.sh_link = dynsym_index;
+  uint32_t hdr[4] = { nbuckets, symoffset, bloom_size, shift };
+  auto put = [&gh](const void* p, size_t n) {
+    gh.data.insert(gh.data.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+  };
+  put(hdr, sizeof hdr);
+  put(bloom.data(), bloom.size() * sizeof(uint64_t));
+  put(buckets.data(), buckets.size() * sizeof(uint32_t));
+  put(chain.data(), chain.size() * sizeof(uint32_t));
+
+  secs.push_back(std::move(dynsym));
+  secs.push_back(std::move(dynstr));
+  secs.push_back(std::move(gh));
+}
+
+static std::vector<uint8_t> build_outer_elf(const Options& o, const std::vector<uint64_t>& target_values,
+                                            std::vector<uint8_t> debugdata) {
+  Rng rng(o.seed ^ 0xfeedface);
+
+  Section note;
+  note.name = ".note.gnu.build-id";
+  note.hdr.sh_type = SHT_NOTE;
+  note.hdr.sh_flags = SHF_ALLOC;
+  note.hdr.sh_addralign = 4;
+  Elf64_Nhdr nh{};
+  nh.n_namesz = 4;
+  nh.n_descsz = 20;
+  nh.n_type = NT_GNU_BUILD_ID;
+  note.data.insert(note.data.end(), (uint8_t*)&nh, (uint8_t*)(&nh + 1));
+  note.data.insert(note.data.end(), {'G', 'N', 'U', 0});
+  for (int i = 0; i < 20; i++) {
+    note.data.push_back((uint8_t)rng.next());
+  }
+
+  Section text;
+  text.name = ".text";
+  text.hdr.sh_type = SHT_PROGBITS;
+  text.hdr.sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  text.hdr.sh_addr = 0x100000;
+  text.hdr.sh_addralign = 16;
+  text.data.resize(o.text_size);
+  for (size_t i = 0; i + 4 <= text.data.size(); i += 4) {
+    uint32_t w = (uint32_t)rng.next();
+    memcpy(&text.data[i], &w, 4);
+  }
+  // recognisable prologues at the hook targets, for the signature scanner
+  for (size_t t = 0; t < target_values.size(); t++) {
+    const uint64_t off = target_values[t] - text.hdr.sh_addr;
+    if (off + sizeof(FIXTURE_PROLOGUES[t]) <= text.data.size()) {
+      memcpy(&text.data[off], FIXTURE_PROLOGUES[t], sizeof(FIXTURE_PROLOGUES[t]));
+    }
+  }
+
+  Section gdd;
+  gdd.name = ".gnu_debugdata";
+  gdd.hdr.sh_type = SHT_PROGBITS;
+  gdd.hdr.sh_addralign = 1;
+  gdd.data = std::move(debugdata);
+
+  std::vector<Section> secs;
+  secs.push_back(std::move(note));
+  secs.push_back(std::move(text));
+  if (o.exported) {
+    add_dynamic(o, target_values, (uint32_t)secs.size() + 1, secs);
+  }
+  secs.push_back(std::move(gdd));
+  return write_elf(secs, ET_DYN);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "Usage: %s <out.elf> [--symbols N] [--seed S] [--target-at F]\n"
+          "          [--block-size BYTES] [--text-size BYTES] [--exported N]\n"
+          "          [--symoffset 0|1]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (a[0] != '-') { o.out = a; continue; }
+    if (!v) { usage(argv[0]); return 1; }
+    if (!strcmp(a, "--symbols")) o.symbols = strtoull(v, nullptr, 0);
+    else if (!strcmp(a, "--seed")) o.seed = strtoull(v, nullptr, 0);
+    else if (!strcmp(a, "--target-at")) o.target_at = atof(v);
+    else if (!strcmp(a, "--block-size")) o.block_size = strtoull(v, nullptr, 0);
+    else if (!strcmp(a, "--text-size")) o.text_size = strtoull(v, nullptr, 0);
+    else if (!strcmp(a, "--exported")) o.exported = strtoull(v, nullptr, 0);
+    else if (!strcmp(a, "--symoffset")) o.symoffset = (uint32_t)strtoul(v, nullptr, 0);
+    else { usage(argv[0]); return 1; }
+    i++;
+  }
+  if (!o.out || o.target_at < 0 || o.target_at > 1 || o.symoffset > 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<uint64_t> target_values;
+  std::vector<uint8_t> mini = build_mini_elf(o, target_values);
+  std::vector<uint8_t> xz;
+  if (!xz_compress(mini, o.block_size, xz)) {
+    return 2;
+  }
+  std::vector<uint8_t> elf = build_outer_elf(o, target_values, std::move(xz));
+
+  FILE* f = fopen(o.out, "wb");
+  if (!f || fwrite(elf.data(), 1, elf.size(), f) != elf.size()) {
+    fprintf(stderr, "cannot write %s\n", o.out);
+    if (f) fclose(f);
+    return 3;
+  }
+  fclose(f);
+  printf("%s: %zu symbols (%zu hook targets, %zu exported), mini ELF %zu bytes, file %zu bytes\n",
+         o.out, o.symbols, target_values.size(), std::min(o.exported, target_values.size()),
+         mini.size(), elf.size());
+  return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Prologues fixture_gen writes at each hook target in the fixture's .text
+// (same order as its FIXTURE_TARGETS), so resolver_bench can check the
+// signature scanner against the .gnu_debugdata addresses.
+
+static const size_t FIXTURE_PROLOGUE_WORDS = 6;
+
+static const uint32_t FIXTURE_PROLOGUES[][FIXTURE_PROLOGUE_WORDS] = {
+  // stp x29, x30, [sp, #-32]!; mov x29, sp; stp x20, x19, [sp, #16];
+  // mov w19, #imm (a different one per target); mov x20, x0; cmp w1, #4
+  { 0xa9be7bfd, 0x910003fd, 0xa9014ff4, 0x5280b433, 0xaa0003f4, 0x7100103f },
+  { 0xa9be7bfd, 0x910003fd, 0xa9014ff4, 0x528143b3, 0xaa0003f4, 0x7100103f },
+  { 0xa9be7bfd, 0x910003fd, 0xa9014ff4, 0x52803a13, 0xaa0003f4, 0xf9400008 },
+};
+
+// Signature text for prologue i, with the stack frame size (the stp
+// immediate) left as "??" like a real per-build table would.
+static inline void fixture_signature(size_t i, char* out, size_t cap) {
+  size_t n = 0;
+  for (size_t w = 0; w < FIXTURE_PROLOGUE_WORDS; w++) {
+    for (int b = 0; b < 4; b++) {
+      unsigned v = (FIXTURE_PROLOGUES[i][w] >> (8 * b)) & 0xff;
+      if (n + 4 > cap) break;
+      if (w == 0 && b == 2) {
+        n += (size_t)snprintf(out + n, cap - n, "%s??", n ? " " : "");
+      } else {
+        n += (size_t)snprintf(out + n, cap - n, "%s%02x", n ? " " : "", v);
+      }
+    }
+  }
+}
@@ -0,0 +1,208 @@
+// Cost and correctness of And64InlineHook detours, aarch64 Linux only (runs
+// under qemu-aarch64 user mode, see cmake/aarch64-linux-gnu.cmake).
+//
+// Usage:
+//   hook_bench [--calls N]
+//
+// Every fixture in hook_fixtures.S starts with a PC-relative instruction
+// handled by one of the __fix_* relocators. Each is hooked two ways:
+//  - near: A64HookFunction(). The trampoline is within B range of the
+//    target, the patch is a single B and only the first instruction is
+//    relocated.
+//  - far:  the layout And64InlineHook used before trampolines were
+//    allocated near the target (and what a replacement in another
+//    library gets without the thunk). The trampoline and the replacement
+//    are more than 128MB away, the patch is LDR/BR and four or five
+//    instructions are relocated, most of them into their long forms.
+//
+// For each fixture and layout it checks the results of the unhooked copy,
+// the hook alone and the hook chained to the original against a C
+// reference, then prints ns/call for the direct call, the hook alone and
+// the hook + original. Exits non-zero on any wrong result.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <array>
+#include <utility>
+
+#include "And64InlineHook.hpp"
+#include "hook_fixtures.h"
+
+#if !defined(__aarch64__)
+# error "hook_bench is aarch64 only"
+#endif
+
+typedef int64_t (*Fx)(int64_t);
+
+#define FX_DECLARE(name, fix, expr) \
+  extern "C" int64_t name##_direct(int64_t); \
+  extern "C" int64_t name##_near(int64_t); \
+  extern "C" int64_t name##_far(int64_t);
+HOOK_FIXTURES(FX_DECLARE)
+
+struct Fixture {
+  const char* name;
+  const char* fix; // relocator exercised by the first instruction
+  Fx direct, near, far, ref;
+};
+
+#define FX(name, fix, expr) { #name, fix, name##_direct, name##_near, name##_far, name##_ref },
+
+static const Fixture FIXTURES[] = {
+  HOOK_FIXTURES(FX)
+};
+static const int FIXTURE_COUNT = HOOK_FIXTURE_COUNT;
+
+static volatile bool g_chain;
+static Fx g_orig[FIXTURE_COUNT * 2];
+
+template <size_t I>
+__attribute__((noinline)) static int64_t replacement(int64_t x) {
+  return g_chain ? g_orig[I](x) + HOOK_CHAIN_ADD : x + HOOK_ALONE_ADD;
+}
+
+template <size_t... I>
+static constexpr std::array<Fx, sizeof...(I)> replacements(std::index_sequence<I...>) {
+  return { { replacement<I>... } };
+}
+
+static const std::array<Fx, FIXTURE_COUNT * 2> REPLACEMENTS =
+  replacements(std::make_index_sequence<FIXTURE_COUNT * 2>());
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool is_far(uintptr_t a, uintptr_t b) {
+  return (a > b ? a - b : b - a) >= (256ull << 20);
+}
+
+// An RWX page at least 256MB from this binary, nullptr if none was found.
+static uint8_t* map_far_page() {
+  const uintptr_t self = (uintptr_t)&now_ns;
+  const uintptr_t hints[] = {
+    self + (4ull << 30), self - (4ull << 30), self + (64ull << 30), 0,
+  };
+  for (uintptr_t hint : hints) {
+    void* p = mmap((void*)(hint & ~(uintptr_t)4095), 4096, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) continue;
+    if (is_far((uintptr_t)p, self)) return (uint8_t*)p;
+    munmap(p, 4096);
+  }
+  return nullptr;
+}
+
+// Hooks fn the old way: LDR/BR thunk to rep and the trampoline both in the
+// far page. Returns the trampoline.
+static Fx hook_far(Fx fn, Fx rep, uint8_t* far_page, size_t* far_used) {
+  static const size_t THUNK = 16, TRAMPOLINE = 256;
+  if (*far_used + THUNK + TRAMPOLINE > 4096) return nullptr;
+
+  uint32_t* thunk = (uint32_t*)(far_page + *far_used);
+  thunk[0] = 0x58000051u; // LDR X17, #0x8
+  thunk[1] = 0xd61f0220u; // BR X17
+  memcpy(thunk + 2, &rep, sizeof(rep));
+  __builtin___clear_cache((char*)thunk, (char*)thunk + THUNK);
+
+  void* trampoline = far_page + *far_used + THUNK;
+  *far_used += THUNK + TRAMPOLINE;
+  return (Fx)A64HookFunctionV((void*)fn, thunk, trampoline, TRAMPOLINE);
+}
+
+static bool check(const char* what, const Fixture& f, Fx fn, int64_t add, bool ref) {
+  for (int64_t x : HOOK_INPUTS) {
+    int64_t want = ref ? f.ref(x) + add : x + add;
+    int64_t got = fn(x);
+    if (got != want) {
+      printf("  %-12s %-5s f(%lld) = %lld, want %lld\n", f.name, what,
+             (long long)x, (long long)got, (long long)want);
+      return false;
+    }
+  }
+  return true;
+}
+
+static double ns_per_call(Fx fn, uint64_t calls) {
+  Fx volatile f = fn;
+  int64_t volatile sink = 0;
+  int64_t s = 0;
+  for (uint64_t i = 0; i < calls / 10; i++) s += f((int64_t)i); // warm up
+  uint64_t t0 = now_ns();
+  for (uint64_t i = 0; i < calls; i++) {
+    s += f((int64_t)i);
+  }
+  uint64_t dt = now_ns() - t0;
+  sink = s;
+  (void)sink;
+  return (double)dt / (double)calls;
+}
+
+int main(int argc, char** argv) {
+  uint64_t calls = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--calls") && i + 1 < argc) {
+      calls = strtoull(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--calls N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  uint8_t* far_page = map_far_page();
+  if (!far_page) {
+    fprintf(stderr, "could not map a page far from the binary\n");
+    return 1;
+  }
+  size_t far_used = 0;
+
+  bool ok = true;
+  for (int i = 0; i < FIXTURE_COUNT; i++) {
+    const Fixture& f = FIXTURES[i];
+    ok = check("direct", f, f.direct, 0, true) && ok;
+
+    A64HookFunction((void*)f.near, (void*)REPLACEMENTS[2 * i], (void**)&g_orig[2 * i]);
+    g_orig[2 * i + 1] = hook_far(f.far, REPLACEMENTS[2 * i + 1], far_page, &far_used);
+    if (!g_orig[2 * i] || !g_orig[2 * i + 1]) {
+      printf("  %-12s hook failed\n", f.name);
+      ok = false;
+      continue;
+    }
+
+    // the original alone, through its trampoline
+    ok = check("near/o", f, g_orig[2 * i], 0, true) && ok;
+    ok = check("far/o", f, g_orig[2 * i + 1], 0, true) && ok;
+    g_chain = false;
+    ok = check("near", f, f.near, HOOK_ALONE_ADD, false) && ok;
+    ok = check("far", f, f.far, HOOK_ALONE_ADD, false) && ok;
+    g_chain = true;
+    ok = check("near+o", f, f.near, HOOK_CHAIN_ADD, true) && ok;
+    ok = check("far+o", f, f.far, HOOK_CHAIN_ADD, true) && ok;
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  printf("ns/call (%llu calls)\n", (unsigned long long)calls);
+  printf("  %-12s %-12s %8s %8s %8s %8s %8s\n", "fixture", "relocator",
+         "direct", "near", "near+o", "far", "far+o");
+  for (int i = 0; i < FIXTURE_COUNT; i++) {
+    const Fixture& f = FIXTURES[i];
+    double direct = ns_per_call(f.direct, calls);
+    g_chain = false;
+    double near = ns_per_call(f.near, calls);
+    double far = ns_per_call(f.far, calls);
+    g_chain = true;
+    double near_o = ns_per_call(f.near, calls);
+    double far_o = ns_per_call(f.far, calls);
+    printf("  %-12s %-12s %8.2f %8.2f %8.2f %8.2f %8.2f\n", f.name, f.fix,
+           direct, near, near_o, far, far_o);
+  }
+  return 0;
+}
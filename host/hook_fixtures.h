@@ -0,0 +1,39 @@
+#pragma once
+
+// The fixtures of hook_fixtures.S: name, the relocator their first
+// instruction exercises, and what they compute (x is the argument). Shared
+// by hook_bench (the assembled fixtures) and hook_sim (their encodings,
+// interpreted).
+
+#include <stdint.h>
+
+#define HOOK_FIXTURES(X) \
+  X(fx_b,         "branch_imm",  x + 1) \
+  X(fx_bl,        "branch_imm",  x + 2) \
+  X(fx_bcond,     "cond_branch", x < 0 ? -x : x + 3) \
+  X(fx_cbz,       "cond_branch", x == 0 ? 44 : x + 4) \
+  X(fx_tbnz,      "cond_branch", (x & 1) ? x + 5 : x + 6) \
+  X(fx_ldr,       "loadlit",     x + 7) \
+  X(fx_ldrsw,     "loadlit",     x - 8) \
+  X(fx_ldrd,      "loadlit",     x + 9) \
+  X(fx_prfm,      "loadlit",     x + 10) \
+  X(fx_ldr_back,  "loadlit",     x + 15) \
+  X(fx_adr,       "pcreladdr",   x + 11) \
+  X(fx_adr_back,  "pcreladdr",   x + 17) \
+  X(fx_adrp,      "pcreladdr",   x + 13) \
+  X(fx_adrp_back, "pcreladdr",   x + 19)
+
+#define HOOK_FIXTURE_REF(name, fix, expr) \
+  static inline int64_t name##_ref(int64_t x) { return expr; }
+HOOK_FIXTURES(HOOK_FIXTURE_REF)
+#undef HOOK_FIXTURE_REF
+
+#define HOOK_FIXTURE_COUNT_ONE(name, fix, expr) + 1
+static const int HOOK_FIXTURE_COUNT = 0 HOOK_FIXTURES(HOOK_FIXTURE_COUNT_ONE);
+#undef HOOK_FIXTURE_COUNT_ONE
+
+// replacements: chained to the original, or standalone
+static const int64_t HOOK_CHAIN_ADD = 1000;
+static const int64_t HOOK_ALONE_ADD = 7777;
+
+static const int64_t HOOK_INPUTS[] = { -5, -1, 0, 1, 2, 3, 100, 0x12345 };
@@ -0,0 +1,637 @@
+// And64InlineHook on any Linux host: the relocators, the near trampoline
+// allocator and the hook transaction run natively (And64InlineHook.cpp built
+// with A64_HOOK_HOST), and the code they hook and generate is executed by a
+// small A64 interpreter instead of the CPU.
+//
+// Usage:
+//   hook_sim
+//
+// The fixtures are the encodings of hook_fixtures.S (llvm-mc), laid out in
+// an RWX mapping the way the assembler lays them out, with a data word on
+// the page below them and one on a page above. Like hook_bench, each one is
+// hooked near (a live A64HookCommit: B to a near thunk, trampoline from the
+// near allocator) and far (A64HookFunctionV into a page more than 256MB
+// away: LDR/BR patch, four instructions relocated), and the unhooked copy,
+// the originals through their trampolines, the hooks alone and the hooks
+// chained to the originals are checked against the C references. While the
+// near hooks are committed another thread keeps calling the fixtures, which
+// must return either the unhooked or the hooked result.
+//
+// The replacements are host functions: a branch to one of their addresses
+// calls it. Instead of ns/call it prints interpreted instructions per call,
+// which shows the cost of each patch and relocation but is not a timing;
+// hook_bench on arm64 (or under qemu-aarch64) gives those.
+//
+// Exits non-zero on any wrong result, unsupported or faulting instruction.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <array>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "And64InlineHook.hpp"
+#include "hook_fixtures.h"
+
+// --- memory the interpreter may touch: /proc/self/maps, reread on a miss ---
+
+struct Range { uint64_t lo, hi; bool r, x; };
+
+static std::vector<Range> g_ranges;
+static pthread_mutex_t g_ranges_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void read_ranges() {
+  FILE* fp = fopen("/proc/self/maps", "re");
+  if (!fp) return;
+  g_ranges.clear();
+  char line[512];
+  while (fgets(line, sizeof line, fp)) {
+    uint64_t lo, hi;
+    char perms[5];
+    if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4s", &lo, &hi, perms) != 3) continue;
+    g_ranges.push_back({ lo, hi, perms[0] == 'r', perms[2] == 'x' });
+  }
+  fclose(fp);
+}
+
+static bool lookup(uint64_t addr, size_t n, bool exec) {
+  for (const Range& r : g_ranges) {
+    if (addr >= r.lo && addr + n <= r.hi) return exec ? r.x : r.r;
+  }
+  return false;
+}
+
+// addr..addr+n is mapped readable (executable if exec); new mappings (near
+// pages allocated meanwhile) are picked up by rereading the maps once
+static bool accessible(uint64_t addr, size_t n, bool exec) {
+  pthread_mutex_lock(&g_ranges_lock);
+  bool ok = lookup(addr, n, exec);
+  if (!ok) {
+    read_ranges();
+    ok = lookup(addr, n, exec);
+  }
+  pthread_mutex_unlock(&g_ranges_lock);
+  return ok;
+}
+
+// --- interpreter ---
+
+typedef int64_t (*HostFn)(int64_t);
+
+struct Trap { uint64_t addr; HostFn fn; };
+static std::vector<Trap> g_traps; // set up before any thread runs code
+
+// x30 of a top-level call; below mmap_min_addr, so never code
+static const uint64_t RETURN_PC = 0x1000;
+static const uint64_t MAX_STEPS = 100000;
+
+struct Cpu {
+  uint64_t x[32]; // x[31] is sp
+  uint64_t v[32]; // low 64 bits of v0..v31
+  uint64_t pc;
+  bool n, z, c, vf;
+};
+
+static thread_local uint64_t t_steps;        // instructions executed
+static thread_local char     t_error[256];   // first error of this thread
+
+static void fail(const Cpu& c, uint32_t ins, const char* what) {
+  if (t_error[0]) return;
+  snprintf(t_error, sizeof t_error, "%s at pc %#" PRIx64 " (%08x)", what, c.pc, ins);
+}
+
+static int64_t sext(uint64_t v, int bits) {
+  return (int64_t)(v << (64 - bits)) >> (64 - bits);
+}
+
+static uint64_t rd(const Cpu& c, uint32_t r) { return r == 31 ? 0 : c.x[r]; }
+static uint64_t rd_sp(const Cpu& c, uint32_t r) { return c.x[r]; }
+static void wr(Cpu& c, uint32_t r, uint64_t v, bool sf) { if (r != 31) c.x[r] = sf ? v : (uint32_t)v; }
+static void wr_sp(Cpu& c, uint32_t r, uint64_t v, bool sf) { c.x[r] = sf ? v : (uint32_t)v; }
+
+static uint64_t add_with_carry(Cpu& c, uint64_t a, uint64_t b, uint64_t carry, bool sf, bool flags) {
+  uint64_t res;
+  if (sf) {
+    const unsigned __int128 u = (unsigned __int128)a + b + carry;
+    const __int128 s = (__int128)(int64_t)a + (int64_t)b + (int64_t)carry;
+    res = (uint64_t)u;
+    if (flags) { c.c = (u >> 64) != 0; c.vf = s != (int64_t)res; }
+  } else {
+    const uint64_t u = (uint64_t)(uint32_t)a + (uint32_t)b + carry;
+    const int64_t s = (int64_t)(int32_t)a + (int32_t)b + (int64_t)carry;
+    res = (uint32_t)u;
+    if (flags) { c.c = (u >> 32) != 0; c.vf = s != (int32_t)res; }
+  }
+  if (flags) {
+    c.n = sf ? (int64_t)res < 0 : (int32_t)res < 0;
+    c.z = res == 0;
+  }
+  return res;
+}
+
+static uint64_t shift_reg(uint64_t v, uint32_t type, uint32_t amount, bool sf) {
+  const uint32_t bits = sf ? 64 : 32;
+  if (!sf) v = (uint32_t)v;
+  if (amount == 0) return v;
+  switch (type) {
+  case 0: return sf ? v << amount : (uint32_t)(v << amount);
+  case 1: return v >> amount;
+  case 2: return sf ? (uint64_t)((int64_t)v >> amount) : (uint32_t)((int32_t)v >> amount);
+  default: return sf ? (v >> amount) | (v << (bits - amount))
+                     : (uint32_t)((v >> amount) | (v << (bits - amount)));
+  }
+}
+
+static bool cond_holds(const Cpu& c, uint32_t cond) {
+  bool r;
+  switch (cond >> 1) {
+  case 0: r = c.z; break;
+  case 1: r = c.c; break;
+  case 2: r = c.n; break;
+  case 3: r = c.vf; break;
+  case 4: r = c.c && !c.z; break;
+  case 5: r = c.n == c.vf; break;
+  case 6: r = c.n == c.vf && !c.z; break;
+  default: return true;
+  }
+  return (cond & 1) ? !r : r;
+}
+
+static bool load(Cpu& c, uint32_t ins, uint64_t addr, void* out, size_t n) {
+  if (!accessible(addr, n, false)) {
+    fail(c, ins, "load from unmapped memory");
+    return false;
+  }
+  memcpy(out, (const void*)addr, n);
+  return true;
+}
+
+// Executes one instruction. False on an error (see t_error).
+static bool step(Cpu& c) {
+  if (!accessible(c.pc, 4, true) || (c.pc & 3)) {
+    fail(c, 0, "jump to non-code");
+    return false;
+  }
+  const uint32_t ins = __atomic_load_n((const uint32_t*)c.pc, __ATOMIC_RELAXED);
+  const uint32_t rd_ = ins & 31, rn = (ins >> 5) & 31, rm = (ins >> 16) & 31;
+  const bool sf = ins >> 31;
+  uint64_t next = c.pc + 4;
+  t_steps++;
+
+  if ((ins & 0x7c000000u) == 0x14000000u) {                 // B, BL
+    if (sf) c.x[30] = next;
+    next = c.pc + sext(ins & 0x3ffffff, 26) * 4;
+  } else if ((ins & 0xff000010u) == 0x54000000u) {          // B.cond
+    if (cond_holds(c, ins & 15)) next = c.pc + sext((ins >> 5) & 0x7ffff, 19) * 4;
+  } else if ((ins & 0x7e000000u) == 0x34000000u) {          // CBZ, CBNZ
+    const uint64_t v = sf ? rd(c, rd_) : (uint32_t)rd(c, rd_);
+    if ((v != 0) == (((ins >> 24) & 1) != 0)) next = c.pc + sext((ins >> 5) & 0x7ffff, 19) * 4;
+  } else if ((ins & 0x7e000000u) == 0x36000000u) {          // TBZ, TBNZ
+    const uint32_t bit = ((ins >> 31) << 5) | ((ins >> 19) & 31);
+    if (((rd(c, rd_) >> bit) & 1) == ((ins >> 24) & 1)) next = c.pc + sext((ins >> 5) & 0x3fff, 14) * 4;
+  } else if ((ins & 0xff9ffc1fu) == 0xd61f0000u) {          // BR, BLR, RET
+    next = rd(c, rn);
+    if ((ins & 0x00600000u) == 0x00200000u) c.x[30] = c.pc + 4;
+  } else if ((ins & 0xfffff01fu) == 0xd503201fu) {          // NOP and other hints
+  } else if ((ins & 0x3b000000u) == 0x18000000u) {          // LDR (literal), LDRSW, PRFM
+    const uint64_t addr = c.pc + sext((ins >> 5) & 0x7ffff, 19) * 4;
+    const uint32_t opc = ins >> 30;
+    const bool simd = (ins >> 26) & 1;
+    if (simd) {
+      if (opc == 3) { fail(c, ins, "unallocated LDR (literal)"); return false; }
+      uint8_t buf[16] = {};
+      const size_t n = (size_t)4 << opc;
+      if (!load(c, ins, addr, buf, n)) return false;
+      memcpy(&c.v[rd_], buf, 8);
+      if (n == 4) c.v[rd_] &= 0xffffffffu;
+    } else if (opc == 0) {
+      uint32_t w;
+      if (!load(c, ins, addr, &w, 4)) return false;
+      wr(c, rd_, w, true);
+    } else if (opc == 1) {
+      uint64_t x;
+      if (!load(c, ins, addr, &x, 8)) return false;
+      wr(c, rd_, x, true);
+    } else if (opc == 2) {
+      int32_t w;
+      if (!load(c, ins, addr, &w, 4)) return false;
+      wr(c, rd_, (uint64_t)(int64_t)w, true);
+    } // PRFM: nothing
+  } else if ((ins & 0x1f000000u) == 0x10000000u) {          // ADR, ADRP
+    const int64_t imm = sext((((ins >> 5) & 0x7ffff) << 2) | ((ins >> 29) & 3), 21);
+    wr(c, rd_, sf ? (c.pc & ~(uint64_t)0xfff) + (uint64_t)(imm * 4096) : c.pc + imm, true);
+  } else if ((ins & 0x1f800000u) == 0x11000000u) {          // ADD/SUB (immediate)
+    const bool sub = (ins >> 30) & 1, flags = (ins >> 29) & 1;
+    uint64_t imm = (ins >> 10) & 0xfff;
+    if ((ins >> 22) & 1) imm <<= 12;
+    const uint64_t r = add_with_carry(c, rd_sp(c, rn), sub ? ~imm : imm, sub, sf, flags);
+    if (flags) wr(c, rd_, r, sf); else wr_sp(c, rd_, r, sf);
+  } else if ((ins & 0x1f200000u) == 0x0b000000u) {          // ADD/SUB (shifted register)
+    const bool sub = (ins >> 30) & 1, flags = (ins >> 29) & 1;
+    const uint64_t op2 = shift_reg(rd(c, rm), (ins >> 22) & 3, (ins >> 10) & 63, sf);
+    wr(c, rd_, add_with_carry(c, rd(c, rn), sub ? ~op2 : op2, sub, sf, flags), sf);
+  } else if ((ins & 0x1f000000u) == 0x0a000000u) {          // AND/ORR/EOR/ANDS (shifted register)
+    uint64_t op2 = shift_reg(rd(c, rm), (ins >> 22) & 3, (ins >> 10) & 63, sf);
+    if ((ins >> 21) & 1) op2 = ~op2;
+    const uint64_t a = rd(c, rn);
+    uint64_t r;
+    switch ((ins >> 29) & 3) {
+    case 0: r = a & op2; break;
+    case 1: r = a | op2; break;
+    case 2: r = a ^ op2; break;
+    default:
+      r = a & op2;
+      c.n = sf ? (int64_t)r < 0 : (int32_t)r < 0;
+      c.z = (sf ? r : (uint32_t)r) == 0;
+      c.c = c.vf = false;
+      break;
+    }
+    wr(c, rd_, r, sf);
+  } else if ((ins & 0x1f800000u) == 0x12800000u) {          // MOVN, MOVZ, MOVK
+    const uint32_t opc = (ins >> 29) & 3, pos = ((ins >> 21) & 3) * 16;
+    const uint64_t imm = (uint64_t)((ins >> 5) & 0xffff) << pos;
+    if (opc == 1) { fail(c, ins, "unallocated move wide"); return false; }
+    const uint64_t r = opc == 0 ? ~imm : opc == 2 ? imm : (rd(c, rd_) & ~((uint64_t)0xffff << pos)) | imm;
+    wr(c, rd_, r, sf);
+  } else if ((ins & 0x3fc00000u) == 0x39400000u) {          // LDR/LDRB/LDRH Wt/Xt, [Xn, #imm]
+    const uint32_t size = ins >> 30;
+    const uint64_t addr = rd_sp(c, rn) + ((uint64_t)((ins >> 10) & 0xfff) << size);
+    uint64_t v = 0;
+    if (!load(c, ins, addr, &v, (size_t)1 << size)) return false;
+    wr(c, rd_, v, true);
+  } else if ((ins & 0xfffffc00u) == 0x9e660000u) {          // FMOV Xd, Dn
+    wr(c, rd_, c.v[rn], true);
+  } else {
+    fail(c, ins, "unsupported instruction");
+    return false;
+  }
+  c.pc = next;
+  return true;
+}
+
+// Calls the A64 code at fn with x0 = arg until it returns. Errors are kept in
+// t_error (the first one) and give 0.
+static int64_t sim_call(uint64_t fn, int64_t arg) {
+  Cpu c;
+  memset(&c, 0, sizeof c);
+  c.x[0] = (uint64_t)arg;
+  c.x[30] = RETURN_PC;
+  c.pc = fn;
+  for (uint64_t n = 0; n < MAX_STEPS; n++) {
+    if (c.pc == RETURN_PC) return (int64_t)c.x[0];
+    bool trapped = false;
+    for (const Trap& t : g_traps) {
+      if (t.addr == c.pc) {
+        c.x[0] = (uint64_t)t.fn((int64_t)c.x[0]);
+        c.pc = c.x[30];
+        trapped = true;
+        break;
+      }
+    }
+    if (!trapped && !step(c)) return 0;
+  }
+  fail(c, 0, "no return");
+  return 0;
+}
+
+// --- fixtures ---
+
+static const uint32_t NOP = 0xd503201fu;
+
+// A fixture's words: four in front of the entry point (literals of the
+// _back fixtures), then the code from its 16-byte aligned entry.
+struct FixtureCode {
+  uint32_t pre[4];
+  std::vector<uint32_t> code;
+};
+
+enum { FIXUP_NONE, FIXUP_BL_ADD2, FIXUP_ADRP_DATA, FIXUP_ADRP_DATA_LO };
+
+struct Fixture {
+  const char* name;
+  const char* fix;
+  int64_t (*ref)(int64_t);
+  FixtureCode words;
+  int fixup;
+  uint64_t direct, near, far; // entry points of the three copies
+};
+
+#define P_NOP { NOP, NOP, NOP, NOP }
+#define P_QUAD(v) { v, 0, NOP, NOP }
+
+static Fixture FIXTURES[] = {
+  { "fx_b", "branch_imm", fx_b_ref,
+    { P_NOP, { 0x14000005, NOP, NOP, NOP, NOP, 0x91000400, 0xd65f03c0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_bl", "branch_imm", fx_bl_ref,
+    { P_NOP, { 0xaa1e03e9, 0x94000000, 0xaa0903fe, 0xd65f03c0, NOP } }, FIXUP_BL_ADD2, 0, 0, 0 },
+  { "fx_bcond", "cond_branch", fx_bcond_ref,
+    { P_NOP, { 0xf100001f, 0x5400008b, 0x91000c00, 0xd65f03c0, NOP, 0xcb0003e0, 0xd65f03c0 } },
+    FIXUP_NONE, 0, 0, 0 },
+  { "fx_cbz", "cond_branch", fx_cbz_ref,
+    { P_NOP, { 0xb4000060, 0x91001000, 0xd65f03c0, 0xd2800580, 0xd65f03c0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_tbnz", "cond_branch", fx_tbnz_ref,
+    { P_NOP, { 0x37000060, 0x91001800, 0xd65f03c0, 0x91001400, 0xd65f03c0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_ldr", "loadlit", fx_ldr_ref,
+    { P_NOP, { 0x580000c1, 0x8b010000, 0xd65f03c0, NOP, NOP, NOP, 7, 0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_ldrsw", "loadlit", fx_ldrsw_ref,
+    { P_NOP, { 0x980000a1, 0x8b010000, 0xd65f03c0, NOP, NOP, 0xfffffff8 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_ldrd", "loadlit", fx_ldrd_ref,
+    { P_NOP, { 0x5c0000c1, 0x9e660021, 0x8b010000, 0xd65f03c0, NOP, NOP, 9, 0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_prfm", "loadlit", fx_prfm_ref,
+    { P_NOP, { 0xd80000a0, 0x91002800, 0xd65f03c0, NOP, NOP, 0, 0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_ldr_back", "loadlit", fx_ldr_back_ref,
+    { P_QUAD(15), { 0x58ffff81, 0x8b010000, 0xd65f03c0, NOP, NOP } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_adr", "pcreladdr", fx_adr_ref,
+    { P_NOP, { 0x100000c1, 0xf9400021, 0x8b010000, 0xd65f03c0, NOP, NOP, 11, 0 } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_adr_back", "pcreladdr", fx_adr_back_ref,
+    { P_QUAD(17), { 0x10ffff81, 0xf9400021, 0x8b010000, 0xd65f03c0, NOP } }, FIXUP_NONE, 0, 0, 0 },
+  { "fx_adrp", "pcreladdr", fx_adrp_ref,
+    { P_NOP, { 0x90000001, 0xf9400021, 0x8b010000, 0xd65f03c0, NOP } }, FIXUP_ADRP_DATA, 0, 0, 0 },
+  { "fx_adrp_back", "pcreladdr", fx_adrp_back_ref,
+    { P_NOP, { 0x90000001, 0xf9400021, 0x8b010000, 0xd65f03c0, NOP } }, FIXUP_ADRP_DATA_LO, 0, 0, 0 },
+};
+static const int FIXTURE_COUNT = sizeof(FIXTURES) / sizeof(FIXTURES[0]);
+static_assert(FIXTURE_COUNT == HOOK_FIXTURE_COUNT, "hook_fixtures.h and FIXTURES differ");
+
+// Layout of the fixture mapping: the page below the code holds fx_data_lo,
+// then one 64-byte slot per fixture copy (entry at +16), fx_add2, and
+// fx_data on the page after the code.
+static const size_t PAGE = 4096;
+static const size_t SLOT = 64;
+static const size_t DATA_LO = 0x100;   // offset of fx_data_lo in page 0
+static const size_t DATA = 0x208;      // offset of fx_data in its page
+static const size_t REGION_PAGES = 4;
+
+static uint32_t adrp(uint32_t ins, uint64_t pc, uint64_t target) {
+  const int64_t pages = (int64_t)(target >> 12) - (int64_t)(pc >> 12);
+  const uint32_t imm = (uint32_t)pages & 0x1fffff;
+  return (ins & 0x9f00001fu) | ((imm & 3) << 29) | ((imm >> 2) << 5);
+}
+
+static uint32_t ldr_lo12(uint32_t ins, uint64_t target) {
+  return (ins & ~(0xfffu << 10)) | ((uint32_t)((target & 0xfff) >> 3) << 10);
+}
+
+static uint8_t* lay_out_fixtures() {
+  void* m = mmap(nullptr, REGION_PAGES * PAGE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) return nullptr;
+  uint8_t* base = (uint8_t*)m;
+  const uint64_t data_lo = (uint64_t)base + DATA_LO;
+  const uint64_t data = (uint64_t)base + 3 * PAGE + DATA;
+  const uint64_t add2 = (uint64_t)base + 2 * PAGE;
+  const uint64_t v_lo = 19, v = 13;
+  memcpy((void*)data_lo, &v_lo, 8);
+  memcpy((void*)data, &v, 8);
+  const uint32_t add2_code[] = { 0x91000800, 0xd65f03c0 }; // add x0, x0, #2; ret
+  memcpy((void*)add2, add2_code, sizeof add2_code);
+
+  uint32_t* slot = (uint32_t*)(base + PAGE);
+  for (Fixture& f : FIXTURES) {
+    for (uint64_t* entry : { &f.direct, &f.near, &f.far }) {
+      for (size_t i = 0; i < SLOT / 4; i++) slot[i] = NOP;
+      memcpy(slot, f.words.pre, sizeof f.words.pre);
+      uint32_t* code = slot + 4;
+      memcpy(code, f.words.code.data(), f.words.code.size() * 4);
+      const uint64_t pc = (uint64_t)code;
+      if (f.fixup == FIXUP_BL_ADD2) {
+        code[1] = 0x94000000u | ((uint32_t)((int64_t)(add2 - (pc + 4)) >> 2) & 0x3ffffff);
+      } else if (f.fixup == FIXUP_ADRP_DATA || f.fixup == FIXUP_ADRP_DATA_LO) {
+        const uint64_t target = f.fixup == FIXUP_ADRP_DATA ? data : data_lo;
+        code[0] = adrp(code[0], pc, target);
+        code[1] = ldr_lo12(code[1], target);
+      }
+      *entry = pc;
+      slot += SLOT / 4;
+    }
+  }
+  if ((uint8_t*)slot > base + 2 * PAGE) {
+    fprintf(stderr, "fixtures do not fit in one page\n");
+    return nullptr;
+  }
+  return base;
+}
+
+// --- hooks ---
+
+static volatile bool g_chain;
+static uint64_t g_orig[HOOK_FIXTURE_COUNT * 2];
+
+template <size_t I>
+static int64_t replacement(int64_t x) {
+  return g_chain ? sim_call(g_orig[I], x) + HOOK_CHAIN_ADD : x + HOOK_ALONE_ADD;
+}
+
+template <size_t... I>
+static constexpr std::array<HostFn, sizeof...(I)> replacements(std::index_sequence<I...>) {
+  return { { replacement<I>... } };
+}
+
+static const std::array<HostFn, HOOK_FIXTURE_COUNT * 2> REPLACEMENTS =
+  replacements(std::make_index_sequence<HOOK_FIXTURE_COUNT * 2>());
+
+static bool within(uint64_t a, uint64_t b, uint64_t range) {
+  return (a > b ? a - b : b - a) < range;
+}
+
+// An RWX page at least 256MB from the fixtures, nullptr if none was found.
+static uint8_t* map_far_page(uint64_t from) {
+  const uint64_t hints[] = { from + (4ull << 30), from - (4ull << 30), from + (64ull << 30), 0 };
+  for (uint64_t hint : hints) {
+    void* p = mmap((void*)(hint & ~(uint64_t)(PAGE - 1)), PAGE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) continue;
+    if (!within((uint64_t)p, from, 256ull << 20)) return (uint8_t*)p;
+    munmap(p, PAGE);
+  }
+  return nullptr;
+}
+
+// hook_bench's far layout: LDR/BR thunk to rep and the trampoline both in
+// the far page. Returns the trampoline.
+static uint64_t hook_far(uint64_t fn, HostFn rep, uint8_t* far_page, size_t* far_used) {
+  static const size_t THUNK = 16, TRAMPOLINE = 256;
+  if (*far_used + THUNK + TRAMPOLINE > PAGE) return 0;
+
+  uint32_t* thunk = (uint32_t*)(far_page + *far_used);
+  thunk[0] = 0x58000051u; // LDR X17, #0x8
+  thunk[1] = 0xd61f0220u; // BR X17
+  memcpy(thunk + 2, &rep, sizeof(rep));
+
+  void* trampoline = far_page + *far_used + THUNK;
+  *far_used += THUNK + TRAMPOLINE;
+  return (uint64_t)A64HookFunctionV((void*)fn, thunk, trampoline, TRAMPOLINE);
+}
+
+// --- checks ---
+
+static bool check(const char* what, const Fixture& f, uint64_t fn, int64_t add, bool ref) {
+  for (int64_t x : HOOK_INPUTS) {
+    t_error[0] = 0;
+    const int64_t want = ref ? f.ref(x) + add : x + add;
+    const int64_t got = sim_call(fn, x);
+    if (t_error[0]) {
+      printf("  %-12s %-6s f(%lld): %s\n", f.name, what, (long long)x, t_error);
+      return false;
+    }
+    if (got != want) {
+      printf("  %-12s %-6s f(%lld) = %lld, want %lld\n", f.name, what,
+             (long long)x, (long long)got, (long long)want);
+      return false;
+    }
+  }
+  return true;
+}
+
+static double insns_per_call(uint64_t fn) {
+  const uint64_t s0 = t_steps;
+  for (int64_t x : HOOK_INPUTS) sim_call(fn, x);
+  return (double)(t_steps - s0) / (double)(sizeof(HOOK_INPUTS) / sizeof(HOOK_INPUTS[0]));
+}
+
+// Calls the near copies while main() commits their hooks; each result must
+// be the unhooked or the (standalone) hooked one.
+struct LiveCaller {
+  std::atomic<bool>     stop{false};
+  std::atomic<uint64_t> calls{0};
+  std::atomic<bool>     wrong{false};
+  char                  error[256]{};
+};
+
+static void* live_caller(void* arg) {
+  LiveCaller* lc = (LiveCaller*)arg;
+  for (uint64_t i = 0; !lc->stop.load(); i++) {
+    const Fixture& f = FIXTURES[i % FIXTURE_COUNT];
+    const int64_t x = HOOK_INPUTS[i % (sizeof(HOOK_INPUTS) / sizeof(HOOK_INPUTS[0]))];
+    t_error[0] = 0;
+    const int64_t got = sim_call(f.near, x);
+    if (t_error[0] || (got != f.ref(x) && got != x + HOOK_ALONE_ADD)) {
+      snprintf(lc->error, sizeof lc->error, "%s f(%lld) = %lld during the commit %s", f.name,
+               (long long)x, (long long)got, t_error);
+      lc->wrong = true;
+      break;
+    }
+    lc->calls++;
+  }
+  return nullptr;
+}
+
+static void wait_calls(const LiveCaller& lc, uint64_t n) {
+  const uint64_t target = lc.calls.load() + n;
+  while (lc.calls.load() < target && !lc.wrong.load()) sched_yield();
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: %s\n", argv[0]);
+    return 1;
+  }
+
+  uint8_t* region = lay_out_fixtures();
+  if (!region) {
+    fprintf(stderr, "could not map the fixtures\n");
+    return 1;
+  }
+  uint8_t* far_page = map_far_page((uint64_t)region);
+  if (!far_page) {
+    fprintf(stderr, "could not map a page far from the fixtures\n");
+    return 1;
+  }
+  size_t far_used = 0;
+  for (size_t i = 0; i < REPLACEMENTS.size(); i++) {
+    g_traps.push_back({ (uint64_t)REPLACEMENTS[i], REPLACEMENTS[i] });
+  }
+  read_ranges();
+
+  bool ok = true;
+  for (const Fixture& f : FIXTURES) ok = check("direct", f, f.direct, 0, true) && ok;
+  if (!ok) return 1;
+
+  // near: one live transaction for all of them, with calls running
+  A64HookTxn txn;
+  A64HookBegin(&txn);
+  txn.live = 1;
+  for (int i = 0; i < FIXTURE_COUNT; i++) {
+    A64HookAdd(&txn, (void*)FIXTURES[i].near, (void*)REPLACEMENTS[2 * i], (void**)&g_orig[2 * i]);
+  }
+  g_chain = false;
+  LiveCaller lc;
+  pthread_t caller;
+  pthread_create(&caller, nullptr, live_caller, &lc);
+  wait_calls(lc, 1000);
+  const uint64_t calls_before = lc.calls.load();
+  const int st = A64HookCommit(&txn);
+  const uint64_t calls_during = lc.calls.load() - calls_before;
+  wait_calls(lc, 1000);
+  lc.stop = true;
+  pthread_join(caller, nullptr);
+  if (lc.wrong) {
+    printf("  live commit: %s\n", lc.error);
+    ok = false;
+  }
+  if (st != A64_HOOK_OK) {
+    printf("  live commit failed, status %d\n", st);
+    return 1;
+  }
+  for (int i = 0; i < FIXTURE_COUNT; i++) {
+    const Fixture& f = FIXTURES[i];
+    const A64HookEntry& h = txn.hooks[i];
+    const uint32_t patch = *(const uint32_t*)f.near;
+    const uint64_t dest = f.near + sext(patch & 0x3ffffff, 26) * 4;
+    if (h.npatch != 1 || (patch & 0xfc000000u) != 0x14000000u) {
+      printf("  %-12s near patch is %d words, not a B\n", f.name, h.npatch);
+      ok = false;
+    } else if (!within(g_orig[2 * i], f.near, 128ull << 20) || !within(dest, f.near, 128ull << 20)) {
+      printf("  %-12s trampoline %#" PRIx64 " / thunk %#" PRIx64 " not near %#" PRIx64 "\n",
+             f.name, g_orig[2 * i], dest, f.near);
+      ok = false;
+    }
+  }
+
+  for (int i = 0; i < FIXTURE_COUNT; i++) {
+    const Fixture& f = FIXTURES[i];
+    g_orig[2 * i + 1] = hook_far(f.far, REPLACEMENTS[2 * i + 1], far_page, &far_used);
+    if (!g_orig[2 * i] || !g_orig[2 * i + 1]) {
+      printf("  %-12s hook failed\n", f.name);
+      ok = false;
+      continue;
+    }
+
+    // the original alone, through its trampoline
+    ok = check("near/o", f, g_orig[2 * i], 0, true) && ok;
+    ok = check("far/o", f, g_orig[2 * i + 1], 0, true) && ok;
+    g_chain = false;
+    ok = check("near", f, f.near, HOOK_ALONE_ADD, false) && ok;
+    ok = check("far", f, f.far, HOOK_ALONE_ADD, false) && ok;
+    g_chain = true;
+    ok = check("near+o", f, f.near, HOOK_CHAIN_ADD, true) && ok;
+    ok = check("far+o", f, f.far, HOOK_CHAIN_ADD, true) && ok;
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  printf("live commit of %d near hooks: ok (%llu calls from another thread finished during it)\n",
+         FIXTURE_COUNT, (unsigned long long)calls_during);
+  printf("A64 instructions/call (interpreted; the replacement itself counts 0)\n");
+  printf("  %-12s %-12s %8s %8s %8s %8s %8s\n", "fixture", "relocator",
+         "direct", "near", "near+o", "far", "far+o");
+  for (const Fixture& f : FIXTURES) {
+    const double direct = insns_per_call(f.direct);
+    g_chain = false;
+    const double near = insns_per_call(f.near);
+    const double far = insns_per_call(f.far);
+    g_chain = true;
+    const double near_o = insns_per_call(f.near);
+    const double far_o = insns_per_call(f.far);
+    printf("  %-12s %-12s %8.1f %8.1f %8.1f %8.1f %8.1f\n", f.name, f.fix,
+           direct, near, near_o, far, far_o);
+  }
+  return 0;
+}
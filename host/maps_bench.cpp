@@ -0,0 +1,388 @@
+// Module base lookups: the sorted ModuleTable and dl_iterate_phdr() against
+// the /proc/<pid>/maps scans they replaced.
+//
+// Usage:
+//   maps_bench [--modules N] [--lookups N] [--iters N] [--keep PATH]
+//
+// Writes a synthetic maps file shaped like surfaceflinger's: N modules
+// (default 1200) of five mappings each (r--p at offset 0, r-xp, r--p relro,
+// rw-p, anonymous .bss), some under the same file name in two directories,
+// plus anonymous, [anon:...] and stack mappings in between. That makes it
+// over 7000 lines. --keep writes it to PATH and leaves it there.
+//
+// Every module is looked up by full path and by its file name, and a few
+// names that are not mapped. Each result of the table must equal the old
+// linear scan: the ELF base, the mapping at offset 0 (else the lowest), and
+// the executable extent. Then for the lookups it prints:
+//  - reread:   fopen + fgets + strstr + sscanf of the whole file per lookup,
+//              like get_sf_base() in sf_rotate.cpp
+//  - scan:     one sscanf pass into a vector, then a linear strstr scan per
+//              lookup, like dlopen64's ModuleMaps
+//  - table:    ModuleTable::load_file() once, then a binary search per lookup
+// For this process, module_self() (dl_iterate_phdr(), no I/O) must agree
+// with a ModuleTable of /proc/self/maps for libc and the executable. Its time
+// per lookup is printed next to a reread of /proc/self/maps.
+// Exits non-zero on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "module_map.h"
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*, deterministic across hosts
+struct Rng {
+  uint64_t s;
+  explicit Rng(uint64_t seed) : s(seed ? seed : 0x9e3779b97f4a7c15ull) {}
+  uint64_t next() {
+    s ^= s >> 12; s ^= s << 25; s ^= s >> 27;
+    return s * 2685821657736338717ull;
+  }
+  size_t below(size_t n) { return (size_t)(next() % n); }
+};
+
+/* synthetic maps */
+
+static const char* const DIRS[] = {
+  "/system/lib64", "/system/lib64/hw", "/vendor/lib64", "/vendor/lib64/hw",
+  "/apex/com.android.runtime/lib64/bionic", "/apex/com.android.art/lib64",
+  "/system_ext/lib64", "/apex/com.android.vndk.v33/lib64",
+};
+static const size_t NDIRS = sizeof(DIRS) / sizeof(DIRS[0]);
+
+struct Module {
+  std::string path;
+  std::string name; // file name
+  ModuleInfo  want;
+};
+
+static std::string gen_maps(size_t nmod, std::vector<Module>& mods) {
+  Rng rng(0x6d617073);
+  mods.clear();
+  for (size_t i = 0; i < nmod; i++) {
+    Module m;
+    char name[64];
+    if (i == 0) {
+      snprintf(name, sizeof name, "surfaceflinger");
+      m.path = std::string("/system/bin/") + name;
+    } else if (i == 1) {
+      snprintf(name, sizeof name, "linker64");
+      m.path = std::string("/system/bin/") + name;
+    } else if (i == 2) {
+      snprintf(name, sizeof name, "libc.so");
+      m.path = std::string(DIRS[4]) + "/" + name;
+    } else if (i % 50 == 0) {
+      // the same file name as the module before it, in another directory
+      snprintf(name, sizeof name, "%s", mods.back().name.c_str());
+      m.path = std::string(DIRS[(i / 50) % NDIRS]) + "/" + name;
+      if (m.path == mods.back().path) m.path = std::string(DIRS[0]) + "/x/" + name;
+    } else {
+      snprintf(name, sizeof name, "lib%s%zu.so", rng.below(2) ? "android_" : "vendor.hw.", i);
+      m.path = std::string(DIRS[rng.below(NDIRS)]) + "/" + name;
+    }
+    m.name = name;
+    mods.push_back(m);
+  }
+
+  // place the modules in random order, ascending addresses
+  std::vector<size_t> order(nmod);
+  for (size_t i = 0; i < nmod; i++) order[i] = i;
+  for (size_t i = nmod; i > 1; i--) std::swap(order[i - 1], order[rng.below(i)]);
+
+  std::string out;
+  char line[512];
+  uintptr_t addr = 0x5a00000000ull;
+  unsigned long inode = 1000;
+  auto emit = [&](uintptr_t lo, uintptr_t hi, const char* perms, uintptr_t off,
+                  const char* dev, unsigned long ino, const char* path) {
+    int n = snprintf(line, sizeof line, "%lx-%lx %s %08lx %s %-10lu", (unsigned long)lo,
+                     (unsigned long)hi, perms, (unsigned long)off, dev, ino);
+    out.append(line, (size_t)n);
+    if (path && *path) {
+      out.append(16, ' ');
+      out += path;
+    }
+    out += '\n';
+  };
+  for (size_t k = 0; k < nmod; k++) {
+    Module& m = mods[order[k]];
+    // unrelated mappings in between
+    for (size_t j = rng.below(3); j > 0; j--) {
+      const uintptr_t len = (1 + rng.below(64)) << 12;
+      emit(addr, addr + len, "rw-p", 0, "00:00", 0,
+           rng.below(2) ? "[anon:scudo:primary]" : "");
+      addr += len + (rng.below(4) << 12);
+    }
+    const uintptr_t ro = (1 + rng.below(16)) << 12, text = (1 + rng.below(128)) << 12;
+    const uintptr_t relro = (1 + rng.below(4)) << 12, data = (1 + rng.below(4)) << 12;
+    const uintptr_t base = addr;
+    const unsigned long ino = inode++;
+    emit(addr, addr + ro, "r--p", 0, "fd:05", ino, m.path.c_str());
+    addr += ro;
+    emit(addr, addr + text, "r-xp", ro, "fd:05", ino, m.path.c_str());
+    m.want = { base, addr, addr + text };
+    addr += text;
+    emit(addr, addr + relro, "r--p", ro + text, "fd:05", ino, m.path.c_str());
+    addr += relro;
+    emit(addr, addr + data, "rw-p", ro + text + relro, "fd:05", ino, m.path.c_str());
+    addr += data;
+    emit(addr, addr + 0x1000, "rw-p", 0, "00:00", 0, "[anon:.bss]");
+    addr += 0x1000 + ((1 + rng.below(16)) << 12);
+  }
+  emit(0x7ff0000000ull, 0x7ff0021000ull, "rw-p", 0, "00:00", 0, "[stack]");
+  return out;
+}
+
+/* the scans being replaced */
+
+// get_sf_base() before ModuleTable: whole file per lookup
+static ModuleInfo reread_base(const char* maps, const char* needle) {
+  ModuleInfo m{ 0, 0, 0 };
+  FILE* f = fopen(maps, "r");
+  if (!f) return m;
+  char line[512];
+  uintptr_t base_with_off0 = 0;
+  uintptr_t base_min_any = (uintptr_t)-1;
+  uintptr_t x_lo = (uintptr_t)-1, x_hi = 0;
+  while (fgets(line, sizeof line, f)) {
+    if (strstr(line, needle) == nullptr) continue;
+    unsigned long start = 0, end = 0, off = 0;
+    char perms[5] = {0};
+    if (sscanf(line, "%lx-%lx %4s %lx", &start, &end, perms, &off) != 4) continue;
+    if (off == 0 && base_with_off0 == 0) base_with_off0 = (uintptr_t)start;
+    if ((uintptr_t)start < base_min_any) base_min_any = (uintptr_t)start;
+    if (strchr(perms, 'x')) {
+      if ((uintptr_t)start < x_lo) x_lo = (uintptr_t)start;
+      if ((uintptr_t)end > x_hi) x_hi = (uintptr_t)end;
+    }
+  }
+  fclose(f);
+  m.base = base_with_off0 ? base_with_off0 : base_min_any != (uintptr_t)-1 ? base_min_any : 0;
+  if (x_hi) {
+    m.text_lo = x_lo;
+    m.text_hi = x_hi;
+  }
+  return m;
+}
+
+// dlopen64's ModuleMaps before ModuleTable: one sscanf pass, linear lookups
+struct ScanMaps {
+  struct Entry {
+    uintptr_t start;
+    uintptr_t offset;
+    bool      exec;
+    char      path[256];
+  };
+  std::vector<Entry> entries;
+
+  bool load(const char* maps) {
+    FILE* f = fopen(maps, "re");
+    if (!f) return false;
+    char line[1024];
+    while (fgets(line, sizeof line, f)) {
+      unsigned long start = 0, off = 0; char perms[5] = {0}; int path_at = 0;
+      if (sscanf(line, "%lx-%*x %4s %lx %*s %*s %n", &start, perms, &off, &path_at) != 3 || !path_at) continue;
+      const char* path = line + path_at;
+      if (*path != '/' && *path != '[') continue;
+      Entry e{};
+      e.start = (uintptr_t)start;
+      e.offset = (uintptr_t)off;
+      e.exec = strchr(perms, 'x') != nullptr;
+      snprintf(e.path, sizeof e.path, "%.*s", (int)strcspn(path, "\n"), path);
+      entries.push_back(e);
+    }
+    fclose(f);
+    return true;
+  }
+
+  uintptr_t elf_base(const char* needle) const {
+    uintptr_t lowest = 0;
+    for (const Entry& e : entries) {
+      if (!strstr(e.path, needle)) continue;
+      if (e.offset == 0) return e.start;
+      if (!lowest || e.start < lowest) lowest = e.start;
+    }
+    return lowest;
+  }
+};
+
+static bool same(const ModuleInfo& a, const ModuleInfo& b) {
+  return a.base == b.base && a.text_lo == b.text_lo && a.text_hi == b.text_hi;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--modules N] [--lookups N] [--iters N] [--keep PATH]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  size_t nmod = 1200, nlookups = 200;
+  int iters = 5;
+  const char* keep = nullptr;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!v) { usage(argv[0]); return 1; }
+    if (!strcmp(a, "--modules")) nmod = (size_t)atol(v);
+    else if (!strcmp(a, "--lookups")) nlookups = (size_t)atol(v);
+    else if (!strcmp(a, "--iters")) iters = atoi(v);
+    else if (!strcmp(a, "--keep")) keep = v;
+    else { usage(argv[0]); return 1; }
+    i++;
+  }
+  if (nmod < 3 || nlookups < 1 || iters < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Module> mods;
+  const std::string text = gen_maps(nmod, mods);
+  char path[64] = "/tmp/maps_bench.XXXXXX";
+  const char* maps = keep;
+  if (!keep) {
+    const int fd = mkstemp(path);
+    if (fd < 0) { perror("mkstemp"); return 1; }
+    close(fd);
+    maps = path;
+  }
+  FILE* f = fopen(maps, "w");
+  if (!f || fwrite(text.data(), 1, text.size(), f) != text.size() || fclose(f) != 0) {
+    fprintf(stderr, "cannot write %s\n", maps);
+    return 1;
+  }
+  const size_t lines = (size_t)std::count(text.begin(), text.end(), '\n');
+  printf("maps: %zu lines, %zu modules, %zu kB (%s)\n", lines, nmod, text.size() / 1024, maps);
+
+  // correctness: every module by path and by name, plus misses
+  ModuleTable table;
+  ScanMaps scan;
+  bool ok = table.load_file(maps) && scan.load(maps);
+  if (!ok) fprintf(stderr, "FAIL: cannot load %s\n", maps);
+  size_t checked = 0;
+  for (size_t i = 0; ok && i < mods.size(); i++) {
+    const Module& m = mods[i];
+    const ModuleInfo* t = table.find(m.path.c_str());
+    if (!t || !same(*t, m.want) || !same(*t, reread_base(maps, m.path.c_str())) ||
+        scan.elf_base(m.path.c_str()) != t->base) {
+      fprintf(stderr, "FAIL: %s\n", m.path.c_str());
+      ok = false;
+    }
+    // by name: the lowest of the modules with that name, as the old scan
+    const ModuleInfo* n = table.find(m.name.c_str());
+    if (!n || n->base != scan.elf_base(m.name.c_str())) {
+      fprintf(stderr, "FAIL: %s\n", m.name.c_str());
+      ok = false;
+    }
+    checked += 2;
+  }
+  static const char* const MISSES[] = { "libnothere.so", "c.so", "bin/surface", "/surfaceflinger2" };
+  for (const char* miss : MISSES) {
+    if (ok && table.find(miss)) {
+      fprintf(stderr, "FAIL: %s found\n", miss);
+      ok = false;
+    }
+    checked++;
+  }
+  if (!ok) {
+    if (!keep) unlink(maps);
+    return 1;
+  }
+  printf("  %zu lookups: table, rescan and linear scan agree (%zu modules in the table)\n",
+         checked, table.size());
+
+  // timing: nlookups names spread over the table
+  std::vector<const char*> needles;
+  for (size_t i = 0; i < nlookups; i++) {
+    const Module& m = mods[(i * 7919) % mods.size()];
+    needles.push_back(i & 1 ? m.name.c_str() : m.path.c_str());
+  }
+
+  uint64_t reread_ns = UINT64_MAX, scan_load = UINT64_MAX, scan_find = UINT64_MAX;
+  uint64_t table_load = UINT64_MAX, table_find = UINT64_MAX;
+  uintptr_t sink = 0;
+  const size_t nreread = std::min(nlookups, (size_t)20);
+  for (int it = 0; it < iters; it++) {
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < nreread; i++) sink += reread_base(maps, needles[i]).base;
+    reread_ns = std::min(reread_ns, (now_ns() - t0) / nreread);
+
+    ScanMaps s;
+    t0 = now_ns();
+    s.load(maps);
+    uint64_t t1 = now_ns();
+    for (const char* n : needles) sink += s.elf_base(n);
+    scan_load = std::min(scan_load, t1 - t0);
+    scan_find = std::min(scan_find, (now_ns() - t1) / nlookups);
+
+    ModuleTable t;
+    t0 = now_ns();
+    t.load_file(maps);
+    t1 = now_ns();
+    for (const char* n : needles) {
+      const ModuleInfo* m = t.find(n);
+      sink += m ? m->base : 0;
+    }
+    table_load = std::min(table_load, t1 - t0);
+    table_find = std::min(table_find, (now_ns() - t1) / nlookups);
+  }
+
+  printf("\n%zu lookups (best of %d)  setup ms   per lookup us   all lookups ms\n", nlookups,
+         iters);
+  printf("  %-10s %16s %15.3f %16.3f\n", "reread", "-", (double)reread_ns / 1e3,
+         (double)reread_ns * (double)nlookups / 1e6);
+  printf("  %-10s %16.3f %15.3f %16.3f\n", "scan", (double)scan_load / 1e6,
+         (double)scan_find / 1e3, (double)(scan_load + scan_find * nlookups) / 1e6);
+  printf("  %-10s %16.3f %15.3f %16.3f\n", "table", (double)table_load / 1e6,
+         (double)table_find / 1e3, (double)(table_load + table_find * nlookups) / 1e6);
+
+  // this process: dl_iterate_phdr() against its own maps
+  ModuleTable self;
+  if (!self.load(getpid())) {
+    fprintf(stderr, "FAIL: cannot read /proc/self/maps\n");
+    ok = false;
+  }
+  const char* exe = strrchr(argv[0], '/');
+  exe = exe ? exe + 1 : argv[0];
+  const char* const SELF[] = { "libc.so.6", exe };
+  uint64_t self_ns = UINT64_MAX, self_reread_ns = UINT64_MAX;
+  for (const char* n : SELF) {
+    ModuleInfo m;
+    const ModuleInfo* t = self.find(n);
+    if (!module_self(n, &m) || !t || !same(m, *t)) {
+      fprintf(stderr, "FAIL: module_self(%s) disagrees with /proc/self/maps\n", n);
+      ok = false;
+      continue;
+    }
+    for (int it = 0; it < iters; it++) {
+      uint64_t t0 = now_ns();
+      for (int k = 0; k < 100; k++) {
+        module_self(n, &m);
+        sink += m.base;
+      }
+      self_ns = std::min(self_ns, (now_ns() - t0) / 100);
+      t0 = now_ns();
+      sink += reread_base("/proc/self/maps", n).base;
+      self_reread_ns = std::min(self_reread_ns, now_ns() - t0);
+    }
+  }
+  if (ok) {
+    printf("\nthis process (%s, %s)   per lookup us\n", SELF[0], exe);
+    printf("  %-22s %15.3f\n", "module_self", (double)self_ns / 1e3);
+    printf("  %-22s %15.3f\n", "reread /proc/self/maps", (double)self_reread_ns / 1e3);
+  }
+
+  if (!keep) unlink(maps);
+  if (sink == 1) printf("\n"); // keep the lookups
+  return ok ? 0 : 1;
+}
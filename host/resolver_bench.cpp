@@ -0,0 +1,686 @@
+// Host benchmark for the .gnu_debugdata resolver.
+//
+// Usage:
+//   resolver_bench <fixture.elf> [--iters N] [--cache PATH] [--only stream|tiers]
+//                  [--exported N]
+//
+// Reports, for the fixture written by fixture_gen (or any real stripped
+// surfaceflinger):
+//  - per-phase wall time of a full resolution (map, decompress, section
+//    parse, lookup) as min / median over N runs, and peak RSS
+//  - the old per-symbol std::string vector against SymIndex (allocations,
+//    build and lookup time)
+//  - the layered resolver (.dynsym / .symtab before .gnu_debugdata), with
+//    the tier that answered each name; with --exported N (the fixture_gen
+//    option) the first N must come from .dynsym and the rest from
+//    .gnu_debugdata (--only tiers runs just this part)
+//  - cold vs warm offset cache
+//  - xz CRC32 / CRC64 against a bytewise reference, plus throughput
+//  - the signature scanner: the fixture's prologue signatures must resolve
+//    to the .gnu_debugdata addresses, the vector scan must agree with the
+//    scalar one on random patterns, plus scan throughput over .text; a
+//    marker written into this process's own code must be found where it is
+//    mapped and not in the file
+//  - the streaming .gnu_debugdata lookup against the full decode: time,
+//    bytes decoded, decode buffer sizes and arena peak (--only stream runs
+//    just this part and the budget checks)
+//  - the arena budget: both lookups must work within their peak and fail
+//    cleanly below it
+//
+// Exits non-zero if any of the paths disagree, so it can gate CI.
+
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "elf_view.h"
+#include "fixture_sigs.h"
+#include "gnu_debugdata_resolver.h"
+#include "offset_cache.h"
+#include "sf_symbols.h"
+#include "sig_scan.h"
+#include "sym_index.h"
+#include "sym_resolver.h"
+
+extern "C" {
+  #include "xz.h"
+}
+
+// heap allocations made through operator new, for the vector vs index
+// comparison
+static size_t g_allocs;
+
+void* operator new(size_t n) {
+  g_allocs++;
+  if (void* p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static double ms(uint64_t ns) { return (double)ns / 1e6; }
+
+// Peak RSS in kB (VmHWM), 0 if unavailable.
+static long peak_rss_kb() {
+  FILE* f = fopen("/proc/self/status", "r");
+  if (!f) return 0;
+  char line[256];
+  long kb = 0;
+  while (fgets(line, sizeof line, f)) {
+    if (!strncmp(line, "VmHWM:", 6)) {
+      kb = strtol(line + 6, nullptr, 10);
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+// Reset VmHWM to the current RSS (Linux >= 4.0), so each section reports its
+// own peak.
+static void reset_peak_rss() {
+  int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) return;
+  if (write(fd, "5", 1) != 1) {
+    // older kernel: the peaks are cumulative
+  }
+  close(fd);
+}
+
+struct Samples {
+  std::vector<uint64_t> v;
+  void add(uint64_t ns) { v.push_back(ns); }
+  uint64_t min() const { return v.empty() ? 0 : *std::min_element(v.begin(), v.end()); }
+  uint64_t median() {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+  }
+};
+
+static void print_row(const char* name, Samples& s) {
+  printf("  %-12s %10.3f %10.3f\n", name, ms(s.min()), ms(s.median()));
+}
+
+static const char* const TARGETS[] = {
+  SYM_HIDL_IS_SUPPORTED, SYM_AIDL_IS_SUPPORTED, SYM_IMPL,
+};
+static const size_t TARGET_COUNT = sizeof(TARGETS) / sizeof(TARGETS[0]);
+
+static void init_lookups(GnuDebugLookup* l) {
+  for (size_t i = 0; i < TARGET_COUNT; i++) {
+    l[i] = { TARGETS[i], 0, SYM_TIER_NONE };
+  }
+}
+
+static bool same_addrs(const GnuDebugLookup* a, const GnuDebugLookup* b) {
+  for (size_t i = 0; i < TARGET_COUNT; i++) {
+    if (a[i].addr != b[i].addr) return false;
+  }
+  return true;
+}
+
+// 1) full resolution (whole mini ELF decompressed), per phase
+static bool bench_phases(const char* path, int iters, GnuDebugLookup* ref) {
+  Samples map, dec, parse, look, total;
+  long peak = 0;
+  for (int i = 0; i < iters; i++) {
+    GnuDebugLookup l[TARGET_COUNT];
+    init_lookups(l);
+    reset_peak_rss();
+    uint64_t t0 = now_ns();
+    size_t found = resolve_addrs_from_gnu_debugdata(path, l, TARGET_COUNT, 0, GNU_DEBUG_FULL);
+    total.add(now_ns() - t0);
+    peak = std::max(peak, peak_rss_kb());
+
+    const GnuDebugStats& st = gnu_debugdata_last_stats();
+    map.add(st.map_ns);
+    dec.add(st.decompress_ns);
+    parse.add(st.parse_ns);
+    look.add(st.lookup_ns);
+
+    if (i == 0) {
+      if (found != TARGET_COUNT) {
+        fprintf(stderr, "FAIL: resolved %zu of %zu targets\n", found, TARGET_COUNT);
+        return false;
+      }
+      memcpy(ref, l, sizeof l);
+      printf("fixture: %s\n", path);
+      printf("  .gnu_debugdata %zu -> %zu bytes, %zu symbols\n",
+             st.compressed_bytes, st.decompressed_bytes, st.symbols);
+    } else if (!same_addrs(ref, l)) {
+      fprintf(stderr, "FAIL: run %d resolved different addresses\n", i);
+      return false;
+    }
+  }
+
+  printf("\nresolve (%d runs)       min ms  median ms\n", iters);
+  print_row("map", map);
+  print_row("decompress", dec);
+  print_row("parse", parse);
+  print_row("lookup", look);
+  print_row("total", total);
+  printf("  peak RSS     %10ld kB\n", peak);
+  return true;
+}
+
+// 2) the pre-SymIndex layout: one std::string per function symbol, linear find
+struct LegacySym {
+  std::string name;
+  uint64_t    value;
+};
+
+static bool bench_index(const char* path, int iters) {
+  GnuDebugSymtab gs;
+  if (!gs.load(path)) {
+    fprintf(stderr, "FAIL: GnuDebugSymtab::load\n");
+    return false;
+  }
+  const SymtabView& st = gs.symtab;
+
+  Samples vec_build, vec_find, idx_build, idx_find;
+  size_t vec_allocs = 0, idx_allocs = 0;
+  bool ok = true;
+
+  for (int it = 0; it < iters; it++) {
+    size_t a0 = g_allocs;
+    uint64_t t0 = now_ns();
+    std::vector<LegacySym> syms;
+    for (size_t i = 0; i < st.count; i++) {
+      const char* n = st.func_name(i);
+      if (n) syms.push_back({ n, st.sym[i].st_value });
+    }
+    uint64_t t1 = now_ns();
+    vec_allocs = g_allocs - a0;
+    vec_build.add(t1 - t0);
+
+    uint64_t vec_val[TARGET_COUNT] = {};
+    for (size_t k = 0; k < TARGET_COUNT; k++) {
+      for (const auto& s : syms) {
+        if (s.name == TARGETS[k]) { vec_val[k] = s.value; break; }
+      }
+    }
+    vec_find.add(now_ns() - t1);
+
+    // the index allocates from the arena, not through operator new
+    ArenaScope scope("index", resolver_budget());
+    t0 = now_ns();
+    SymIndex idx;
+    idx.build(st);
+    t1 = now_ns();
+    idx_allocs = scope.arena.allocs;
+    idx_build.add(t1 - t0);
+
+    uint64_t idx_val[TARGET_COUNT] = {};
+    for (size_t k = 0; k < TARGET_COUNT; k++) {
+      const Elf64_Sym* s = idx.find(TARGETS[k]);
+      idx_val[k] = s ? s->st_value : 0;
+    }
+    idx_find.add(now_ns() - t1);
+
+    if (memcmp(vec_val, idx_val, sizeof vec_val) != 0) ok = false;
+  }
+
+  printf("\nsymbol table (%d runs)  min ms  median ms\n", iters);
+  print_row("vector build", vec_build);
+  print_row("vector find", vec_find);
+  print_row("index build", idx_build);
+  print_row("index find", idx_find);
+  printf("  allocations  vector %zu, index %zu\n", vec_allocs, idx_allocs);
+
+  if (!ok) fprintf(stderr, "FAIL: vector and index lookups disagree\n");
+  return ok;
+}
+
+// 3) layered resolver: must agree with .gnu_debugdata alone
+static bool bench_tiers(const char* path, int iters, const GnuDebugLookup* ref, long exported) {
+  Samples total;
+  GnuDebugLookup l[TARGET_COUNT];
+  for (int i = 0; i < iters; i++) {
+    init_lookups(l);
+    uint64_t t0 = now_ns();
+    resolve_addrs(path, l, TARGET_COUNT, 0);
+    total.add(now_ns() - t0);
+    if (!same_addrs(ref, l)) {
+      fprintf(stderr, "FAIL: layered resolver disagrees with .gnu_debugdata\n");
+      return false;
+    }
+  }
+
+  printf("\nlayered resolve (%d runs) min ms  median ms\n", iters);
+  print_row("total", total);
+  bool ok = true;
+  for (size_t k = 0; k < TARGET_COUNT; k++) {
+    printf("  %-12s %s\n", sym_tier_name(l[k].tier), TARGETS[k]);
+    const SymTier want = (long)k < exported ? SYM_TIER_DYNSYM : SYM_TIER_DEBUGDATA;
+    if (exported >= 0 && l[k].tier != want) {
+      fprintf(stderr, "FAIL: %s from %s, want %s\n", TARGETS[k], sym_tier_name(l[k].tier),
+              sym_tier_name(want));
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// 4) offset cache: a cold run fills it, a warm run must match
+static bool bench_cache(const char* path, const char* cache_path, const GnuDebugLookup* ref) {
+  unlink(cache_path);
+
+  GnuDebugLookup cold[TARGET_COUNT], warm[TARGET_COUNT];
+  init_lookups(cold);
+  init_lookups(warm);
+
+  uint64_t t0 = now_ns();
+  resolve_addrs_cached(path, cache_path, nullptr, cold, TARGET_COUNT, 0);
+  uint64_t t1 = now_ns();
+  resolve_addrs_cached(path, cache_path, nullptr, warm, TARGET_COUNT, 0);
+  uint64_t t2 = now_ns();
+  unlink(cache_path);
+
+  printf("\noffset cache\n");
+  printf("  cold %10.3f ms\n", ms(t1 - t0));
+  printf("  warm %10.3f ms\n", ms(t2 - t1));
+
+  if (!same_addrs(ref, cold) || !same_addrs(ref, warm)) {
+    fprintf(stderr, "FAIL: cached addresses differ from the resolver\n");
+    return false;
+  }
+  return true;
+}
+
+// 5) CRCs: bit-exact against the bytewise definition, then throughput
+static uint32_t ref_crc32(const uint8_t* p, size_t n, uint32_t crc) {
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint64_t ref_crc64(const uint8_t* p, size_t n, uint64_t crc) {
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xC96C5795D7870F42ull & (0ull - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static bool bench_crc() {
+  xz_crc32_init();
+  xz_crc64_init();
+
+  const size_t n = 16 << 20;
+  std::vector<uint8_t> buf(n);
+  uint64_t x = 0x9E3779B97F4A7C15ull;
+  for (auto& b : buf) {
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    b = (uint8_t)((x * 0x2545F4914F6CDD1Dull) >> 56);
+  }
+
+  for (size_t off = 0; off < 8; off++) {
+    for (size_t len = 0; len <= 1200; len++) {
+      const uint8_t* p = buf.data() + off;
+      if (xz_crc32(p, len, 0) != ref_crc32(p, len, 0) ||
+          xz_crc64(p, len, 0) != ref_crc64(p, len, 0)) {
+        fprintf(stderr, "FAIL: CRC mismatch at offset %zu length %zu\n", off, len);
+        return false;
+      }
+    }
+  }
+
+  uint64_t t0 = now_ns();
+  uint32_t c32 = xz_crc32(buf.data(), n, 0);
+  uint64_t t1 = now_ns();
+  uint64_t c64 = xz_crc64(buf.data(), n, 0);
+  uint64_t t2 = now_ns();
+
+  if (c32 != ref_crc32(buf.data(), n, 0) || c64 != ref_crc64(buf.data(), n, 0)) {
+    fprintf(stderr, "FAIL: CRC mismatch over %zu bytes\n", n);
+    return false;
+  }
+
+  double mb = (double)n / (1 << 20);
+  printf("\ncrc (%zu MiB, bit-exact)\n", n >> 20);
+  printf("  crc32 %10.1f MiB/s\n", mb / ((double)(t1 - t0) / 1e9));
+  printf("  crc64 %10.1f MiB/s\n", mb / ((double)(t2 - t1) / 1e9));
+  return true;
+}
+
+// 6) signature scanner
+static bool bench_signatures(const char* path, int iters, const GnuDebugLookup* ref) {
+  char patterns[TARGET_COUNT][256];
+  SigEntry table[TARGET_COUNT + 1];
+  for (size_t i = 0; i < TARGET_COUNT; i++) {
+    fixture_signature(i, patterns[i], sizeof patterns[i]);
+    table[i] = { nullptr, TARGETS[i], patterns[i], 0 };
+  }
+  table[TARGET_COUNT] = { nullptr, nullptr, nullptr, 0 };
+
+  GnuDebugLookup l[TARGET_COUNT];
+  init_lookups(l);
+  uint64_t t0 = now_ns();
+  size_t found = resolve_addrs_by_signature(path, table, l, TARGET_COUNT, 0);
+  uint64_t resolve_ns = now_ns() - t0;
+  if (found != TARGET_COUNT || !same_addrs(ref, l)) {
+    fprintf(stderr, "FAIL: signatures found %zu/%zu, or disagree with .gnu_debugdata\n",
+            found, TARGET_COUNT);
+    return false;
+  }
+
+  ElfView elf;
+  const Elf64_Shdr* text = elf.map_file(path) ? elf.find_section(".text") : nullptr;
+  const uint8_t* code = text ? elf.section_data(text) : nullptr;
+  if (!code) {
+    fprintf(stderr, "FAIL: no .text in %s\n", path);
+    return false;
+  }
+  const size_t size = text->sh_size;
+
+  // vector vs scalar on random patterns cut from the code itself, with
+  // wildcards, at both alignments
+  uint64_t x = 0x2545F4914F6CDD1Dull;
+  auto rnd = [&x]() { x ^= x >> 12; x ^= x << 25; x ^= x >> 27; return x * 0x9E3779B97F4A7C15ull; };
+  for (int k = 0; k < 200; k++) {
+    const size_t len = 1 + rnd() % 24;
+    const size_t at = rnd() % (size - len);
+    char pat[3 * SIG_MAX_LEN + 1];
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+      const uint64_t r = rnd();
+      const char* hex = "0123456789abcdef";
+      pat[n++] = (r & 7) == 0 ? '?' : hex[code[at + i] >> 4];
+      pat[n++] = (r & 56) == 0 ? '?' : hex[code[at + i] & 15];
+      pat[n++] = ' ';
+    }
+    pat[n] = 0;
+    SigPattern p;
+    if (!sig_parse(pat, &p)) {
+      continue; // all wildcards
+    }
+    for (size_t align : { (size_t)1, (size_t)4 }) {
+      size_t va[64], sa[64];
+      size_t vn = sig_scan(code, size, p, align, va, 64);
+      size_t sn = sig_scan_scalar(code, size, p, align, sa, 64);
+      if (vn != sn || memcmp(va, sa, std::min(vn, (size_t)64) * sizeof(size_t)) != 0 ||
+          (align == 1 && vn == 0)) {
+        fprintf(stderr, "FAIL: %s scan disagrees with scalar for \"%s\" (align %zu): %zu vs %zu\n",
+                sig_scan_impl(), pat, align, vn, sn);
+        return false;
+      }
+    }
+  }
+
+  Samples vec, scalar;
+  for (size_t t = 0; t < TARGET_COUNT; t++) {
+    SigPattern p;
+    sig_parse(patterns[t], &p);
+    for (int i = 0; i < iters; i++) {
+      size_t pos_v = 0, pos_s = 0;
+      uint64_t a = now_ns();
+      size_t nv = sig_scan(code, size, p, 4, &pos_v, 1);
+      uint64_t b = now_ns();
+      size_t ns = sig_scan_scalar(code, size, p, 4, &pos_s, 1);
+      uint64_t c = now_ns();
+      vec.add(b - a);
+      scalar.add(c - b);
+      if (nv != 1 || ns != 1 || pos_v != pos_s || text->sh_addr + pos_v != ref[t].addr) {
+        fprintf(stderr, "FAIL: signature %zu: %zu / %zu matches\n", t, nv, ns);
+        return false;
+      }
+    }
+  }
+
+  const double mb = (double)size / (1 << 20);
+  printf("\nsignatures (%.1f MiB .text, %zu patterns x %d runs) min ms  median ms  MiB/s\n",
+         mb, TARGET_COUNT, iters);
+  const uint64_t vmed = vec.median(), smed = scalar.median();
+  printf("  %-12s %10.3f %10.3f %8.0f\n", sig_scan_impl(), ms(vec.min()), ms(vmed),
+         mb / ((double)vmed / 1e9));
+  printf("  %-12s %10.3f %10.3f %8.0f\n", "scalar", ms(scalar.min()), ms(smed),
+         mb / ((double)smed / 1e9));
+  printf("  resolve      %10.3f ms for %zu names (parse + scan + build ID)\n", ms(resolve_ns),
+         TARGET_COUNT);
+  return true;
+}
+
+// Never called: sig_mapped() overwrites its first bytes with a marker.
+__attribute__((noinline)) static void sig_probe() {
+  asm volatile(".rept 64\n nop\n .endr");
+}
+
+static int main_base_cb(struct dl_phdr_info* info, size_t, void* data) {
+  *(uintptr_t*)data = info->dlpi_addr; // the first module is the executable
+  return 1;
+}
+
+// 6b) in-process scan: the resolver runs inside surfaceflinger, where the
+// code to search is the mapped executable segments. Writes a marker over
+// sig_probe() in memory only, so the scan must find it there at the
+// function's address, and must not find it in the file.
+static bool sig_mapped() {
+  uintptr_t base = 0;
+  dl_iterate_phdr(main_base_cb, &base);
+  if (!base) {
+    printf("\nsignatures in mapped code: skipped (executable is not PIE)\n");
+    return true;
+  }
+  uint8_t* probe = (uint8_t*)(uintptr_t)&sig_probe;
+  const long pg = sysconf(_SC_PAGESIZE);
+  uint8_t* page = (uint8_t*)((uintptr_t)probe & ~(uintptr_t)(pg - 1));
+  const size_t span = (size_t)(probe + 16 - page + pg - 1) & ~(size_t)(pg - 1);
+  if (mprotect(page, span, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+    printf("\nsignatures in mapped code: skipped (cannot write to code)\n");
+    return true;
+  }
+  // built at run time so the bytes appear nowhere else in the binary
+  uint8_t saved[16];
+  char pattern[3 * 16 + 1];
+  memcpy(saved, probe, sizeof saved);
+  uint64_t x = 0x9E3779B97F4A7C15ull ^ (uint64_t)now_ns();
+  for (int i = 0; i < 16; i++) {
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    probe[i] = (uint8_t)((x * 0x2545F4914F6CDD1Dull) >> 56);
+    snprintf(pattern + 3 * i, 4, "%02x ", probe[i]);
+  }
+  const SigEntry table[] = { { nullptr, "probe", pattern, 0 }, { nullptr, nullptr, nullptr, 0 } };
+  GnuDebugLookup mem{ "probe", 0, SYM_TIER_NONE }, file{ "probe", 0, SYM_TIER_NONE };
+  const size_t in_mem = resolve_addrs_by_signature("/proc/self/exe", table, &mem, 1, base);
+  const size_t in_file = resolve_addrs_by_signature("/proc/self/exe", table, &file, 1, 0);
+  memcpy(probe, saved, sizeof saved);
+  mprotect(page, span, PROT_READ | PROT_EXEC);
+
+  if (in_mem != 1 || mem.addr != (uintptr_t)probe || mem.tier != SYM_TIER_SIGNATURE || in_file != 0) {
+    fprintf(stderr, "FAIL: mapped-code signature resolved %zu (0x%lx, want 0x%lx), file %zu\n",
+            in_mem, (unsigned long)mem.addr, (unsigned long)(uintptr_t)probe, in_file);
+    return false;
+  }
+  printf("\nsignatures in mapped code: marker found at sig_probe, not in the file\n");
+  return true;
+}
+
+// 7) streaming lookup against the full decode: time, bytes decoded, the
+// decode buffers each holds and the arena peak (everything allocated). (RSS
+// is no use here: malloc keeps the full decode's buffer around between runs.)
+// peaks[] gets the arena peak of each mode, 0 if streaming is not possible.
+static bool bench_stream(const char* path, int iters, size_t peaks[2]) {
+  static const struct {
+    GnuDebugMode mode;
+    const char*  name;
+  } MODES[] = { { GNU_DEBUG_FULL, "full" }, { GNU_DEBUG_STREAM, "stream" } };
+
+  GnuDebugLookup ref[TARGET_COUNT] = {};
+  printf("\nstreaming .gnu_debugdata (%d runs)\n", iters);
+  printf("  %-8s %10s %10s %12s %12s %12s\n", "", "min ms", "median ms", "decoded kB",
+         "buffers kB", "arena kB");
+  for (size_t m = 0; m < sizeof(MODES) / sizeof(MODES[0]); m++) {
+    Samples total;
+    GnuDebugStats st{};
+    peaks[m] = 0;
+    for (int i = 0; i < iters; i++) {
+      GnuDebugLookup l[TARGET_COUNT];
+      init_lookups(l);
+      size_t found;
+      uint64_t t0 = now_ns();
+      {
+        ArenaScope scope("bench", resolver_budget());
+        found = resolve_addrs_from_gnu_debugdata(path, l, TARGET_COUNT, 0, MODES[m].mode);
+        peaks[m] = scope.arena.peak;
+      }
+      total.add(now_ns() - t0);
+      st = gnu_debugdata_last_stats();
+
+      if (MODES[m].mode == GNU_DEBUG_STREAM && !st.streamed) {
+        break;
+      }
+      if (found != TARGET_COUNT) {
+        fprintf(stderr, "FAIL: %s resolved %zu of %zu targets\n", MODES[m].name, found,
+                TARGET_COUNT);
+        return false;
+      }
+      if (m == 0 && i == 0) {
+        memcpy(ref, l, sizeof l);
+      } else if (!same_addrs(ref, l)) {
+        fprintf(stderr, "FAIL: %s resolved different addresses\n", MODES[m].name);
+        return false;
+      }
+    }
+    if (MODES[m].mode == GNU_DEBUG_STREAM && !st.streamed) {
+      printf("  %-8s not possible: no xz index, or blocks over 1 MiB\n", MODES[m].name);
+      peaks[m] = 0;
+      continue;
+    }
+    printf("  %-8s %10.3f %10.3f %12zu %12zu %12zu\n", MODES[m].name, ms(total.min()),
+           ms(total.median()), st.decoded_bytes / 1024, st.buffer_bytes / 1024,
+           peaks[m] / 1024);
+  }
+  return true;
+}
+
+// 8) arena budget: with exactly its peak a lookup still works, with half of
+// it the lookup must fail cleanly (nothing resolved, budget overrun
+// reported). Then the layered resolver with a budget too small for any
+// decode.
+static bool bench_budget(const char* path, const size_t peaks[2]) {
+  static const struct {
+    GnuDebugMode mode;
+    const char*  name;
+  } MODES[] = { { GNU_DEBUG_FULL, "full" }, { GNU_DEBUG_STREAM, "stream" } };
+
+  printf("\narena budget\n");
+  for (size_t m = 0; m < sizeof(MODES) / sizeof(MODES[0]); m++) {
+    if (!peaks[m]) {
+      continue;
+    }
+    const size_t budgets[2] = { peaks[m], peaks[m] / 2 };
+    for (size_t b = 0; b < 2; b++) {
+      GnuDebugLookup l[TARGET_COUNT];
+      init_lookups(l);
+      size_t found, refused;
+      {
+        ArenaScope scope("bench", budgets[b]);
+        found = resolve_addrs_from_gnu_debugdata(path, l, TARGET_COUNT, 0, MODES[m].mode);
+        refused = scope.arena.refused;
+      }
+      const bool want_ok = b == 0;
+      printf("  %-8s %8zu kB budget: %zu of %zu resolved, %zu allocations refused\n",
+             MODES[m].name, budgets[b] / 1024, found, TARGET_COUNT, refused);
+      if (want_ok ? (found != TARGET_COUNT || refused) : (found || !refused)) {
+        fprintf(stderr, "FAIL: %s with a %zu byte budget\n", MODES[m].name, budgets[b]);
+        return false;
+      }
+    }
+  }
+
+  const size_t saved = resolver_budget();
+  resolver_set_budget(16 * 1024);
+  GnuDebugLookup l[TARGET_COUNT];
+  init_lookups(l);
+  size_t found = resolve_addrs(path, l, TARGET_COUNT, 0);
+  resolver_set_budget(saved);
+  printf("  %-8s %8d kB budget: %zu of %zu resolved\n", "layered", 16, found, TARGET_COUNT);
+  if (found) {
+    fprintf(stderr, "FAIL: layered resolve decoded .gnu_debugdata in 16 kB\n");
+    return false;
+  }
+  return true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "Usage: %s <fixture.elf> [--iters N] [--cache PATH] [--only stream|tiers]\n"
+          "          [--exported N]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  const char* cache_path = nullptr;
+  int iters = 20;
+  bool only_stream = false, only_tiers = false;
+  long exported = -1; // not checked
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (a[0] != '-') { path = a; continue; }
+    if (!v) { usage(argv[0]); return 1; }
+    if (!strcmp(a, "--iters")) iters = atoi(v);
+    else if (!strcmp(a, "--cache")) cache_path = v;
+    else if (!strcmp(a, "--only") && !strcmp(v, "stream")) only_stream = true;
+    else if (!strcmp(a, "--only") && !strcmp(v, "tiers")) only_tiers = true;
+    else if (!strcmp(a, "--exported")) exported = atol(v);
+    else { usage(argv[0]); return 1; }
+    i++;
+  }
+  if (!path || iters < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string default_cache;
+  if (!cache_path) {
+    default_cache = std::string(path) + ".cache";
+    cache_path = default_cache.c_str();
+  }
+
+  size_t peaks[2];
+  if (only_stream) {
+    printf("fixture: %s\n", path);
+    return bench_stream(path, iters, peaks) && bench_budget(path, peaks) ? 0 : 1;
+  }
+
+  GnuDebugLookup ref[TARGET_COUNT] = {};
+  if (only_tiers) {
+    return bench_phases(path, iters, ref) && bench_tiers(path, iters, ref, exported) ? 0 : 1;
+  }
+  bool ok = bench_phases(path, iters, ref);
+  ok = ok && bench_index(path, iters);
+  ok = ok && bench_tiers(path, iters, ref, exported);
+  ok = ok && bench_cache(path, cache_path, ref);
+  ok = ok && bench_crc();
+  ok = ok && bench_signatures(path, iters, ref) && sig_mapped();
+  ok = ok && bench_stream(path, iters, peaks);
+  ok = ok && bench_budget(path, peaks);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+// Offline offset extraction for a collection of surfaceflinger builds.
+//
+// Usage:
+//   sf_offsets [--jobs N] [--names FILE] [--sym NAME]... [--out PATH]
+//              [--match GLOB] [--mem-budget-kb N] [--verbose] <dir|binary>...
+//
+// Every ELF file given directly, and every one under the given directories
+// (recursively) whose file name matches GLOB (default "surfaceflinger"), is
+// resolved with the same layered resolver the library uses
+// (.dynsym, .symtab, .gnu_debugdata, signatures), on a pool of N threads
+// (default: one per CPU). The offsets go into an offset manifest
+// (offset_manifest.h) with one row per GNU build ID, written to PATH
+// (default stdout). Shipped as /data/local/tmp/sfrotate.offsets it answers
+// the hook lookups of every listed build without touching its symbols.
+//
+// The names are the hook targets from sf_symbols.h, or those of --names
+// (one mangled name per line, '#' comments) and --sym. Only local files are
+// read: no device, no network. Other files under the directories, ELF or
+// not (libraries, other executables of a firmware tree), are skipped
+// quietly.
+//
+// A summary with the throughput (binaries/s, MB/s) goes to stderr; with
+// --verbose also one line per binary with the tier of each name. A manifest
+// written to a file is read back for every build and must give the same
+// offsets.
+// Exit status: 0 ok; 1 usage, a manifest that cannot be written or has two
+// different rows for one build ID, or a written manifest that does not read
+// back the same offsets; 2 if any surfaceflinger input had no build ID or
+// none of the names (the manifest is still written without them).
+
+#include <fnmatch.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elf_view.h"
+#include "gnu_debugdata_resolver.h"
+#include "offset_manifest.h"
+#include "sf_symbols.h"
+#include "sym_resolver.h"
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+enum Status {
+  ST_OTHER,     // not an ELF, or not a match: skipped quietly, firmware
+                // trees hold all sorts of files
+  ST_OK,
+  ST_NO_BUILD_ID,
+  ST_NO_NAMES,
+};
+
+struct Input {
+  std::string path;
+  std::string label; // path relative to the argument it was found under
+  bool        direct; // given on the command line, not found by the walk
+};
+
+struct Result {
+  Status                status = ST_OTHER;
+  uint8_t               build_id[32];
+  uint32_t              build_id_len = 0;
+  std::vector<uint64_t> offsets; // MANIFEST_ABSENT if not found
+  std::vector<SymTier>  tiers;
+  uint64_t              size = 0;
+  uint64_t              ns = 0;
+};
+
+static bool is_elf(const char* path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  unsigned char m[4];
+  const bool ok = read(fd, m, sizeof m) == (ssize_t)sizeof m && memcmp(m, ELFMAG, SELFMAG) == 0;
+  close(fd);
+  return ok;
+}
+
+static bool matches(const Input& in, const char* glob) {
+  if (in.direct) return true;
+  const size_t slash = in.path.rfind('/');
+  const char* base = in.path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  return fnmatch(glob, base, 0) == 0;
+}
+
+static void extract(const Input& in, const char* match, const std::vector<const char*>& names,
+                    Result& r) {
+  const uint64_t t0 = now_ns();
+  if (!matches(in, match) || !is_elf(in.path.c_str())) return;
+  struct stat st{};
+  if (stat(in.path.c_str(), &st) == 0) r.size = (uint64_t)st.st_size;
+
+  {
+    ElfView elf;
+    const uint8_t* id = nullptr;
+    size_t id_len = 0;
+    if (!elf.map_file(in.path.c_str()) || !elf.build_id(&id, &id_len) || id_len == 0 ||
+        id_len > sizeof r.build_id) {
+      r.status = ST_NO_BUILD_ID;
+      r.ns = now_ns() - t0;
+      return;
+    }
+    memcpy(r.build_id, id, id_len);
+    r.build_id_len = (uint32_t)id_len;
+  }
+
+  // base 0: addr is the offset from the load base, as in the cache
+  std::vector<GnuDebugLookup> lookups(names.size());
+  for (size_t j = 0; j < names.size(); j++) {
+    lookups[j] = { names[j], 0, SYM_TIER_NONE };
+  }
+  const size_t found = resolve_addrs(in.path.c_str(), lookups.data(), lookups.size(), 0);
+  r.offsets.resize(names.size());
+  r.tiers.resize(names.size());
+  for (size_t j = 0; j < names.size(); j++) {
+    r.offsets[j] = lookups[j].addr ? (uint64_t)lookups[j].addr : MANIFEST_ABSENT;
+    r.tiers[j] = lookups[j].tier;
+  }
+  r.status = found ? ST_OK : ST_NO_NAMES;
+  r.ns = now_ns() - t0;
+}
+
+// directory walk (nftw() has no user pointer)
+static std::vector<Input>* g_walk_out;
+static size_t g_walk_root_len;
+
+static int walk_cb(const char* path, const struct stat* st, int type, struct FTW*) {
+  if (type == FTW_F && S_ISREG(st->st_mode)) {
+    const char* rel = path + g_walk_root_len;
+    while (*rel == '/') rel++;
+    g_walk_out->push_back({ path, rel, false });
+  }
+  return 0;
+}
+
+static bool collect(const char* arg, std::vector<Input>& out) {
+  struct stat st{};
+  if (stat(arg, &st) != 0) {
+    fprintf(stderr, "cannot stat %s\n", arg);
+    return false;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    out.push_back({ arg, arg, true });
+    return true;
+  }
+  std::vector<Input> found;
+  g_walk_out = &found;
+  g_walk_root_len = strlen(arg);
+  if (nftw(arg, walk_cb, 32, FTW_PHYS) != 0) {
+    fprintf(stderr, "cannot walk %s\n", arg);
+    return false;
+  }
+  // the walk order depends on the file system; the manifest should not
+  std::sort(found.begin(), found.end(),
+            [](const Input& a, const Input& b) { return a.path < b.path; });
+  out.insert(out.end(), found.begin(), found.end());
+  return true;
+}
+
+static bool load_names(const char* path, std::vector<std::string>& out) {
+  FILE* f = fopen(path, "re");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  char line[4096];
+  while (fgets(line, sizeof line, f)) {
+    size_t n = strcspn(line, "\r\n");
+    line[n] = 0;
+    const char* s = line + strspn(line, " \t");
+    if (*s && *s != '#') out.push_back(s);
+  }
+  fclose(f);
+  return true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "Usage: %s [--jobs N] [--names FILE] [--sym NAME]... [--out PATH]\n"
+          "          [--match GLOB] [--mem-budget-kb N] [--verbose] <dir|binary>...\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  const char* out_path = "-";
+  const char* match = "surfaceflinger";
+  bool verbose = false;
+  std::vector<std::string> name_store;
+  std::vector<Input> inputs;
+  std::vector<const char*> roots;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (!strcmp(a, "--verbose")) {
+      verbose = true;
+    } else if (!strcmp(a, "--jobs") && has_value) {
+      jobs = (unsigned)atoi(argv[++i]);
+    } else if (!strcmp(a, "--names") && has_value) {
+      if (!load_names(argv[++i], name_store)) return 1;
+    } else if (!strcmp(a, "--sym") && has_value) {
+      name_store.push_back(argv[++i]);
+    } else if (!strcmp(a, "--out") && has_value) {
+      out_path = argv[++i];
+    } else if (!strcmp(a, "--match") && has_value) {
+      match = argv[++i];
+    } else if (!strcmp(a, "--mem-budget-kb") && has_value) {
+      resolver_set_budget((size_t)strtoul(argv[++i], nullptr, 10) * 1024);
+    } else if (a[0] == '-' && a[1]) {
+      usage(argv[0]);
+      return 1;
+    } else {
+      roots.push_back(a);
+    }
+  }
+  if (roots.empty() || jobs == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<const char*> names;
+  if (name_store.empty()) {
+    names = { SYM_HIDL_IS_SUPPORTED, SYM_AIDL_IS_SUPPORTED, SYM_IMPL };
+  } else {
+    for (const std::string& n : name_store) names.push_back(n.c_str());
+  }
+  for (const char* r : roots) {
+    if (!collect(r, inputs)) return 1;
+  }
+
+  // the pool: every worker takes the next unclaimed input until none is left
+  std::vector<Result> results(inputs.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < inputs.size();) {
+      extract(inputs[i], match, names, results[i]);
+    }
+  };
+  const unsigned nthreads = (unsigned)std::min<size_t>(jobs, std::max<size_t>(inputs.size(), 1));
+  const uint64_t t0 = now_ns();
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < nthreads; t++) pool.emplace_back(worker);
+  worker();
+  for (std::thread& t : pool) t.join();
+  const uint64_t wall_ns = now_ns() - t0;
+
+  // manifest rows, in input order (manifest_write sorts by build ID)
+  std::vector<ManifestBuild> builds;
+  size_t nelf = 0, failed = 0;
+  uint64_t bytes = 0, busy_ns = 0, slowest_ns = 0;
+  const Input* slowest = nullptr;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const Result& r = results[i];
+    if (r.status == ST_OTHER) continue;
+    nelf++;
+    bytes += r.size;
+    busy_ns += r.ns;
+    if (r.ns > slowest_ns) {
+      slowest_ns = r.ns;
+      slowest = &inputs[i];
+    }
+    if (r.status == ST_NO_BUILD_ID) {
+      fprintf(stderr, "%s: no build ID, skipped\n", inputs[i].label.c_str());
+      failed++;
+      continue;
+    }
+    if (r.status == ST_NO_NAMES) {
+      fprintf(stderr, "%s: none of the names found, skipped\n", inputs[i].label.c_str());
+      failed++;
+      continue;
+    }
+    ManifestBuild b{};
+    memcpy(b.build_id, r.build_id, r.build_id_len);
+    b.build_id_len = r.build_id_len;
+    b.offsets = r.offsets.data();
+    b.comment = inputs[i].label.c_str();
+    builds.push_back(b);
+
+    if (verbose) {
+      fprintf(stderr, "%s  %.1f ms", inputs[i].label.c_str(), (double)r.ns / 1e6);
+      for (size_t j = 0; j < names.size(); j++) fprintf(stderr, " %s", sym_tier_name(r.tiers[j]));
+      fputc('\n', stderr);
+    }
+  }
+
+  if (!manifest_write(out_path, names.data(), names.size(), builds.data(), builds.size())) {
+    return 1;
+  }
+
+  // read the written manifest back the way the library does
+  bool readback = true;
+  if (strcmp(out_path, "-") != 0) {
+    std::vector<GnuDebugLookup> l(names.size());
+    for (const ManifestBuild& b : builds) {
+      for (size_t j = 0; j < names.size(); j++) l[j] = { names[j], 0, SYM_TIER_NONE };
+      bool same = manifest_read(out_path, b.build_id, b.build_id_len, l.data(), l.size(), 0);
+      for (size_t j = 0; same && j < names.size(); j++) {
+        same = (l[j].addr ? (uint64_t)l[j].addr : MANIFEST_ABSENT) == b.offsets[j];
+      }
+      if (!same) {
+        fprintf(stderr, "FAIL: %s reads back wrong from %s\n", b.comment, out_path);
+        readback = false;
+      }
+    }
+  }
+
+  const double secs = (double)wall_ns / 1e9;
+  fprintf(stderr,
+          "%zu binaries (%zu other files, %zu skipped), %zu names, %u jobs: %.3f s, "
+          "%.1f binaries/s, %.1f MB/s\n",
+          nelf, inputs.size() - nelf, failed, names.size(), nthreads, secs,
+          secs > 0 ? (double)nelf / secs : 0.0, secs > 0 ? (double)bytes / 1e6 / secs : 0.0);
+  if (nelf) {
+    fprintf(stderr, "  %.1f ms per binary, %.1fx parallel; slowest %s (%.1f ms)\n",
+            (double)busy_ns / 1e6 / (double)nelf, (double)busy_ns / (double)wall_ns,
+            slowest->label.c_str(), (double)slowest_ns / 1e6);
+  }
+  if (!readback) return 1;
+  return failed ? 2 : 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the NDK logging header: the host builds (benchmarks,
+// tools) use the same log.h macros, printed to stderr instead of logcat.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+  ANDROID_LOG_VERBOSE = 2,
+  ANDROID_LOG_DEBUG,
+  ANDROID_LOG_INFO,
+  ANDROID_LOG_WARN,
+  ANDROID_LOG_ERROR,
+};
+
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+  // info is too chatty for benchmark output; set SFROTATE_HOST_LOG to see it
+  static const int min_prio = getenv("SFROTATE_HOST_LOG") ? ANDROID_LOG_VERBOSE : ANDROID_LOG_ERROR;
+  if (prio < min_prio) {
+    return 0;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "%s: ", tag);
+  int n = vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+  return n;
+}
@@ -0,0 +1,172 @@
+// dlopen64's stop window accounting (src/stop_window.cpp), fed made-up
+// timings instead of a ptrace session:
+//   - the phases sum to the window, also past MAX_PHASES, where the rest is
+//     added up in one "(later phases)" entry;
+//   - the printed report adds up to the printed window as e2e_harness checks
+//     it (same 0.5 us per line of rounding slack);
+//   - --budget-ms: exit status 13 only when the window is strictly over a
+//     nonzero budget and nothing failed before.
+//
+// Usage:
+//   stop_window_check
+//
+// Exits non-zero on the first failed check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <initializer_list>
+
+#include "stop_window.h"
+
+static int g_failed = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+      fprintf(stderr, "FAIL: " __VA_ARGS__); \
+      fputc('\n', stderr); \
+      g_failed++; \
+    } \
+  } while (0)
+
+static uint64_t phase_sum(const StopWindow& w) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < w.nphases; i++) sum += w.phases[i].ns;
+  return sum;
+}
+
+// n phases of uneven lengths after a start at t0; returns the last mark
+static uint64_t run_phases(StopWindow& w, uint64_t t0, size_t n) {
+  uint64_t t = t0;
+  w.start(t);
+  for (size_t i = 0; i < n; i++) {
+    t += 1000 + (i * 7919) % 250000;
+    w.phase(t, "phase %zu", i);
+  }
+  return t;
+}
+
+// fn() with stderr (where the host log shim prints) going to out
+template <typename Fn>
+static void with_stderr(FILE* out, Fn fn) {
+  fflush(stderr);
+  const int saved = dup(STDERR_FILENO);
+  dup2(fileno(out), STDERR_FILENO);
+  fn();
+  fflush(stderr);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+}
+
+// The report as dlopen64 prints it, read back the way e2e_harness reads it:
+// the phase lines must add up to the window line within the rounding of the
+// printed values.
+static bool report_adds_up(const StopWindow& w, size_t* nlines) {
+  FILE* tmp = tmpfile();
+  if (!tmp) return false;
+  with_stderr(tmp, [&] { w.report(); });
+
+  static const char WINDOW[] = "stop window (interrupt to detach)";
+  char line[512];
+  double sum = 0;
+  *nlines = 0;
+  bool ok = false;
+  rewind(tmp);
+  while (fgets(line, sizeof line, tmp)) {
+    char* unit = strstr(line, " ms\n");
+    if (!unit) continue;
+    *unit = 0;
+    const double v = atof(strrchr(line, ' ') + 1);
+    if (strstr(line, WINDOW)) {
+      const double slack = 0.0005 * (double)(*nlines + 1) + 1e-9;
+      ok = *nlines > 0 && sum - v <= slack && v - sum <= slack;
+      break;
+    }
+    sum += v;
+    (*nlines)++;
+  }
+  fclose(tmp);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    fprintf(stderr, "usage: %s\n", argv[0]);
+    return 1;
+  }
+  // report() logs at info level, which the host log shim drops by default
+  setenv("SFROTATE_HOST_LOG", "1", 1);
+
+  static StopWindow w; // ~6 KiB of names
+  const uint64_t t0 = 5000000000ull;
+
+  // what dlopen64 does for two libraries: interrupt, mmap, dlopen / dlsym /
+  // call each, munmap, detach
+  for (size_t n : { (size_t)1, (size_t)9, StopWindow::MAX_PHASES - 1, StopWindow::MAX_PHASES }) {
+    const uint64_t end = run_phases(w, t0, n);
+    CHECK(w.nphases == n, "%zu phases: %zu recorded", n, w.nphases);
+    CHECK(w.stopped_ns() == end - t0, "%zu phases: window %llu ns, want %llu", n,
+          (unsigned long long)w.stopped_ns(), (unsigned long long)(end - t0));
+    CHECK(phase_sum(w) == w.stopped_ns(), "%zu phases sum to %llu ns, window %llu ns", n,
+          (unsigned long long)phase_sum(w), (unsigned long long)w.stopped_ns());
+    char want[32];
+    snprintf(want, sizeof want, "phase %zu", n - 1);
+    CHECK(!strcmp(w.phases[n - 1].name, want), "%zu phases: last one is \"%s\"", n,
+          w.phases[n - 1].name);
+    size_t lines;
+    CHECK(report_adds_up(w, &lines) && lines == n, "%zu phases: printed report does not add up", n);
+  }
+
+  // past MAX_PHASES (many libraries): nothing is dropped, the tail is one
+  // entry
+  for (size_t n : { StopWindow::MAX_PHASES + 1, (size_t)1000 }) {
+    const uint64_t end = run_phases(w, t0, n);
+    CHECK(w.nphases == StopWindow::MAX_PHASES, "%zu phases: %zu recorded", n, w.nphases);
+    CHECK(w.stopped_ns() == end - t0, "%zu phases: window %llu ns, want %llu", n,
+          (unsigned long long)w.stopped_ns(), (unsigned long long)(end - t0));
+    CHECK(phase_sum(w) == w.stopped_ns(), "%zu phases sum to %llu ns, window %llu ns", n,
+          (unsigned long long)phase_sum(w), (unsigned long long)w.stopped_ns());
+    CHECK(!strcmp(w.phases[StopWindow::MAX_PHASES - 1].name, "(later phases)"),
+          "%zu phases: last one is \"%s\"", n, w.phases[StopWindow::MAX_PHASES - 1].name);
+    CHECK(!strcmp(w.phases[StopWindow::MAX_PHASES - 2].name, "phase 62"),
+          "%zu phases: second to last is \"%s\"", n, w.phases[StopWindow::MAX_PHASES - 2].name);
+    size_t lines;
+    CHECK(report_adds_up(w, &lines) && lines == StopWindow::MAX_PHASES,
+          "%zu phases: printed report does not add up", n);
+  }
+
+  // start() clears an earlier session
+  run_phases(w, t0, 3);
+  w.start(t0 + 1);
+  CHECK(w.nphases == 0 && w.stopped_ns() == 0, "start() keeps %zu phases", w.nphases);
+
+  // --budget-ms: a 12.5 ms window
+  w.start(t0);
+  w.phase(t0 + 12000000, "interrupt");
+  w.phase(t0 + 12500000, "detach");
+  struct { int rc; double budget_ms; int want; } budgets[] = {
+    { 0,  0,      0 },  // no budget
+    { 0,  -1,     0 },
+    { 0,  20,     0 },
+    { 0,  12.5,   0 },  // exactly on budget is not over
+    { 0,  12.499, STOP_OVER_BUDGET },
+    { 0,  1,      STOP_OVER_BUDGET },
+    { 12, 1,      12 }, // an earlier failure wins
+    { 12, 20,     12 },
+  };
+  FILE* devnull = fopen("/dev/null", "w"); // the over-budget LOGE
+  for (const auto& b : budgets) {
+    int got = -1;
+    with_stderr(devnull ? devnull : stderr, [&] { got = w.budget_status(b.rc, b.budget_ms); });
+    CHECK(got == b.want, "rc %d, budget %.3f ms, window 12.5 ms: %d, want %d", b.rc,
+          b.budget_ms, got, b.want);
+  }
+  if (devnull) fclose(devnull);
+
+  if (g_failed) return 1;
+  printf("stop window accounting: ok (up to 1000 phases, %zu kept; budget boundaries)\n",
+         StopWindow::MAX_PHASES);
+  return 0;
+}
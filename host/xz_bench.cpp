@@ -0,0 +1,412 @@
+// Decode speed and output equality of the XZ_DEC_FAST LZMA2 decode loop
+// (xz_fast.c, what SFROTATE_XZ_FAST=ON builds into xzdec) against the
+// upstream XZ Embedded loop (xz_ref.c).
+//
+// Usage:
+//   xz_bench [--iters N] [file ...]
+//
+// The corpus is a set of streams generated with liblzma: data shaped like
+// .strtab, arm64 code, text, short-period runs, zeros and random bytes,
+// with several lc/lp/pb settings, dictionary sizes and 64 KiB blocks. Each
+// file given is added to it: its .gnu_debugdata if it is an ELF with one,
+// otherwise the file itself as an .xz stream.
+//
+// Every stream is decoded by both loops in single-call mode and in
+// multi-call mode with odd input / output buffer sizes (down to byte by
+// byte, on short streams), and every output must be identical to the
+// original.
+// Then the single-call decode speed of both is printed as MB/s of output,
+// min / median over N runs. Exits non-zero on any mismatch.
+
+#include <elf.h>
+#include <lzma.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "elf_view.h"
+#include "xz_ref.h"
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*, deterministic across hosts
+struct Rng {
+  uint64_t s;
+  explicit Rng(uint64_t seed) : s(seed ? seed : 0x9e3779b97f4a7c15ull) {}
+  uint64_t next() {
+    s ^= s >> 12; s ^= s << 25; s ^= s >> 27;
+    return s * 2685821657736338717ull;
+  }
+  size_t below(size_t n) { return (size_t)(next() % n); }
+};
+
+/* corpus data */
+
+static const size_t DATA_SIZE = 2 << 20;
+
+// NUL-separated mangled-looking names, like a .strtab
+static std::vector<uint8_t> gen_strtab(Rng& rng) {
+  static const char* const PARTS[] = {
+    "android", "Hwc2", "impl", "SurfaceFlinger", "HWComposer", "Layer", "Display",
+    "composite", "commit", "isSupported", "Transform", "NS_", "RKNS_", "St3__1",
+    "shared_ptr", "vector", "allocator", "PhysicalDisplayId", "EE", "Ev", "Eb",
+  };
+  std::vector<uint8_t> out;
+  while (out.size() < DATA_SIZE) {
+    std::string s = rng.below(3) ? "_ZN" : "_ZNK";
+    for (size_t n = 2 + rng.below(6); n > 0; n--) {
+      const char* p = PARTS[rng.below(sizeof(PARTS) / sizeof(PARTS[0]))];
+      s += std::to_string(strlen(p));
+      s += p;
+    }
+    s += std::to_string(rng.below(100000));
+    out.insert(out.end(), s.begin(), s.end());
+    out.push_back(0);
+  }
+  out.resize(DATA_SIZE);
+  return out;
+}
+
+// arm64-looking instruction words: a few opcode templates, random registers
+// and small immediates
+static std::vector<uint8_t> gen_code(Rng& rng) {
+  static const uint32_t OPS[] = {
+    0xf9400000, 0xf9000000, 0xaa0003e0, 0x91000000, 0xd1000000, 0x94000000,
+    0xb4000000, 0x54000000, 0xa9000000, 0xa8c00000, 0xd65f03c0, 0x52800000,
+  };
+  std::vector<uint8_t> out(DATA_SIZE);
+  for (size_t i = 0; i + 4 <= out.size(); i += 4) {
+    uint32_t op = OPS[rng.below(sizeof(OPS) / sizeof(OPS[0]))];
+    uint32_t w = op | (uint32_t)rng.below(32) | ((uint32_t)rng.below(32) << 5) |
+                 ((uint32_t)(rng.below(8) * rng.below(8)) << 10);
+    memcpy(&out[i], &w, 4);
+  }
+  return out;
+}
+
+static std::vector<uint8_t> gen_text(Rng& rng) {
+  static const char* const WORDS[] = {
+    "the", "display", "orientation", "is", "rotated", "by", "surfaceflinger", "when",
+    "a", "frame", "composes", "layers", "into", "buffer", "hook", "returns", "and",
+  };
+  std::vector<uint8_t> out;
+  while (out.size() < DATA_SIZE) {
+    const char* w = WORDS[rng.below(sizeof(WORDS) / sizeof(WORDS[0]))];
+    out.insert(out.end(), w, w + strlen(w));
+    out.push_back(rng.below(12) ? ' ' : '\n');
+  }
+  out.resize(DATA_SIZE);
+  return out;
+}
+
+// runs of short repeating patterns: overlapping matches at distances 0-15
+static std::vector<uint8_t> gen_periodic(Rng& rng) {
+  std::vector<uint8_t> out;
+  while (out.size() < DATA_SIZE) {
+    size_t period = 1 + rng.below(16);
+    uint8_t pat[16];
+    for (size_t i = 0; i < period; i++) pat[i] = (uint8_t)rng.next();
+    for (size_t n = rng.below(4096); n > 0; n--) out.push_back(pat[n % period]);
+  }
+  out.resize(DATA_SIZE);
+  return out;
+}
+
+static std::vector<uint8_t> gen_zeros(Rng&) {
+  return std::vector<uint8_t>(DATA_SIZE, 0);
+}
+
+// incompressible: LZMA2 stores it in uncompressed chunks
+static std::vector<uint8_t> gen_random(Rng& rng) {
+  std::vector<uint8_t> out(DATA_SIZE / 4);
+  for (uint8_t& b : out) b = (uint8_t)rng.next();
+  return out;
+}
+
+struct EncodeOpts {
+  const char* name;
+  uint32_t    preset;
+  int         lc, lp, pb;  // -1: preset default
+  uint32_t    dict_size;   // 0: preset default
+  size_t      block_size;  // 0: one block
+};
+
+static bool xz_compress(const std::vector<uint8_t>& in, const EncodeOpts& o,
+                        std::vector<uint8_t>& out) {
+  lzma_options_lzma lz;
+  if (lzma_lzma_preset(&lz, o.preset)) {
+    return false;
+  }
+  if (o.lc >= 0) lz.lc = (uint32_t)o.lc;
+  if (o.lp >= 0) lz.lp = (uint32_t)o.lp;
+  if (o.pb >= 0) lz.pb = (uint32_t)o.pb;
+  if (o.dict_size) lz.dict_size = o.dict_size;
+  lzma_filter filters[] = { { LZMA_FILTER_LZMA2, &lz }, { LZMA_VLI_UNKNOWN, nullptr } };
+
+  lzma_stream strm = LZMA_STREAM_INIT;
+  lzma_ret ret;
+  if (o.block_size) {
+    lzma_mt mt{};
+    mt.threads = 1;
+    mt.block_size = o.block_size;
+    mt.filters = filters;
+    mt.check = LZMA_CHECK_CRC64;
+    ret = lzma_stream_encoder_mt(&strm, &mt);
+  } else {
+    ret = lzma_stream_encoder(&strm, filters, LZMA_CHECK_CRC64);
+  }
+  if (ret != LZMA_OK) {
+    return false;
+  }
+  out.resize(in.size() + in.size() / 2 + 4096);
+  strm.next_in = in.data();
+  strm.avail_in = in.size();
+  strm.next_out = out.data();
+  strm.avail_out = out.size();
+  ret = lzma_code(&strm, LZMA_FINISH);
+  out.resize(strm.total_out);
+  lzma_end(&strm);
+  return ret == LZMA_STREAM_END;
+}
+
+/* decoders */
+
+struct Decoder {
+  const char* name;
+  struct xz_dec* (*init)(enum xz_mode, uint32_t);
+  enum xz_ret (*run)(struct xz_dec*, struct xz_buf*);
+  void (*end)(struct xz_dec*);
+};
+
+static const Decoder FAST = { "fast", xz_fast_dec_init, xz_fast_dec_run, xz_fast_dec_end };
+static const Decoder REF = { "upstream", xz_ref_dec_init, xz_ref_dec_run, xz_ref_dec_end };
+
+static bool decode_single(const Decoder& d, const std::vector<uint8_t>& in, size_t out_len,
+                          std::vector<uint8_t>& out) {
+  struct xz_dec* s = d.init(XZ_SINGLE, 0);
+  if (!s) return false;
+  out.resize(out_len);
+  xz_buf b{};
+  b.in = in.data();
+  b.in_size = in.size();
+  b.out = out.data();
+  b.out_size = out.size();
+  xz_ret ret = d.run(s, &b);
+  d.end(s);
+  return ret == XZ_STREAM_END && b.out_pos == out_len;
+}
+
+// Multi-call, feeding in_step input bytes and offering out_step output
+// bytes per call.
+static bool decode_multi(const Decoder& d, const std::vector<uint8_t>& in, size_t in_step,
+                         size_t out_step, std::vector<uint8_t>& out) {
+  struct xz_dec* s = d.init(XZ_DYNALLOC, 1u << 26);
+  if (!s) return false;
+  out.clear();
+  std::vector<uint8_t> window(out_step);
+  xz_buf b{};
+  b.in = in.data();
+  b.out = window.data();
+  xz_ret ret = XZ_OK;
+  while (ret == XZ_OK) {
+    b.in_size = std::min(in.size(), b.in_pos + in_step);
+    b.out_pos = 0;
+    b.out_size = out_step;
+    ret = d.run(s, &b);
+    out.insert(out.end(), window.begin(), window.begin() + b.out_pos);
+  }
+  d.end(s);
+  return ret == XZ_STREAM_END;
+}
+
+// streams up to this size are also decoded with tiny buffer steps
+static const size_t SMALL_XZ = 96 << 10;
+
+struct Stream {
+  std::string          name;
+  std::vector<uint8_t> raw;  // expected output
+  std::vector<uint8_t> xz;
+};
+
+static bool check_stream(const Stream& st) {
+  struct Mode {
+    size_t in_step, out_step;
+  };
+  static const Mode MODES[] = {
+    { 1, 1 }, { 7, 13 }, { 4093, 1021 }, { 1 << 16, 1 << 16 },
+  };
+  std::vector<uint8_t> out;
+  for (const Decoder* d : { &FAST, &REF }) {
+    if (!decode_single(*d, st.xz, st.raw.size(), out) || out != st.raw) {
+      fprintf(stderr, "FAIL: %s: %s single-call output differs\n", st.name.c_str(), d->name);
+      return false;
+    }
+    for (const Mode& m : MODES) {
+      // tiny steps take a while, the small streams are enough for them
+      if (m.in_step < 1024 && st.xz.size() > SMALL_XZ) continue;
+      if (!decode_multi(*d, st.xz, m.in_step, m.out_step, out) || out != st.raw) {
+        fprintf(stderr, "FAIL: %s: %s multi-call (%zu in / %zu out) output differs\n",
+                st.name.c_str(), d->name, m.in_step, m.out_step);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static double mb_per_s(size_t bytes, uint64_t ns) {
+  return ns ? (double)bytes / 1e6 / ((double)ns / 1e9) : 0;
+}
+
+struct Speed {
+  uint64_t min_ns, median_ns;
+};
+
+static Speed time_decode(const Decoder& d, const Stream& st, int iters) {
+  std::vector<uint64_t> v;
+  std::vector<uint8_t> out;
+  for (int i = 0; i < iters; i++) {
+    uint64_t t0 = now_ns();
+    decode_single(d, st.xz, st.raw.size(), out);
+    v.push_back(now_ns() - t0);
+  }
+  std::sort(v.begin(), v.end());
+  return { v.front(), v[v.size() / 2] };
+}
+
+// .gnu_debugdata of an ELF file, or the whole file
+static bool load_file(const char* path, Stream& st) {
+  ElfView elf;
+  if (!elf.map_file(path)) {
+    fprintf(stderr, "%s: cannot read\n", path);
+    return false;
+  }
+  const uint8_t* data = elf.data;
+  size_t size = elf.size;
+  st.name = path;
+  if (elf.as_ehdr()) {
+    const Elf64_Shdr* sec = elf.find_section(".gnu_debugdata");
+    data = elf.section_data(sec);
+    if (!data) {
+      fprintf(stderr, "%s: no .gnu_debugdata\n", path);
+      return false;
+    }
+    size = (size_t)sec->sh_size;
+    const char* base = strrchr(path, '/');
+    st.name = std::string(base ? base + 1 : path) + " .gnu_debugdata";
+  }
+  st.xz.assign(data, data + size);
+  // expected output: what upstream makes of it
+  if (!decode_multi(REF, st.xz, 1 << 16, 1 << 16, st.raw)) {
+    fprintf(stderr, "%s: not a valid .xz stream\n", path);
+    return false;
+  }
+  return true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--iters N] [file ...]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  int iters = 10;
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iters") && i + 1 < argc) {
+      iters = atoi(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (iters < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  xz_crc32_init();
+  xz_crc64_init();
+
+  struct Data {
+    const char* name;
+    std::vector<uint8_t> (*gen)(Rng&);
+  };
+  static const Data DATA[] = {
+    { "strtab", gen_strtab }, { "code", gen_code }, { "text", gen_text },
+    { "periodic", gen_periodic }, { "zeros", gen_zeros }, { "random", gen_random },
+  };
+  static const EncodeOpts OPTS[] = {
+    { "p6",          6, -1, -1, -1, 0,         0 },
+    { "p6 64k",      6, -1, -1, -1, 0,         64 << 10 },
+    { "p9 lc0",      9, 0, -1, -1, 0,          0 },
+    { "p1 lc4",      1, 4, 0, 0, 0,            0 },
+    { "p6 lp2 pb2",  6, 2, 2, 2, 0,            0 },
+    { "p6 dict4k",   6, -1, -1, -1, 4096,      0 },
+  };
+
+  std::vector<Stream> corpus;
+  for (const Data& d : DATA) {
+    Rng rng(0x5f0 + (uint64_t)(&d - DATA));
+    std::vector<uint8_t> raw = d.gen(rng);
+    for (const EncodeOpts& o : OPTS) {
+      // every setting on .strtab-like data, the defaults on the rest
+      if (&o != OPTS && &o != OPTS + 1 && strcmp(d.name, "strtab") != 0) continue;
+      Stream st;
+      st.name = std::string(d.name) + " " + o.name;
+      st.raw = raw;
+      if (!xz_compress(raw, o, st.xz)) {
+        fprintf(stderr, "%s: liblzma encode failed\n", st.name.c_str());
+        return 1;
+      }
+      corpus.push_back(std::move(st));
+    }
+    // a short one for the tiny-step multi-call checks
+    Stream small;
+    small.name = std::string(d.name) + " p6 64k raw";
+    small.raw.assign(raw.begin(), raw.begin() + std::min(raw.size(), (size_t)64 << 10));
+    if (!xz_compress(small.raw, OPTS[0], small.xz) || small.xz.size() > SMALL_XZ) {
+      fprintf(stderr, "%s: liblzma encode failed\n", small.name.c_str());
+      return 1;
+    }
+    corpus.push_back(std::move(small));
+  }
+  for (const char* f : files) {
+    Stream st;
+    if (!load_file(f, st)) return 1;
+    corpus.push_back(std::move(st));
+  }
+
+  for (const Stream& st : corpus) {
+    if (!check_stream(st)) return 1;
+  }
+  printf("%zu streams: fast and upstream output identical "
+         "(single-call, multi-call 1/1, 7/13, 4093/1021, 64k/64k)\n\n", corpus.size());
+
+  printf("decode MB/s (%d runs)       out MiB   ratio   upstream min/med      fast min/med   gain\n",
+         iters);
+  uint64_t ref_total = 0, fast_total = 0;
+  for (const Stream& st : corpus) {
+    Speed r = time_decode(REF, st, iters);
+    Speed f = time_decode(FAST, st, iters);
+    ref_total += r.median_ns;
+    fast_total += f.median_ns;
+    printf("  %-24s %8.2f %7.2f %9.0f %7.0f %9.0f %7.0f %5.2fx\n", st.name.c_str(),
+           (double)st.raw.size() / (1 << 20), (double)st.raw.size() / (double)st.xz.size(),
+           mb_per_s(st.raw.size(), r.min_ns), mb_per_s(st.raw.size(), r.median_ns),
+           mb_per_s(st.raw.size(), f.min_ns), mb_per_s(st.raw.size(), f.median_ns),
+           (double)r.median_ns / (double)f.median_ns);
+  }
+  printf("  %-24s %56s %5.2fx\n", "total (median time)", "",
+         (double)ref_total / (double)fast_total);
+  return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * The XZ_DEC_FAST decode loop under xz_fast_* names, so xz_bench checks and
+ * times it whichever loop SFROTATE_XZ_FAST builds into xzdec. Same layout
+ * as xz_ref.c.
+ */
+
+#define XZ_DEC_FAST
+
+#define xz_dec_init         xz_fast_dec_init
+#define xz_dec_run          xz_fast_dec_run
+#define xz_dec_reset        xz_fast_dec_reset
+#define xz_dec_end          xz_fast_dec_end
+#define xz_dec_lzma2_create xz_fast_dec_lzma2_create
+#define xz_dec_lzma2_reset  xz_fast_dec_lzma2_reset
+#define xz_dec_lzma2_run    xz_fast_dec_lzma2_run
+#define xz_dec_lzma2_end    xz_fast_dec_lzma2_end
+
+#include "../third_party/xz/xz_dec_stream.c"
+#include "../third_party/xz/xz_dec_lzma2.c"
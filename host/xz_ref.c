@@ -0,0 +1,20 @@
+/*
+ * The upstream XZ Embedded decoder (without XZ_DEC_FAST) under xz_ref_*
+ * names, so xz_bench can compare the fast decode path against it in one
+ * process. Both .c files go in one translation unit, like the kernel's
+ * decompress_unxz.c does; the CRC code is shared with xzdec.
+ */
+
+#undef XZ_DEC_FAST
+
+#define xz_dec_init         xz_ref_dec_init
+#define xz_dec_run          xz_ref_dec_run
+#define xz_dec_reset        xz_ref_dec_reset
+#define xz_dec_end          xz_ref_dec_end
+#define xz_dec_lzma2_create xz_ref_dec_lzma2_create
+#define xz_dec_lzma2_reset  xz_ref_dec_lzma2_reset
+#define xz_dec_lzma2_run    xz_ref_dec_lzma2_run
+#define xz_dec_lzma2_end    xz_ref_dec_lzma2_end
+
+#include "../third_party/xz/xz_dec_stream.c"
+#include "../third_party/xz/xz_dec_lzma2.c"
@@ -0,0 +1,18 @@
+#pragma once
+
+// Upstream decoder built by xz_ref.c and the XZ_DEC_FAST one built by
+// xz_fast.c; same API as xz.h.
+
+extern "C" {
+#include "xz.h"
+
+struct xz_dec* xz_ref_dec_init(enum xz_mode mode, uint32_t dict_max);
+enum xz_ret    xz_ref_dec_run(struct xz_dec* s, struct xz_buf* b);
+void           xz_ref_dec_reset(struct xz_dec* s);
+void           xz_ref_dec_end(struct xz_dec* s);
+
+struct xz_dec* xz_fast_dec_init(enum xz_mode mode, uint32_t dict_max);
+enum xz_ret    xz_fast_dec_run(struct xz_dec* s, struct xz_buf* b);
+void           xz_fast_dec_reset(struct xz_dec* s);
+void           xz_fast_dec_end(struct xz_dec* s);
+}
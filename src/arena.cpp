@@ -0,0 +1,147 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "log.h"
+
+static const size_t ARENA_ALIGN = 16;
+
+// innermost scope of this thread; outer scopes are linked through outer
+static thread_local Arena* t_arena = nullptr;
+
+Arena::~Arena() {
+  release();
+}
+
+bool Arena::init(const char* arena_name, size_t arena_budget) {
+  release();
+  name = arena_name;
+  void* p = mmap(nullptr, arena_budget, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED) {
+    LOGE("%s: cannot reserve %zu bytes", name, arena_budget);
+    return false;
+  }
+  base_ = (uint8_t*)p;
+  budget = arena_budget;
+  used = peak = allocs = refused = last_ = 0;
+  return true;
+}
+
+void Arena::release() {
+  if (base_) {
+    munmap(base_, budget);
+    base_ = nullptr;
+  }
+}
+
+void* Arena::alloc(size_t n) {
+  const size_t start = (used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (!base_ || start > budget || n > budget - start) {
+    LOGE("%s: %zu more bytes would exceed the %zu byte budget (%zu in use)",
+         name, n, budget, used);
+    refused++;
+    return nullptr;
+  }
+  last_ = start;
+  used = start + n;
+  peak = used > peak ? used : peak;
+  allocs++;
+  return base_ + start;
+}
+
+void* Arena::realloc(void* p, size_t old_n, size_t n) {
+  if (p && (uint8_t*)p == base_ + last_ && n <= budget - last_) {
+    used = last_ + n;
+    peak = used > peak ? used : peak;
+    return p;
+  }
+  void* q = alloc(n);
+  if (q && p) {
+    memcpy(q, p, old_n < n ? old_n : n);
+    free(p);
+  }
+  return q;
+}
+
+void Arena::free(void* p) {
+  if (p && (uint8_t*)p == base_ + last_) {
+    used = last_;
+  }
+}
+
+bool Arena::owns(const void* p) const {
+  return base_ && (const uint8_t*)p >= base_ && (const uint8_t*)p < base_ + budget;
+}
+
+ArenaScope::ArenaScope(const char* name, size_t budget) {
+  if (budget == 0 || !arena.init(name, budget)) {
+    return;
+  }
+  arena.outer = t_arena;
+  t_arena = &arena;
+  active_ = true;
+}
+
+ArenaScope::~ArenaScope() {
+  if (!active_) {
+    return;
+  }
+  t_arena = arena.outer;
+  LOGI("%s: peak %zu KiB of %zu KiB in %zu allocations%s", arena.name, arena.peak / 1024,
+       arena.budget / 1024, arena.allocs, arena.refused ? ", over budget" : "");
+  arena.release();
+}
+
+static Arena* owner_of(const void* p) {
+  for (Arena* a = t_arena; a; a = a->outer) {
+    if (a->owns(p)) {
+      return a;
+    }
+  }
+  return nullptr;
+}
+
+void* arena_alloc(size_t n) {
+  return t_arena ? t_arena->alloc(n) : malloc(n);
+}
+
+void* arena_realloc(void* p, size_t old_n, size_t n) {
+  if (!p) {
+    return arena_alloc(n);
+  }
+  Arena* a = owner_of(p);
+  if (a && a == t_arena) {
+    return a->realloc(p, old_n, n);
+  }
+  if (!a && !t_arena) {
+    return realloc(p, n);
+  }
+  // moves between an outer arena or malloc and the current arena
+  void* q = arena_alloc(n);
+  if (q) {
+    memcpy(q, p, old_n < n ? old_n : n);
+    arena_free(p);
+  }
+  return q;
+}
+
+void arena_free(void* p) {
+  if (!p) {
+    return;
+  }
+  if (Arena* a = owner_of(p)) {
+    a->free(p);
+  } else {
+    free(p);
+  }
+}
+
+// xz-embedded's kmalloc() / vmalloc() (XZ_ARENA in xz_config.h)
+extern "C" void* xz_arena_alloc(size_t size) {
+  return arena_alloc(size);
+}
+
+extern "C" void xz_arena_free(void* ptr) {
+  arena_free(ptr);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Memory for one symbol resolution.
+//
+// surfaceflinger runs for days, and a resolution's few large, short-lived
+// buffers (the decompressed mini ELF, the xz dictionary, index tables) would
+// fragment its heap. Inside an ArenaScope they come instead from a single
+// mmap()ed region with a fixed budget, which is unmapped as a whole when the
+// scope ends. Pages are only backed once touched, so the budget is a limit,
+// not a cost.
+
+// Bump allocator over one reserved mapping. free() only gives back the most
+// recent allocation; the rest is reclaimed by release().
+struct Arena {
+  Arena() = default;
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Reserves budget bytes. False if the mapping fails.
+  bool init(const char* name, size_t budget);
+  void release();
+
+  // 16-byte aligned, or nullptr (logged) if it would exceed the budget.
+  void* alloc(size_t n);
+  // Grows p in place if it is the most recent allocation, copies it
+  // otherwise. nullptr if out of budget, p is then still valid.
+  void* realloc(void* p, size_t old_n, size_t n);
+  void  free(void* p);
+  bool  owns(const void* p) const;
+
+  const char* name = nullptr;
+  size_t      budget = 0;
+  size_t      used = 0;   // end of the last allocation
+  size_t      peak = 0;
+  size_t      allocs = 0;
+  size_t      refused = 0; // allocations over the budget
+  Arena*      outer = nullptr;
+
+private:
+  uint8_t* base_ = nullptr;
+  size_t   last_ = 0; // offset of the most recent allocation
+};
+
+// While alive, arena_alloc() (and xz-embedded's kmalloc() / vmalloc(), see
+// xz_config.h) on this thread take memory from a fresh Arena of budget
+// bytes. At the end of the scope the arena is unmapped and its peak logged.
+// Scopes nest. With budget 0, or if the mapping fails, allocations go to
+// malloc() as they do outside any scope.
+struct ArenaScope {
+  ArenaScope(const char* name, size_t budget);
+  ~ArenaScope();
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+  Arena arena;
+
+private:
+  bool active_ = false;
+};
+
+// From the innermost ArenaScope of this thread, or malloc() outside one.
+// Memory from a scope must be freed (or abandoned) before the scope ends.
+void* arena_alloc(size_t n);
+void* arena_realloc(void* p, size_t old_n, size_t n);
+void  arena_free(void* p);
+
+// Growable array of a trivially copyable T on arena_alloc(). A minimal
+// std::vector that reports running out of memory (the arena budget) by
+// returning false instead of throwing.
+template <typename T>
+struct ArenaArray {
+  ArenaArray() = default;
+  ~ArenaArray() { arena_free(data_); }
+  ArenaArray(const ArenaArray&) = delete;
+  ArenaArray& operator=(const ArenaArray&) = delete;
+
+  bool reserve(size_t n) {
+    if (n <= cap_) {
+      return true;
+    }
+    if (n > SIZE_MAX / sizeof(T)) {
+      return false;
+    }
+    T* p = (T*)arena_realloc(data_, cap_ * sizeof(T), n * sizeof(T));
+    if (!p) {
+      return false;
+    }
+    data_ = p;
+    cap_ = n;
+    return true;
+  }
+  // New elements are zeroed.
+  bool resize(size_t n) {
+    if (!reserve(n)) {
+      return false;
+    }
+    if (n > size_) {
+      memset((void*)(data_ + size_), 0, (n - size_) * sizeof(T));
+    }
+    size_ = n;
+    return true;
+  }
+  bool push_back(const T& v) {
+    if (size_ == cap_ && !reserve(cap_ ? cap_ * 2 : 16)) {
+      return false;
+    }
+    data_[size_++] = v;
+    return true;
+  }
+  void clear() { size_ = 0; }
+
+  T*       data() { return data_; }
+  const T* data() const { return data_; }
+  size_t   size() const { return size_; }
+  bool     empty() const { return size_ == 0; }
+  T&       operator[](size_t i) { return data_[i]; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  T&       back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+  T*       begin() { return data_; }
+  T*       end() { return data_ + size_; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+private:
+  T*     data_ = nullptr;
+  size_t size_ = 0;
+  size_t cap_ = 0;
+};
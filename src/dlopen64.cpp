@@ -1,9 +1,21 @@
 // Minimal ARM64 Android injector that calls dlopen() in a target process.
 //
 // Usage:
-//   ./dlopen64 <pid|process-name> /full/path/lib.so
+//   ./dlopen64 [--budget-ms N] [--mem-budget-kb N] [--no-handoff] <pid|process-name> /full/path/lib.so[@init_symbol] [...]
+//
+// Every library (and its optional init function, called with no arguments
+// after dlsym()) is handled in one ptrace session with one scratch mapping,
+// so the target is stopped once. Everything that can be done up front
+// (argument checks, one read of the target's maps, remote symbol addresses)
+// happens before the target is stopped. The stop window is printed per
+// phase; with --budget-ms the exit status is 13 if it was over budget.
+//
+// When the target is surfaceflinger, sfrotate's hook addresses are also
+// resolved here, before the stop, and handed to the library through
+// SFROTATE_HANDOFF (see handoff.h); --no-handoff skips that.
 
 #include <sys/ptrace.h>
+#include <time.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
@@ -18,6 +30,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <vector>
+
+#include "handoff.h"
+#include "module_map.h"
+#include "offset_cache.h"
+#include "sf_symbols.h"
+#include "stop_window.h"
+#include "sym_resolver.h"
 
 #if !defined(__aarch64__)
 # error "ARM64 only"
@@ -27,7 +49,7 @@
 #define LOGI(...) do { fprintf(stdout, "[*] " __VA_ARGS__); fputc('\n', stdout); } while (0)
 
 #include <sys/user.h>
-#include <linux/elf.h>
+#include <elf.h> // NT_PRSTATUS
 
 static int get_regs(pid_t pid, struct user_pt_regs* regs) {
   struct iovec io { regs, sizeof(*regs) };
@@ -64,35 +86,25 @@ static pid_t find_pid_by_name(const char* name) {
   return -1;
 }
 
-static uintptr_t get_module_base(pid_t pid, const char* needle) {
-  char maps[64];
-  snprintf(maps, sizeof maps, "/proc/%d/maps", pid);
-  FILE* f = fopen(maps, "re");
-  if (!f) return 0;
-  char line[1024];
-  uintptr_t best = 0;
-  while (fgets(line, sizeof line, f)) {
-    if (!strstr(line, needle)) continue;
-    unsigned long start=0; char perms[5]={0};
-    if (sscanf(line, "%lx-%*lx %4s", &start, perms) == 2) {
-      if (strchr(perms, 'x')) { best = start; break; }
-      if (!best) best = start;
-    }
-  }
-  fclose(f);
-  return best;
+// Base of a module in this process: from the dynamic linker, or from our own
+// maps for a module it lists under another name.
+static bool local_module(const char* needle, ModuleInfo* out) {
+  if (module_self(needle, out)) return true;
+  static ModuleTable self;
+  static const bool loaded = self.load(getpid());
+  const ModuleInfo* m = loaded ? self.find(needle) : nullptr;
+  if (m) *out = *m;
+  return m != nullptr;
 }
 
-static uintptr_t local_module_base(const char* needle) {
-  return get_module_base(getpid(), needle);
-}
-
-static uintptr_t remote_addr_from_local(pid_t pid, const char* module_name, void* local_fn) {
-  uintptr_t l_base = local_module_base(module_name);
-  uintptr_t r_base = get_module_base(pid, module_name);
-  if (!l_base || !r_base) return 0;
-  uintptr_t off = (uintptr_t)local_fn - l_base;
-  return r_base + off;
+// Address of local_fn in the target: the same offset from the base of
+// module_name in both processes.
+static uintptr_t remote_addr_from_local(const ModuleTable& remote, const char* module_name,
+                                        void* local_fn) {
+  ModuleInfo local;
+  const ModuleInfo* r = remote.find(module_name);
+  if (!r || !local_module(module_name, &local)) return 0;
+  return r->base + ((uintptr_t)local_fn - local.base);
 }
 
 static int write_remote(pid_t pid, uintptr_t remote, const void* buf, size_t len) {
@@ -115,56 +127,153 @@ static int write_remote(pid_t pid, uintptr_t remote, const void* buf, size_t len
   return 0;
 }
 
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
 // --- tiny call stub (ARM64) ---
 static const uint32_t LDR_X16_LITERAL = 0x58000090; // ldr x16, #8
 static const uint32_t BLR_X16         = 0xD63F0200; // blr x16
 static const uint32_t BRK_0           = 0xD4200000; // brk #0
 static const uint32_t NOP             = 0xD503201F; // nop
 
+static const size_t STUB_SIZE   = 0x18;
+static const size_t STUB_TARGET = 0x10; // offset of the literal loaded into x16
+
 struct RemoteSession {
   pid_t pid;
   bool attached{false};
   bool have_saved{false};
   struct user_pt_regs saved{};
 
+  uintptr_t scratch{0};      // stub + strings, shared by every call
+  size_t    scratch_size{0};
+  size_t    scratch_used{0};
+
+  StopWindow window;         // time spent stopped, per phase
+
+  // PTRACE_SEIZE does not stop the target (no SIGSTOP is queued, unlike
+  // PTRACE_ATTACH); PTRACE_INTERRUPT then stops just this thread, and the
+  // stop window is timed from there.
   explicit RemoteSession(pid_t p) : pid(p) {
-    if (ptrace(PTRACE_ATTACH, pid, 0, 0) == 0 && wait_stopped(pid) == 0) {
-      attached = true;
-      if (get_regs(pid, &saved) == 0) have_saved = true;
+    if (ptrace(PTRACE_SEIZE, pid, 0, 0) != 0) {
+      LOGE("PTRACE_SEIZE: %s", strerror(errno));
+      return;
     }
-  }
-  ~RemoteSession() {
-    if (attached) {
-      if (have_saved) set_regs(pid, &saved);
-      ptrace(PTRACE_DETACH, pid, 0, 0);
+    attached = true;
+    window.start(now_ns());
+    if (ptrace(PTRACE_INTERRUPT, pid, 0, 0) != 0 || wait_stopped(pid) != 0) {
+      LOGE("PTRACE_INTERRUPT: %s", strerror(errno));
+      return;
     }
+    if (get_regs(pid, &saved) == 0) have_saved = true;
+    phase("interrupt");
+  }
+  ~RemoteSession() { detach(); }
+
+  // Restore the registers and let the target run again. Ends the stop
+  // window; the per-phase report is printed here.
+  void detach() {
+    if (!attached) return;
+    if (have_saved) set_regs(pid, &saved);
+    ptrace(PTRACE_DETACH, pid, 0, 0);
+    attached = false;
+    phase("detach");
+    window.report();
   }
 
   bool ok() const { return attached && have_saved; }
 
-  // Call remote function (fn_addr) with up to 4 args using a small stub placed at 'scratch'.
+  // Close the current phase (StopWindow::phase) now.
+  void phase(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    window.vphase(now_ns(), fmt, ap);
+    va_end(ap);
+  }
+
+  // Run fn_addr directly with up to 6 args. lr is 0, so returning faults
+  // and stops the target again; the pending SIGSEGV is dropped when the
+  // registers are restored and the target continues without it.
   // Returns x0, or -1 on failure.
-  long call_with_stub(uintptr_t scratch, uintptr_t fn_addr,
+  long call_direct(uintptr_t fn_addr,
+                   uintptr_t x0=0, uintptr_t x1=0, uintptr_t x2=0,
+                   uintptr_t x3=0, uintptr_t x4=0, uintptr_t x5=0) {
+    if (!ok() || !fn_addr) return -1;
+    struct user_pt_regs regs = saved;
+    regs.regs[0] = x0; regs.regs[1] = x1; regs.regs[2] = x2;
+    regs.regs[3] = x3; regs.regs[4] = x4; regs.regs[5] = x5;
+    regs.pc = fn_addr; regs.regs[30] = 0;
+    return run(regs);
+  }
+
+  // Call remote function (fn_addr) with up to 4 args through the stub in
+  // the scratch mapping (returns via brk). Only the stub's target literal is
+  // rewritten per call. Returns x0, or -1 on failure.
+  long call_with_stub(uintptr_t fn_addr,
                       uintptr_t x0=0, uintptr_t x1=0,
                       uintptr_t x2=0, uintptr_t x3=0) {
-    if (!ok()) return -1;
+    if (!ok() || !scratch) return -1;
+
+    uint64_t target = (uint64_t)fn_addr;
+    if (write_remote(pid, scratch + STUB_TARGET, &target, sizeof target) != 0) {
+      LOGE("write stub target failed");
+      return -1;
+    }
 
-    // write stub
-    uint8_t stub[0x18]{0};
+    struct user_pt_regs regs = saved;
+    regs.regs[0] = x0; regs.regs[1] = x1; regs.regs[2] = x2; regs.regs[3] = x3;
+    regs.pc = scratch; regs.regs[30] = 0;
+    return run(regs);
+  }
+
+  // Map one RWX scratch region via remote mmap and write the call stub to
+  // it. Strings go after the stub (see put_string()).
+  bool map_scratch(size_t size, uintptr_t r_mmap) {
+    long addr = call_direct(r_mmap, 0, (uintptr_t)size,
+                            PROT_READ | PROT_WRITE | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS, (uintptr_t)-1, 0);
+    if (addr < 0x1000) { LOGE("mmap failed: x0=0x%lx", (unsigned long)addr); return false; }
+
+    uint8_t stub[STUB_SIZE]{0};
     *(uint32_t*)(stub + 0x00) = LDR_X16_LITERAL;
     *(uint32_t*)(stub + 0x04) = BLR_X16;
     *(uint32_t*)(stub + 0x08) = BRK_0;
     *(uint32_t*)(stub + 0x0C) = NOP;
-    *(uint64_t*)(stub + 0x10) = (uint64_t)fn_addr;
-    if (write_remote(pid, scratch, stub, sizeof stub) != 0) {
+    if (write_remote(pid, (uintptr_t)addr, stub, sizeof stub) != 0) {
       LOGE("write stub failed");
-      return -1;
+      return false;
     }
+    scratch = (uintptr_t)addr;
+    scratch_size = size;
+    scratch_used = 0x100;
+    return true;
+  }
 
-    // set args & run
-    struct user_pt_regs regs = saved;
-    regs.regs[0] = x0; regs.regs[1] = x1; regs.regs[2] = x2; regs.regs[3] = x3;
-    regs.pc = scratch; regs.regs[30] = 0;
+  // Copy a NUL-terminated string into the scratch region; 0 on failure.
+  uintptr_t put_string(const char* str) {
+    size_t len = strlen(str) + 1;
+    if (!scratch || scratch_used + len > scratch_size) { LOGE("scratch full"); return 0; }
+    uintptr_t at = scratch + scratch_used;
+    if (write_remote(pid, at, str, len) != 0) { LOGE("write string failed"); return 0; }
+    scratch_used += (len + 7) & ~(size_t)7;
+    return at;
+  }
+
+  // munmap the scratch region. Called directly, as the stub is in the
+  // region being unmapped.
+  bool unmap_scratch(uintptr_t r_munmap) {
+    if (!scratch) return true;
+    long r = call_direct(r_munmap, scratch, scratch_size);
+    if (r != 0) { LOGE("munmap(scratch) returned %ld", r); return false; }
+    scratch = 0;
+    return true;
+  }
+
+private:
+  long run(struct user_pt_regs& regs) {
     if (set_regs(pid, &regs) != 0) { LOGE("SETREGS(call)"); return -1; }
     if (ptrace(PTRACE_CONT, pid, 0, 0) != 0) { LOGE("CONT(call): %s", strerror(errno)); return -1; }
     if (wait_stopped(pid) != 0) { LOGE("wait(call)"); return -1; }
@@ -175,35 +284,94 @@ struct RemoteSession {
     if (set_regs(pid, &saved) != 0) { LOGE("restore regs failed"); return -1; }
     return ret;
   }
+};
 
-  // Allocate RWX memory via remote mmap and return its address (or 0 on failure).
-  uintptr_t remote_mmap(size_t size, uintptr_t r_mmap) {
-    if (!ok() || !r_mmap) return 0;
-    struct user_pt_regs regs = saved;
-    regs.regs[0] = 0;               // addr
-    regs.regs[1] = (uintptr_t)size; // len
-    regs.regs[2] = PROT_READ | PROT_WRITE | PROT_EXEC;
-    regs.regs[3] = MAP_PRIVATE | MAP_ANONYMOUS;
-    regs.regs[4] = (uintptr_t)-1;   // fd
-    regs.regs[5] = 0;               // off
-    regs.pc = r_mmap; regs.regs[30] = 0;
-    if (set_regs(pid, &regs) != 0) { LOGE("SETREGS(mmap)"); return 0; }
-    if (ptrace(PTRACE_CONT, pid, 0, 0) != 0) { LOGE("CONT(mmap): %s", strerror(errno)); return 0; }
-    if (wait_stopped(pid) != 0) { LOGE("wait(mmap)"); return 0; }
-    if (get_regs(pid, &regs) != 0) { LOGE("GETREGS(mmap ret)"); return 0; }
-    uintptr_t addr = regs.regs[0];
-    // restore after syscall
-    if (set_regs(pid, &saved) != 0) { LOGE("restore regs after mmap failed"); return 0; }
-    if ((long)addr < 0x1000) { LOGE("mmap failed: x0=0x%lx", (unsigned long)addr); return 0; }
-    return addr;
+// Remote address of a libc/libdl function, found from the matching local
+// module. 0 if none of the candidate modules is mapped in the target.
+static uintptr_t remote_fn(const ModuleTable& target, const char* name,
+                           const char* const* modules, size_t nmod) {
+  void* local = dlsym(RTLD_NEXT, name);
+  if (!local) return 0;
+  for (size_t i = 0; i < nmod; i++) {
+    uintptr_t r = remote_addr_from_local(target, modules[i], local);
+    if (r) {
+      LOGI("remote %s in %s @ 0x%lx", name, modules[i], (unsigned long)r);
+      return r;
+    }
   }
+  LOGE("failed to locate remote %s()", name);
+  return 0;
+}
+
+// Resolve sfrotate's hook targets in surfaceflinger (pid) from here and
+// write them to the handoff file, so the library's constructor can skip
+// resolution inside the compositor.
+static void write_sf_handoff(pid_t pid, const ModuleTable& target) {
+  const ModuleInfo* sf = target.find(sf_bin_path());
+  uintptr_t base = sf ? sf->base : 0;
+  if (!base) {
+    LOGI("target is not surfaceflinger, no handoff");
+    return;
+  }
+  GnuDebugLookup lookups[] = {
+    { SYM_HIDL_IS_SUPPORTED, 0, SYM_TIER_NONE },
+    { SYM_AIDL_IS_SUPPORTED, 0, SYM_TIER_NONE },
+    { SYM_IMPL,              0, SYM_TIER_NONE },
+  };
+  const size_t n = sizeof(lookups) / sizeof(lookups[0]);
+
+  uint64_t t0 = now_ns();
+  size_t found = resolve_addrs_cached(sf_bin_path(), sf_offset_cache_path(),
+                                      sf_offset_manifest_path(), lookups, n, base);
+  double ms = (double)(now_ns() - t0) / 1e6;
+  for (size_t i = 0; i < n; i++) {
+    LOGI("  %s @ 0x%lx (%s)", lookups[i].mangled_name, (unsigned long)lookups[i].addr,
+         sym_tier_name(lookups[i].tier));
+  }
+  if (!found) {
+    LOGE("no hook targets resolved, library will resolve in-process");
+    return;
+  }
+  if (handoff_write(sf_handoff_path(), pid, base, lookups, n)) {
+    LOGI("handoff: %zu/%zu addresses in %.3f ms -> %s", found, n, ms, sf_handoff_path());
+  }
+}
+
+// One library to load: "path" or "path@init_symbol".
+struct LoadReq {
+  char        path[PATH_MAX];
+  const char* init; // nullptr: dlopen only
 };
 
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--budget-ms N] [--mem-budget-kb N] [--no-handoff] <pid|process-name> /full/path/lib.so[@init_symbol] [...]\n", argv0);
+}
+
 int main(int argc, char** argv) {
-  if (argc != 3) {
-    fprintf(stderr, "Usage: %s <pid|process-name> /full/path/lib.so\n", argv[0]);
+  double budget_ms = 0;
+  bool handoff = true;
+  int argi = 1;
+  while (argi < argc && argv[argi][0] == '-') {
+    if (!strcmp(argv[argi], "--budget-ms") && argi + 1 < argc) {
+      budget_ms = atof(argv[argi + 1]);
+      argi += 2;
+    } else if (!strcmp(argv[argi], "--mem-budget-kb") && argi + 1 < argc) {
+      resolver_set_budget((size_t)strtoul(argv[argi + 1], nullptr, 10) * 1024);
+      argi += 2;
+    } else if (!strcmp(argv[argi], "--no-handoff")) {
+      handoff = false;
+      argi++;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - argi < 2) {
+    usage(argv[0]);
     return 1;
   }
+  argv += argi - 1;
+  argc -= argi - 1;
 
   // resolve target pid
   pid_t pid = 0;
@@ -211,63 +379,99 @@ int main(int argc, char** argv) {
   else pid = find_pid_by_name(argv[1]);
   if (pid <= 0) { LOGE("bad pid/process: %s", argv[1]); return 2; }
 
-  // check lib path
-  const char* libpath = argv[2];
-  struct stat st{};
-  if (stat(libpath, &st) != 0) { LOGE("cannot stat %s", libpath); return 3; }
+  // parse and check the libraries before stopping anything
+  const int nreq = argc - 2;
+  std::vector<LoadReq> reqs((size_t)nreq); // zeroed, freed on every return
+  size_t strings = 0;
+  for (int i = 0; i < nreq; i++) {
+    const char* arg = argv[i + 2];
+    const char* at = strrchr(arg, '@');
+    size_t plen = at ? (size_t)(at - arg) : strlen(arg);
+    if (plen == 0 || plen >= sizeof reqs[i].path) { LOGE("bad library argument: %s", arg); return 3; }
+    memcpy(reqs[i].path, arg, plen);
+    reqs[i].init = at && at[1] ? at + 1 : nullptr;
 
-  // find remote dlopen
-  void* local_dlopen = dlsym(RTLD_NEXT, "dlopen");
-  uintptr_t r_dlopen = 0;
+    struct stat st{};
+    if (stat(reqs[i].path, &st) != 0) { LOGE("cannot stat %s", reqs[i].path); return 3; }
+    strings += plen + 8 + (reqs[i].init ? strlen(reqs[i].init) + 8 : 0);
+  }
+
+  // find remote dlopen / dlsym / mmap / munmap
   const char* cand[] = {
     "libdl.so",
     "bionic/libdl.so",
     "linker64",
     "/apex/com.android.runtime/lib64/bionic/libdl.so"
   };
-  for (const char* m : cand) {
-    r_dlopen = remote_addr_from_local(pid, m, local_dlopen);
-    if (r_dlopen) { LOGI("remote dlopen in %s @ 0x%lx", m, (unsigned long)r_dlopen); break; }
-  }
-  if (!r_dlopen) { LOGE("failed to locate remote dlopen()"); return 4; }
-
-  // find remote mmap
-  void* local_mmap = dlsym(RTLD_NEXT, "mmap");
-  uintptr_t r_mmap = 0;
   const char* libcand[] = {
     "libc.so",
     "bionic/libc.so",
     "/apex/com.android.runtime/lib64/bionic/libc.so"
   };
-  for (const char* m : libcand) {
-    r_mmap = remote_addr_from_local(pid, m, local_mmap);
-    if (r_mmap) { LOGI("remote mmap in %s @ 0x%lx", m, (unsigned long)r_mmap); break; }
+  const size_t ncand = sizeof(cand) / sizeof(cand[0]);
+  const size_t nlibcand = sizeof(libcand) / sizeof(libcand[0]);
+
+  ModuleTable target_maps;
+  if (!target_maps.load(pid)) {
+    LOGE("cannot read maps of %d", (int)pid);
+    return 4;
   }
-  if (!r_mmap) { LOGE("failed to locate remote mmap"); return 5; }
 
-  // attach
+  if (handoff) write_sf_handoff(pid, target_maps);
+
+  uintptr_t r_dlopen = remote_fn(target_maps, "dlopen", cand, ncand);
+  if (!r_dlopen) return 4;
+  uintptr_t r_dlsym = 0;
+  for (int i = 0; i < nreq && !r_dlsym; i++) {
+    if (reqs[i].init) {
+      r_dlsym = remote_fn(target_maps, "dlsym", cand, ncand);
+      if (!r_dlsym) return 4;
+    }
+  }
+  uintptr_t r_mmap = remote_fn(target_maps, "mmap", libcand, nlibcand);
+  if (!r_mmap) return 5;
+  uintptr_t r_munmap = remote_fn(target_maps, "munmap", libcand, nlibcand);
+  if (!r_munmap) return 5;
+
+  // stop the target: everything from here to detach is the stop window
   RemoteSession S(pid);
   if (!S.ok()) { LOGE("ptrace attach / save-regs failed"); return 6; }
 
-  // scratch page
-  uintptr_t scratch = S.remote_mmap(0x2000, r_mmap);
-  if (!scratch) return 7;
-  LOGI("remote scratch @ 0x%lx", (unsigned long)scratch);
+  // one scratch mapping for the stub and every string
+  size_t scratch_size = (0x100 + strings + 0xfff) & ~(size_t)0xfff;
+  if (!S.map_scratch(scratch_size, r_mmap)) return 7;
+  LOGI("remote scratch @ 0x%lx (0x%zx bytes)", (unsigned long)S.scratch, scratch_size);
+  S.phase("mmap scratch");
 
-  // write library path at scratch+0x100
-  uintptr_t remote_path = scratch + 0x100;
-  if (write_remote(pid, remote_path, libpath, strlen(libpath) + 1) != 0) {
-    LOGE("write path failed");
-    return 8;
+  int rc = 0;
+  for (int i = 0; i < nreq && rc == 0; i++) {
+    const LoadReq& r = reqs[i];
+    uintptr_t remote_path = S.put_string(r.path);
+    if (!remote_path) { rc = 8; break; }
+
+    // call dlopen(lib, RTLD_NOW|RTLD_GLOBAL)
+    long h = S.call_with_stub(r_dlopen, remote_path, RTLD_NOW | RTLD_GLOBAL, 0, 0);
+    S.phase("dlopen %s", r.path);
+    if (h == -1) { LOGE("dlopen call failed"); rc = 9; break; }
+    LOGI("dlopen(%s) returned 0x%lx", r.path, (unsigned long)h);
+    if (!h) { LOGE("dlopen(%s) failed in target", r.path); rc = 9; break; }
+
+    if (!r.init) continue;
+    uintptr_t remote_sym = S.put_string(r.init);
+    if (!remote_sym) { rc = 8; break; }
+    long fn = S.call_with_stub(r_dlsym, (uintptr_t)h, remote_sym, 0, 0);
+    S.phase("dlsym %s", r.init);
+    if (fn == -1 || fn == 0) { LOGE("dlsym(%s) failed", r.init); rc = 10; break; }
+
+    long ret = S.call_with_stub((uintptr_t)fn);
+    S.phase("call %s", r.init);
+    if (ret == -1) { LOGE("call %s failed", r.init); rc = 11; break; }
+    LOGI("%s() returned 0x%lx", r.init, (unsigned long)ret);
   }
 
-  // call dlopen(lib, RTLD_NOW|RTLD_GLOBAL)
-  long h = S.call_with_stub(scratch, r_dlopen,
-                            remote_path,
-                            RTLD_NOW | RTLD_GLOBAL,
-                            0, 0);
-  if (h == -1) { LOGE("dlopen call failed"); return 9; }
+  if (!S.unmap_scratch(r_munmap) && rc == 0) rc = 12;
+  S.phase("munmap scratch");
+  S.detach();
 
-  LOGI("dlopen returned 0x%lx", (unsigned long)h);
-  return 0;
+  return S.window.budget_status(rc, budget_ms);
 }
@@ -0,0 +1,164 @@
+#include "elf_view.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "log.h"
+
+ElfView::~ElfView() {
+  reset();
+}
+
+void ElfView::reset() {
+  if (mapped && data) {
+    munmap((void*)data, size);
+  }
+  data = nullptr;
+  size = 0;
+  mapped = false;
+}
+
+bool ElfView::map_file(const char* path) {
+  reset();
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOGE("open %s failed", path);
+    return false;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    LOGE("mmap %s failed", path);
+    return false;
+  }
+  data = (const uint8_t*)p;
+  size = (size_t)st.st_size;
+  mapped = true;
+  return true;
+}
+
+const uint8_t* ElfView::at(uint64_t off, uint64_t len) const {
+  if (!data || off > size || len > size - off) {
+    return nullptr;
+  }
+  return data + off;
+}
+
+const Elf64_Ehdr* ElfView::as_ehdr() const {
+  auto* eh = (const Elf64_Ehdr*)at(0, sizeof(Elf64_Ehdr));
+  if (!eh) return nullptr;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0){
+    LOGE("ELF magic not found");
+    return nullptr;
+  }
+  if (eh->e_ident[EI_CLASS] != ELFCLASS64){
+    LOGE("not a 64-bit ELF");
+    return nullptr;
+  }
+  return eh;
+}
+
+const Elf64_Shdr* ElfView::shdr(size_t i) const {
+  const auto* eh = (const Elf64_Ehdr*)at(0, sizeof(Elf64_Ehdr));
+  if (!eh) return nullptr;
+  const auto shoff = eh->e_shoff;
+  const auto entsz = eh->e_shentsize;
+  if (shoff == 0 || entsz < sizeof(Elf64_Shdr)){
+    LOGE("no section headers");
+    return nullptr;
+  }
+  if (i >= eh->e_shnum) {
+    LOGE("section header %zu out of range", i);
+    return nullptr;
+  }
+  const auto* sh = (const Elf64_Shdr*)at(shoff + (uint64_t)i * entsz, sizeof(Elf64_Shdr));
+  if (!sh) {
+    LOGE("section header %zu out of range", i);
+  }
+  return sh;
+}
+
+const char* ElfView::shstr(uint32_t name_off) const {
+  const auto* eh = (const Elf64_Ehdr*)at(0, sizeof(Elf64_Ehdr));
+  if (!eh) return nullptr;
+  const auto* strsec = shdr(eh->e_shstrndx);
+  if (!strsec) {
+    LOGE("no .shstrtab");
+    return nullptr;
+  }
+  const char* s = (const char*)section_data(strsec);
+  if (!s || (uint64_t)name_off >= strsec->sh_size) {
+    LOGE("section name offset out of range");
+    return nullptr;
+  }
+  // must be NUL-terminated inside the section
+  if (!memchr(s + name_off, 0, strsec->sh_size - name_off)) {
+    LOGE("section name not terminated");
+    return nullptr;
+  }
+  return s + name_off;
+}
+
+const Elf64_Shdr* ElfView::find_section(const char* name) const {
+  const auto* eh = as_ehdr();
+  if (!eh) return nullptr;
+  for (uint16_t i = 0; i < eh->e_shnum; i++) {
+    const auto* sh = shdr(i);
+    if (!sh) {
+      continue;
+    }
+    const char* nm = shstr(sh->sh_name);
+    if (nm && strcmp(nm, name) == 0) {
+      return sh;
+    }
+  }
+  return nullptr;
+}
+
+const uint8_t* ElfView::section_data(const Elf64_Shdr* sh) const {
+  if (!sh || sh->sh_type == SHT_NOBITS) {
+    return nullptr;
+  }
+  return at(sh->sh_offset, sh->sh_size);
+}
+
+bool ElfView::build_id(const uint8_t** id, size_t* len) const {
+  const auto* eh = as_ehdr();
+  if (!eh) return false;
+  for (uint16_t i = 0; i < eh->e_shnum; i++) {
+    const auto* sh = shdr(i);
+    if (!sh || sh->sh_type != SHT_NOTE) {
+      continue;
+    }
+    const uint8_t* p = section_data(sh);
+    if (!p) {
+      continue;
+    }
+    // notes: Elf64_Nhdr, name and desc each padded to 4 bytes
+    uint64_t off = 0;
+    while (off + sizeof(Elf64_Nhdr) <= sh->sh_size) {
+      const auto* nh = (const Elf64_Nhdr*)(p + off);
+      uint64_t name_sz = ((uint64_t)nh->n_namesz + 3) & ~3ull;
+      uint64_t desc_sz = ((uint64_t)nh->n_descsz + 3) & ~3ull;
+      uint64_t desc_off = off + sizeof(Elf64_Nhdr) + name_sz;
+      if (desc_off + nh->n_descsz > sh->sh_size) {
+        break;
+      }
+      if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 &&
+          memcmp(p + off + sizeof(Elf64_Nhdr), "GNU", 4) == 0 && nh->n_descsz > 0) {
+        *id = p + desc_off;
+        *len = nh->n_descsz;
+        return true;
+      }
+      off = desc_off + desc_sz;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <elf.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only view over an ELF64 image, either borrowed (e.g. a decompressed
+// buffer) or backed by a private read-only mmap of a file. Every accessor is
+// bounds-checked against the image size and returns nullptr when out of range,
+// so only the pages that are actually inspected get faulted in.
+struct ElfView {
+  const uint8_t* data{nullptr};
+  size_t         size{0};
+  bool           mapped{false}; // data is owned and must be munmap()ed
+
+  ElfView() = default;
+  ElfView(const uint8_t* d, size_t n) : data(d), size(n) {}
+  ~ElfView();
+
+  ElfView(const ElfView&) = delete;
+  ElfView& operator=(const ElfView&) = delete;
+
+  // mmap path read-only. Any previous mapping is released first.
+  bool map_file(const char* path);
+  void reset();
+
+  // [off, off + len) inside the image, or nullptr.
+  const uint8_t* at(uint64_t off, uint64_t len) const;
+
+  const Elf64_Ehdr* as_ehdr() const;
+  const Elf64_Shdr* shdr(size_t i) const;
+  const char*       shstr(uint32_t name_off) const;
+
+  // First section with the given name, or nullptr.
+  const Elf64_Shdr* find_section(const char* name) const;
+  // Contents of a section (nullptr for SHT_NOBITS or out-of-range).
+  const uint8_t*    section_data(const Elf64_Shdr* sh) const;
+
+  // NT_GNU_BUILD_ID descriptor from any SHT_NOTE section.
+  bool build_id(const uint8_t** id, size_t* len) const;
+};
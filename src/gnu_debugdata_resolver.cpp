@@ -1,14 +1,13 @@
 #include <elf.h>
-#include <vector>
-#include <string>
+#include <algorithm>
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include <time.h>
 #include "log.h"
+#include "elf_view.h"
+#include "gnu_debugdata_resolver.h"
+#include "xz_blocks.h"
 
 extern "C" {
 // xz-embedded API headers
@@ -16,88 +15,107 @@ extern "C" {
 }
 
 
-static bool read_file(const char* path, std::vector<uint8_t>& out) {
-  int fd = open(path, O_RDONLY | O_CLOEXEC);
-  if (fd < 0) return false;
-  struct stat st{};
-  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
-    close(fd);
-    return false;
-  }
-  out.resize((size_t)st.st_size);
-  ssize_t n = read(fd, out.data(), out.size());
-  close(fd);
-  return n == (ssize_t)out.size();
+// per thread, so that host tools can resolve several binaries at once
+static thread_local GnuDebugStats g_stats;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-static const Elf64_Ehdr* as_ehdr(const std::vector<uint8_t>& b) {
-  if (b.size() < sizeof(Elf64_Ehdr)) return nullptr;
-  auto* eh = (const Elf64_Ehdr*)b.data();
-  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0){
-    LOGE("ELF magic not found");
-    return nullptr;
-  }
-  if (eh->e_ident[EI_CLASS] != ELFCLASS64){
-    LOGE("not a 64-bit ELF");
-    return nullptr;
+const GnuDebugStats& gnu_debugdata_last_stats() {
+  return g_stats;
+}
+
+const char* sym_tier_name(SymTier tier) {
+  switch (tier) {
+    case SYM_TIER_NONE:      return "none";
+    case SYM_TIER_CACHE:     return "cache";
+    case SYM_TIER_DYNSYM:    return "dynsym";
+    case SYM_TIER_SYMTAB:    return "symtab";
+    case SYM_TIER_DEBUGDATA: return "gnu_debugdata";
+    case SYM_TIER_SIGNATURE: return "signature";
+    case SYM_TIER_MANIFEST:  return "manifest";
   }
-  return eh;
+  return "?";
 }
 
-static const Elf64_Shdr* shdr(const std::vector<uint8_t>& b, const Elf64_Ehdr* eh, size_t i) {
-  const auto shoff = eh->e_shoff;
-  const auto entsz = eh->e_shentsize;
-  if (shoff == 0 || entsz < sizeof(Elf64_Shdr)){
-    LOGE("no section headers");
-    return nullptr;
+static const size_t XZ_CHUNK = 1 << 20; // multi-call output growth
+
+// Uncompressed size of a single-stream .xz buffer, taken from the Stream
+// Footer and Index. False if there is no usable index (or more than one
+// stream), in which case the caller has to decode without knowing the size.
+static bool xz_uncompressed_size(const uint8_t* in, size_t in_len, uint64_t* out) {
+  ArenaArray<XzBlock> blocks;
+  if (!xz_read_index(in, in_len, blocks)) {
+    return false;
   }
-  const uint8_t* base = b.data() + shoff + i * entsz;
-  if (base + sizeof(Elf64_Shdr) > b.data() + b.size()) {
-    LOGE("section header %zu out of range", i);
-    return nullptr;
+  *out = blocks.empty() ? 0 : blocks.back().out_offset + blocks.back().out_size;
+  return true;
+}
+
+static void dump_xz_input(const uint8_t* in, size_t in_len) {
+  LOGI("Input data (first 64 bytes or less):");
+  size_t dump_len = (in_len < 64) ? in_len : 64;
+  for (size_t i = 0; i < dump_len; i++) {
+    LOGI("%02x ", in[i]);
   }
-  return (const Elf64_Shdr*)base;
 }
 
-static const char* shstr(const std::vector<uint8_t>& b, const Elf64_Ehdr* eh, uint32_t name_off) {
-  const auto* shstr = shdr(b, eh, eh->e_shstrndx);
-  if (!shstr) {
-    LOGE("no .shstrtab");
-    return nullptr;
+// Single-call decode straight into an exactly-sized buffer: no dictionary
+// allocation and no reallocation of the output.
+static bool decompress_xz_single(const uint8_t* in, size_t in_len, size_t out_len,
+                                 ArenaArray<uint8_t>& out) {
+  struct xz_dec* s = xz_dec_init(XZ_SINGLE, 0);
+  if (!s){
+    return false;
   }
-  const char* s = (const char*)(b.data() + shstr->sh_offset);
-  if ((size_t)name_off >= shstr->sh_size) {
-    LOGE("section name offset out of range");
-    return nullptr;
+
+  out.clear();
+  if (!out.resize(out_len)) {
+    xz_dec_end(s);
+    return false;
   }
-  return s + name_off;
+  xz_buf b{};
+  b.in = in; b.in_pos = 0; b.in_size = in_len;
+  b.out = out.data(); b.out_pos = 0; b.out_size = out.size();
+
+  xz_ret ret = xz_dec_run(s, &b);
+  LOGV("xz_dec_run(single): ret=%d  in_pos=%zu/%zu  out_pos=%zu/%zu",
+       ret, b.in_pos, b.in_size, b.out_pos, b.out_size);
+  xz_dec_end(s);
+
+  if (ret != XZ_STREAM_END || b.out_pos != out_len) {
+    out.clear();
+    return false;
+  }
+  return true;
 }
 
-static bool decompress_xz(const uint8_t* in, size_t in_len, std::vector<uint8_t>& out) {
+// Multi-call decode for streams without a usable index; grows the output
+// XZ_CHUNK at a time. In an arena, once the output has been moved past the
+// dictionary it is the most recent allocation and grows in place.
+static bool decompress_xz_multi(const uint8_t* in, size_t in_len, ArenaArray<uint8_t>& out) {
   // Allocate a reasonable output buffer and grow if needed.
   out.clear();
   out.reserve(in_len * 6); // rough guess; will grow if necessary
 
-  static bool xz_inited = false;
-  if (!xz_inited) {
-    xz_crc32_init();
-    xz_crc64_init();
-    xz_inited = true;
-  }
-
   struct xz_dec* s = xz_dec_init(XZ_DYNALLOC, 1 << 26); // up to 64 MB dict
   if (!s){
     return false;
   }
 
   xz_buf b{};
-  std::vector<uint8_t> tmp(1 << 20); // 1MB chunk writer
   b.in = in; b.in_pos = 0; b.in_size = in_len;
 
   xz_ret ret = XZ_OK;
   do {
     size_t old_size = out.size();
-    out.resize(old_size + tmp.size());
+    if (!out.resize(old_size + XZ_CHUNK)) {
+      ret = XZ_MEM_ERROR;
+      break;
+    }
     b.out = out.data();
     b.out_pos = old_size;
     b.out_size = out.size();
@@ -105,62 +123,54 @@ static bool decompress_xz(const uint8_t* in, size_t in_len, std::vector<uint8_t>
     ret = xz_dec_run(s, &b);
     out.resize(b.out_pos); // shrink to written
 
-    if (ret == XZ_OK && b.out_pos == old_size) {
-      // Output full but decoder not finished: grow buffer and continue
-      out.reserve(out.size() + tmp.size());
-    }
     LOGV("xz_dec_run: ret=%d  in_pos=%zu/%zu  out_pos=%zu/%zu",
          ret, b.in_pos, b.in_size, b.out_pos, b.out_size);
   } while (ret == XZ_OK);
 
-  if(ret != XZ_OK) {
-    LOGI("Input data (first 64 bytes or less):");
-    size_t dump_len = (in_len < 64) ? in_len : 64;
-    for (size_t i = 0; i < dump_len; i++) {
-      LOGI("%02x ", in[i]);
-    }
+  if (ret != XZ_STREAM_END) {
+    dump_xz_input(in, in_len);
   }
 
   xz_dec_end(s);
   return ret == XZ_STREAM_END;
 }
 
-// ---------- public API ----------
-struct GnuDebugSym {
-  std::string name;
-  uint64_t    value;   // st_value (VMA)
-  uint64_t    size;    // st_size
-  unsigned    type;    // STT_*
-};
+static bool decompress_xz(const uint8_t* in, size_t in_len, ArenaArray<uint8_t>& out) {
+  xz_init_once();
 
-bool load_gnu_debugdata(const char* exe_path,
-                               std::vector<GnuDebugSym>& out_syms) {
-  out_syms.clear();
+  uint64_t out_len = 0;
+  if (xz_uncompressed_size(in, in_len, &out_len)) {
+    LOGV("xz index: uncompressed size=0x%lx", (unsigned long)out_len);
+    if (decompress_xz_single(in, in_len, (size_t)out_len, out)) {
+      return true;
+    }
+    LOGI("single-call XZ decode failed, retrying in multi-call mode");
+  } else {
+    LOGV("no usable xz index, using multi-call decode");
+  }
+  return decompress_xz_multi(in, in_len, out);
+}
 
-  // 1) Read the main ELF (surfaceflinger file on disk)
-  std::vector<uint8_t> main_bin;
-  if (!read_file(exe_path, main_bin)) return false;
-  const auto* eh = as_ehdr(main_bin);
-  if (!eh) {
+// Map exe_path and locate its .gnu_debugdata. The main binary is only
+// mmap()ed, so just the section headers, .shstrtab and the .gnu_debugdata
+// pages actually decoded are ever touched.
+static bool map_debugdata(const char* exe_path, ElfView& main_bin,
+                          const uint8_t** cdat, size_t* clen) {
+  g_stats = GnuDebugStats{};
+  uint64_t t0 = now_ns();
+
+  // 1) Map the main ELF (surfaceflinger file on disk)
+  if (!main_bin.map_file(exe_path)) return false;
+  if (!main_bin.as_ehdr()) {
     return false;
   }
 
-  LOGV("main ELF read: %s  size=0x%lx", exe_path, (unsigned long)main_bin.size());
+  LOGV("main ELF mapped: %s  size=0x%lx", exe_path, (unsigned long)main_bin.size);
 
   // 2) Locate .gnu_debugdata
-  const Elf64_Shdr* sec = nullptr;
-  for (uint16_t i = 0; i < eh->e_shnum; i++) {
-    const auto* sh = shdr(main_bin, eh, i);
-    if (!sh) {
-      continue;
-    }
-    const char* nm = shstr(main_bin, eh, sh->sh_name);
-    if (nm && strcmp(nm, ".gnu_debugdata") == 0) { 
-      sec = sh;
-      break;
-     }
-  }
-  if (!sec || sec->sh_size == 0){
+  const Elf64_Shdr* sec = main_bin.find_section(".gnu_debugdata");
+  *cdat = main_bin.section_data(sec);
+  if (!sec || sec->sh_size == 0 || !*cdat){
     LOGE("Failed to find .gnu_debugdata");
     return false;
   }
@@ -168,30 +178,50 @@ bool load_gnu_debugdata(const char* exe_path,
   LOGV(".gnu_debugdata found: offset=0x%lx size=0x%lx",
        (unsigned long)sec->sh_offset, (unsigned long)sec->sh_size);
 
-  const uint8_t* cdat = main_bin.data() + sec->sh_offset;
-  size_t clen = (size_t)sec->sh_size;
+  *clen = (size_t)sec->sh_size;
+  g_stats.map_ns = now_ns() - t0;
+  g_stats.compressed_bytes = *clen;
+  return true;
+}
+
+// Read exe_path and decompress its .gnu_debugdata into dbg_elf (mini ELF).
+static bool load_debug_elf(const char* exe_path, ArenaArray<uint8_t>& dbg_elf) {
+  ElfView main_bin;
+  const uint8_t* cdat;
+  size_t clen;
+  if (!map_debugdata(exe_path, main_bin, &cdat, &clen)) {
+    return false;
+  }
 
   // 3) Decompress (XZ/LZMA2) -> mini ELF with .symtab
-  std::vector<uint8_t> dbg_elf;
+  uint64_t t1 = now_ns();
   if (!decompress_xz(cdat, clen, dbg_elf)){
     return false;
   }
+  g_stats.decompress_ns = now_ns() - t1;
+  g_stats.decompressed_bytes = dbg_elf.size();
+  g_stats.decoded_bytes = dbg_elf.size();
+  g_stats.buffer_bytes = dbg_elf.size();
 
   LOGV(".gnu_debugdata decompressed: size=0x%lx", (unsigned long)dbg_elf.size());
+  return true;
+}
 
-  const auto* deh = as_ehdr(dbg_elf);
+// Find .symtab and its .strtab inside the decompressed mini ELF.
+static bool find_symtab(const ElfView& dbg, SymtabView& out) {
+  uint64_t t0 = now_ns();
+  const auto* deh = dbg.as_ehdr();
   if (!deh){
     return false;
   }
 
-  // 4) Find .symtab and its .strtab
   const Elf64_Shdr *symtab = nullptr, *strtab = nullptr;
   for (uint16_t i = 0; i < deh->e_shnum; i++) {
-    const auto* sh = shdr(dbg_elf, deh, i);
+    const auto* sh = dbg.shdr(i);
     if (!sh) {
       continue;
     }
-    const char* nm = shstr(dbg_elf, deh, sh->sh_name);
+    const char* nm = dbg.shstr(sh->sh_name);
     if (!nm) {
       continue;
     }
@@ -202,7 +232,9 @@ bool load_gnu_debugdata(const char* exe_path,
       strtab = sh;
     }
   }
-  if (!symtab || !strtab){
+  const uint8_t* symdat = dbg.section_data(symtab);
+  const uint8_t* strdat = dbg.section_data(strtab);
+  if (!symdat || !strdat){
     LOGE(".symtab or .strtab not found in .gnu_debugdata");
     LOGE("symtab=%p strtab=%p", (void*)symtab, (void*)strtab);
     return false;
@@ -212,41 +244,355 @@ bool load_gnu_debugdata(const char* exe_path,
        (unsigned long)symtab->sh_offset, (unsigned long)symtab->sh_size,
        (unsigned long)strtab->sh_offset, (unsigned long)strtab->sh_size);
 
-  const char* str = (const char*)(dbg_elf.data() + strtab->sh_offset);
-  const auto* sym = (const Elf64_Sym*)(dbg_elf.data() + symtab->sh_offset);
-  size_t count    = symtab->sh_size / sizeof(Elf64_Sym);
+  out.sym      = (const Elf64_Sym*)symdat;
+  out.count    = symtab->sh_size / sizeof(Elf64_Sym);
+  out.str      = (const char*)strdat;
+  out.str_size = strtab->sh_size;
 
-  LOGV("symbol count: %zu", count);
+  g_stats.parse_ns = now_ns() - t0;
+  g_stats.symbols = out.count;
+  LOGV("symbol count: %zu", out.count);
+  return true;
+}
 
-  // 5) Collect defined function symbols
-  for (size_t i = 0; i < count; i++) {
-    if (sym[i].st_name == 0) {
-      continue;
+// Above this many names a batch lookup indexes .symtab instead of scanning it.
+static const size_t SCAN_MAX_LOOKUPS = 8;
+
+bool GnuDebugSymtab::load(const char* exe_path) {
+  dbg_elf.clear();
+  if (!load_debug_elf(exe_path, dbg_elf)) {
+    return false;
+  }
+  ElfView dbg(dbg_elf.data(), dbg_elf.size());
+  if (!find_symtab(dbg, symtab)) {
+    return false;
+  }
+  uint64_t t0 = now_ns();
+  bool ok = index.build(symtab);
+  g_stats.lookup_ns = now_ns() - t0;
+  return ok;
+}
+
+uint64_t GnuDebugSymtab::find(const char* mangled_name) const {
+  const Elf64_Sym* s = index.find(mangled_name);
+  return s ? s->st_value : 0;
+}
+
+// Streaming lookup of a few names (at most SCAN_MAX_LOOKUPS).
+//
+// The mini ELF keeps its section headers at the end, so they are read
+// first, through the xz Index, then .strtab is scanned for the offsets of
+// the names and .symtab for symbols with those offsets. Each scan stops
+// decoding as soon as every name has been seen, and only one xz Block is
+// held at a time. strtab sharing (a name stored as the tail of a longer
+// one) is fine, the offset still points at the name.
+
+static const size_t NAME_TAIL = 512; // longest name the .strtab scan handles
+
+// Each pass decodes whole Blocks, so with few large Blocks streaming
+// re-decodes most of the data and saves no memory.
+static const uint64_t STREAM_MAX_BLOCK = 1 << 20;
+
+struct NameScan {
+  GnuDebugLookup* lookups;
+  size_t          count;
+  uint64_t        base;                      // .strtab offset in the mini ELF
+  size_t          len[SCAN_MAX_LOOKUPS];
+  uint32_t        name_off[SCAN_MAX_LOOKUPS]; // 0 = not seen yet
+  size_t          remaining;
+  uint8_t         tail[NAME_TAIL];            // end of the previous window
+  size_t          tail_len;
+};
+
+// Does the name of length l end right before data[p]? The first bytes may
+// still be in the tail of the previous window.
+static bool name_ends_at(const NameScan& ns, const uint8_t* data, size_t p,
+                         const char* name, size_t l) {
+  if (p >= l) {
+    return memcmp(data + p - l, name, l) == 0;
+  }
+  const size_t head = l - p;
+  return head <= ns.tail_len &&
+         memcmp(ns.tail + ns.tail_len - head, name, head) == 0 &&
+         memcmp(data, name + head, p) == 0;
+}
+
+static bool name_sink(void* ctx, uint64_t offset, const uint8_t* data, size_t len) {
+  NameScan& ns = *(NameScan*)ctx;
+  const uint8_t* nul = (const uint8_t*)memchr(data, 0, len);
+  while (nul) {
+    const size_t p = (size_t)(nul - data);
+    const uint64_t rel = offset + p - ns.base;
+    for (size_t j = 0; j < ns.count; j++) {
+      const size_t l = ns.len[j];
+      if (ns.name_off[j] || l >= rel ||
+          !name_ends_at(ns, data, p, ns.lookups[j].mangled_name, l)) {
+        continue;
+      }
+      ns.name_off[j] = (uint32_t)(rel - l);
+      ns.remaining--;
     }
-    const char* nm = str + sym[i].st_name;
-    if (!nm || !*nm) {
-      continue;
+    if (ns.remaining == 0) {
+      return false;
     }
+    nul = (const uint8_t*)memchr(nul + 1, 0, len - p - 1);
+  }
+
+  if (len >= NAME_TAIL) {
+    memcpy(ns.tail, data + len - NAME_TAIL, NAME_TAIL);
+    ns.tail_len = NAME_TAIL;
+  } else {
+    const size_t keep = ns.tail_len + len > NAME_TAIL ? NAME_TAIL - len : ns.tail_len;
+    memmove(ns.tail, ns.tail + ns.tail_len - keep, keep);
+    memcpy(ns.tail + keep, data, len);
+    ns.tail_len = keep + len;
+  }
+  return true;
+}
+
+struct SymScan {
+  GnuDebugLookup* lookups;
+  size_t          count;
+  const uint32_t* name_off;
+  uintptr_t       runtime_base;
+  size_t          remaining;
+  uint8_t         part[sizeof(Elf64_Sym)]; // symbol split across windows
+  size_t          part_len;
+};
 
-    unsigned type = ELF64_ST_TYPE(sym[i].st_info);
-    if (type != STT_FUNC) {
+static void check_sym(SymScan& ss, const Elf64_Sym& s) {
+  if (s.st_name == 0 || ELF64_ST_TYPE(s.st_info) != STT_FUNC || s.st_shndx == SHN_UNDEF) {
+    return;
+  }
+  for (size_t j = 0; j < ss.count; j++) {
+    if (ss.lookups[j].addr || ss.name_off[j] != s.st_name) {
       continue;
     }
-    if (sym[i].st_shndx == SHN_UNDEF) {
-      continue;
+    // PIE: st_value is relative to load base
+    ss.lookups[j].addr = ss.runtime_base + (uintptr_t)s.st_value;
+    ss.lookups[j].tier = SYM_TIER_DEBUGDATA;
+    ss.remaining--;
+    LOGV("  %s  value=0x%lx (streamed)", ss.lookups[j].mangled_name, (unsigned long)s.st_value);
+    break;
+  }
+}
+
+static bool sym_sink(void* ctx, uint64_t, const uint8_t* data, size_t len) {
+  SymScan& ss = *(SymScan*)ctx;
+  Elf64_Sym s;
+  if (ss.part_len) {
+    const size_t n = std::min(sizeof(s) - ss.part_len, len);
+    memcpy(ss.part + ss.part_len, data, n);
+    ss.part_len += n;
+    data += n;
+    len -= n;
+    if (ss.part_len < sizeof(s)) {
+      return true;
+    }
+    memcpy(&s, ss.part, sizeof(s));
+    ss.part_len = 0;
+    check_sym(ss, s);
+  }
+  for (; len >= sizeof(s) && ss.remaining > 0; data += sizeof(s), len -= sizeof(s)) {
+    memcpy(&s, data, sizeof(s));
+    check_sym(ss, s);
+  }
+  memcpy(ss.part, data, len < sizeof(s) ? len : 0);
+  ss.part_len = len < sizeof(s) ? len : 0;
+  return ss.remaining > 0;
+}
+
+// Returns false if the stream can't be used this way (no xz Index, an
+// unexpected layout, or a name that is in .strtab but matched no symbol),
+// leaving the lookups unresolved for the full decode.
+static bool stream_lookup(const uint8_t* cdat, size_t clen, GnuDebugLookup* lookups,
+                          size_t count, uintptr_t runtime_base, size_t* found) {
+  *found = 0;
+  if (count > SCAN_MAX_LOOKUPS) {
+    return false;
+  }
+  XzBlockReader xz;
+  if (!xz.init(cdat, clen)) {
+    LOGV("no usable xz index, cannot stream .gnu_debugdata");
+    return false;
+  }
+  if (xz.largest_block() > STREAM_MAX_BLOCK) {
+    LOGV("xz blocks too large to stream .gnu_debugdata");
+    return false;
+  }
+
+  // section headers (at the end of the mini ELF)
+  uint64_t t0 = now_ns();
+  Elf64_Ehdr eh;
+  if (xz.size() < sizeof(eh) || !xz.copy(0, &eh, sizeof(eh)) ||
+      memcmp(eh.e_ident, ELFMAG, SELFMAG) != 0 || eh.e_ident[EI_CLASS] != ELFCLASS64 ||
+      eh.e_shentsize != sizeof(Elf64_Shdr) || eh.e_shnum == 0 ||
+      eh.e_shoff > xz.size() || (xz.size() - eh.e_shoff) / sizeof(Elf64_Shdr) < eh.e_shnum) {
+    return false;
+  }
+  ArenaArray<Elf64_Shdr> shdrs;
+  if (!shdrs.resize(eh.e_shnum) ||
+      !xz.copy(eh.e_shoff, shdrs.data(), shdrs.size() * sizeof(Elf64_Shdr))) {
+    return false;
+  }
+  const Elf64_Shdr *symtab = nullptr, *strtab = nullptr;
+  for (const Elf64_Shdr& sh : shdrs) {
+    if (sh.sh_type == SHT_SYMTAB && sh.sh_entsize == sizeof(Elf64_Sym) &&
+        sh.sh_link < shdrs.size() && shdrs[sh.sh_link].sh_type == SHT_STRTAB) {
+      symtab = &sh;
+      strtab = &shdrs[sh.sh_link];
+      break;
+    }
+  }
+  if (!symtab || symtab->sh_offset > xz.size() || symtab->sh_size > xz.size() - symtab->sh_offset ||
+      strtab->sh_offset > xz.size() || strtab->sh_size > xz.size() - strtab->sh_offset ||
+      strtab->sh_size >= UINT32_MAX) {
+    LOGE(".symtab or .strtab not found in .gnu_debugdata");
+    return false;
+  }
+  g_stats.symbols = symtab->sh_size / sizeof(Elf64_Sym);
+  uint64_t t1 = now_ns();
+  g_stats.parse_ns = (t1 - t0) - xz.decode_ns;
+  const uint64_t parse_decode_ns = xz.decode_ns;
+
+  // 1) .strtab: where each name is
+  NameScan ns{};
+  ns.lookups = lookups;
+  ns.count = count;
+  ns.base = strtab->sh_offset;
+  ns.remaining = count;
+  for (size_t j = 0; j < count; j++) {
+    ns.len[j] = strlen(lookups[j].mangled_name);
+    if (ns.len[j] == 0 || ns.len[j] > NAME_TAIL) {
+      return false;
+    }
+  }
+  if (!xz.read(strtab->sh_offset, strtab->sh_offset + strtab->sh_size, name_sink, &ns)) {
+    return false;
+  }
+
+  // 2) .symtab: the functions with those names
+  SymScan ss{};
+  ss.lookups = lookups;
+  ss.count = count;
+  ss.name_off = ns.name_off;
+  ss.runtime_base = runtime_base;
+  ss.remaining = count - ns.remaining;
+  if (ss.remaining > 0 &&
+      !xz.read(symtab->sh_offset, symtab->sh_offset + symtab->sh_size, sym_sink, &ss)) {
+    return false;
+  }
+
+  g_stats.decompress_ns = xz.decode_ns;
+  g_stats.lookup_ns = (now_ns() - t1) - (xz.decode_ns - parse_decode_ns);
+  g_stats.decompressed_bytes = xz.size();
+  g_stats.decoded_bytes = xz.decoded_bytes;
+  g_stats.buffer_bytes = XzBlockReader::WINDOW + xz.max_block +
+                         shdrs.size() * sizeof(Elf64_Shdr);
+  g_stats.streamed = true;
+
+  *found = count - ns.remaining - ss.remaining;
+  if (ss.remaining > 0) {
+    // in .strtab under another offset too, or not a function
+    for (size_t j = 0; j < count; j++) {
+      lookups[j].addr = 0;
+      lookups[j].tier = SYM_TIER_NONE;
     }
+    *found = 0;
+    return false;
+  }
+  LOGV("streamed .gnu_debugdata: decoded %llu of %llu bytes",
+       (unsigned long long)xz.decoded_bytes, (unsigned long long)xz.size());
+  return true;
+}
 
-    GnuDebugSym s;
-    s.name  = nm;
-    s.value = sym[i].st_value; // VMA
-    s.size  = sym[i].st_size;
-    s.type  = type;
-    out_syms.push_back(std::move(s));
+size_t resolve_addrs_from_gnu_debugdata(const char* exe_path,
+                                        GnuDebugLookup* lookups, size_t count,
+                                        uintptr_t runtime_base, GnuDebugMode mode) {
+  for (size_t j = 0; j < count; j++) {
+    lookups[j].addr = 0;
+    lookups[j].tier = SYM_TIER_NONE;
+  }
+  if (count == 0) {
+    return 0;
+  }
 
-    LOGV("  [%04zu] %s  type=%u  value=0x%lx size=0x%lx",
-         i, nm, type, (unsigned long)sym[i].st_value, (unsigned long)sym[i].st_size);
+  if (mode == GNU_DEBUG_STREAM || (mode == GNU_DEBUG_AUTO && count <= SCAN_MAX_LOOKUPS)) {
+    ElfView main_bin;
+    const uint8_t* cdat;
+    size_t clen, found;
+    if (!map_debugdata(exe_path, main_bin, &cdat, &clen)) {
+      return 0;
+    }
+    if (stream_lookup(cdat, clen, lookups, count, runtime_base, &found)) {
+      return found;
+    }
+    if (mode == GNU_DEBUG_STREAM) {
+      // a failed read may have set some of them already
+      for (size_t j = 0; j < count; j++) {
+        lookups[j].addr = 0;
+        lookups[j].tier = SYM_TIER_NONE;
+      }
+      LOGI("cannot stream .gnu_debugdata for %zu names, not decompressing it", count);
+      return 0;
+    }
+    LOGI("cannot stream .gnu_debugdata, decompressing all of it");
+  }
+
+  ArenaArray<uint8_t> dbg_elf;
+  if (!load_debug_elf(exe_path, dbg_elf)) {
+    return 0;
+  }
+
+  ElfView dbg(dbg_elf.data(), dbg_elf.size());
+  SymtabView st;
+  if (!find_symtab(dbg, st)) {
+    return 0;
   }
-  return !out_syms.empty();
+  const Elf64_Sym* sym = st.sym;
+  uint64_t t0 = now_ns();
+
+  // Larger batches: build the hash index once, then O(1) per name.
+  if (count > SCAN_MAX_LOOKUPS) {
+    SymIndex index;
+    if (!index.build(st)) {
+      return 0;
+    }
+    size_t found = 0;
+    for (size_t j = 0; j < count; j++) {
+      const Elf64_Sym* s = index.find(lookups[j].mangled_name);
+      if (s) {
+        lookups[j].addr = runtime_base + (uintptr_t)s->st_value;
+        lookups[j].tier = SYM_TIER_DEBUGDATA;
+        found++;
+      }
+    }
+    g_stats.lookup_ns = now_ns() - t0;
+    return found;
+  }
+
+  // A handful of names (the hooks): single pass over .symtab, stopping as
+  // soon as every lookup has an address.
+  size_t remaining = count;
+  for (size_t i = 0; i < st.count && remaining > 0; i++) {
+    const char* nm = st.func_name(i);
+    if (!nm) {
+      continue;
+    }
+    for (size_t j = 0; j < count; j++) {
+      if (lookups[j].addr || strcmp(nm, lookups[j].mangled_name) != 0) {
+        continue;
+      }
+      // PIE: st_value is relative to load base
+      lookups[j].addr = runtime_base + (uintptr_t)sym[i].st_value;
+      lookups[j].tier = SYM_TIER_DEBUGDATA;
+      remaining--;
+      LOGV("  [%04zu] %s  value=0x%lx", i, nm, (unsigned long)sym[i].st_value);
+      break;
+    }
+  }
+  g_stats.lookup_ns = now_ns() - t0;
+  return count - remaining;
 }
 
 // Find address of a mangled name. Return 0 on failure.
@@ -254,15 +600,7 @@ bool load_gnu_debugdata(const char* exe_path,
 uintptr_t resolve_addr_from_gnu_debugdata(const char* exe_path,
                                                  const char* mangled_name,
                                                  uintptr_t runtime_base) {
-  std::vector<GnuDebugSym> syms;
-  if (!load_gnu_debugdata(exe_path, syms)) {
-    return 0;
-  }
-  for (auto& s : syms) {
-    if (s.name == mangled_name) {
-      // PIE: st_value is relative to load base
-      return runtime_base + (uintptr_t)s.value;
-    }
-  }
-  return 0;
+  GnuDebugLookup lookup{mangled_name, 0, SYM_TIER_NONE};
+  resolve_addrs_from_gnu_debugdata(exe_path, &lookup, 1, runtime_base);
+  return lookup.addr;
 }
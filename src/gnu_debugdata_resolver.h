@@ -1,6 +1,93 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
+#include "arena.h"
+#include "sym_index.h"
+
+// Where a lookup was answered (see sym_resolver.h). The values are written
+// to the handoff file, which dlopen64 and the library may read across
+// builds: new tiers go at the end.
+enum SymTier : uint8_t {
+  SYM_TIER_NONE,      // not found
+  SYM_TIER_CACHE,     // offset cache
+  SYM_TIER_DYNSYM,    // .gnu.hash / .dynsym of the binary
+  SYM_TIER_SYMTAB,    // uncompressed .symtab of the binary
+  SYM_TIER_DEBUGDATA, // .symtab inside the XZ .gnu_debugdata
+  SYM_TIER_SIGNATURE, // byte pattern in the code (sf_signatures.h)
+  SYM_TIER_MANIFEST,  // offset manifest of known builds (offset_manifest.h)
+};
+
+// Highest SymTier, for checking values read from files (handoff.cpp).
+static const SymTier SYM_TIER_LAST = SYM_TIER_MANIFEST;
+
+const char* sym_tier_name(SymTier tier);
+
+// One entry of a batch lookup: mangled_name is the input, addr is set to the
+// runtime address (runtime_base + st_value) or 0 if the symbol was not found,
+// and tier to where it was found.
+struct GnuDebugLookup {
+  const char* mangled_name;
+  uintptr_t   addr;
+  SymTier     tier;
+};
+
+// How resolve_addrs_from_gnu_debugdata() gets at the mini ELF.
+enum GnuDebugMode : uint8_t {
+  GNU_DEBUG_AUTO,   // stream a handful of names, decompress it all otherwise
+  GNU_DEBUG_FULL,   // always decompress it all, then look up
+  GNU_DEBUG_STREAM, // stream only: never more than the window plus one Block
+};
+// GNU_DEBUG_STREAM is for callers that would rather fail than hold the whole
+// mini ELF: it resolves nothing for more than 8 names, without an xz Index,
+// or with Blocks over 1 MiB, where GNU_DEBUG_AUTO decompresses it all.
+
+// Resolve every lookup with a single read + decompress + scan of exe_path.
+// For up to 8 names the mini ELF is streamed through a small window instead
+// of decompressed whole: decoding stops once all names have been found, and
+// peak memory is the window plus one xz Block rather than the full
+// uncompressed size. That needs the xz Index (every Android build writes
+// one); without it, or for more names, the whole mini ELF is decompressed.
+// Returns the number of lookups that were resolved.
+size_t resolve_addrs_from_gnu_debugdata(const char* exe_path,
+                                        GnuDebugLookup* lookups,
+                                        size_t count,
+                                        uintptr_t runtime_base,
+                                        GnuDebugMode mode = GNU_DEBUG_AUTO);
+
+// Wall time of each phase of this thread's most recent resolution (or
+// GnuDebugSymtab::load), for logging and the host benchmark. When streaming,
+// decompress_ns is the time spent in the decoder and parse_ns / lookup_ns
+// the rest of their phase.
+struct GnuDebugStats {
+  uint64_t map_ns;        // mmap + locate .gnu_debugdata
+  uint64_t decompress_ns; // XZ decode
+  uint64_t parse_ns;      // find .symtab / .strtab in the mini ELF
+  uint64_t lookup_ns;     // scan or index build + lookups
+  size_t   compressed_bytes;
+  size_t   decompressed_bytes; // size of the mini ELF
+  size_t   decoded_bytes;      // what the decoder produced (less when streaming)
+  size_t   buffer_bytes;       // largest decode buffers held at once
+  size_t   symbols;
+  bool     streamed;           // streaming lookup, the phases overlap
+};
+
+const GnuDebugStats& gnu_debugdata_last_stats();
+
 uintptr_t resolve_addr_from_gnu_debugdata(const char* exe_path,
                                           const char* mangled_name,
                                           uintptr_t runtime_base);
+
+// Decompressed .gnu_debugdata of a binary plus a hash index over its function
+// symbols, for callers that look up many names in the same binary. Its
+// memory comes from arena_alloc(): load and destroy it inside the same
+// ArenaScope, or outside of any.
+struct GnuDebugSymtab {
+  ArenaArray<uint8_t> dbg_elf; // decompressed mini ELF
+  SymtabView          symtab;  // points into dbg_elf
+  SymIndex            index;
+
+  bool load(const char* exe_path);
+  // st_value of a defined function, or 0 if it is not present.
+  uint64_t find(const char* mangled_name) const;
+};
@@ -0,0 +1,153 @@
+#include "handoff.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "log.h"
+
+// File layout (native endian, written and read on the same device):
+//   HandoffHeader
+//   count x { uint64_t offset; uint8_t tier; uint8_t pad; uint16_t name_len;
+//             char name[name_len]; }
+// offset is addr - base, or HANDOFF_ABSENT if the symbol was not found.
+
+static const uint32_t HANDOFF_MAGIC   = 0x4f484653; // "SFHO"
+static const uint32_t HANDOFF_VERSION = 1;
+static const uint64_t HANDOFF_ABSENT  = ~0ull;
+static const size_t   HANDOFF_MAX     = 4096;
+
+struct HandoffHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t  pid;          // process the addresses are for
+  uint32_t count;
+  uint64_t base;         // surfaceflinger load base seen by the injector
+  uint32_t payload_size; // bytes after the header
+  uint32_t checksum;     // FNV-1a over the payload
+};
+
+static uint32_t fnv1a(const uint8_t* p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+bool handoff_write(const char* path, pid_t pid, uintptr_t runtime_base,
+                   const GnuDebugLookup* lookups, size_t count) {
+  uint8_t buf[HANDOFF_MAX];
+  size_t pos = sizeof(HandoffHeader);
+
+  for (size_t j = 0; j < count; j++) {
+    size_t len = strlen(lookups[j].mangled_name);
+    if (len > 0xffff || pos + 12 + len > sizeof buf) {
+      LOGE("handoff: too many names");
+      return false;
+    }
+    uint64_t off = lookups[j].addr ? (uint64_t)(lookups[j].addr - runtime_base) : HANDOFF_ABSENT;
+    uint8_t tier_pad[2] = { (uint8_t)lookups[j].tier, 0 };
+    uint16_t len16 = (uint16_t)len;
+    memcpy(buf + pos, &off, sizeof off);
+    memcpy(buf + pos + 8, tier_pad, sizeof tier_pad);
+    memcpy(buf + pos + 10, &len16, sizeof len16);
+    memcpy(buf + pos + 12, lookups[j].mangled_name, len);
+    pos += 12 + len;
+  }
+
+  HandoffHeader hdr{};
+  hdr.magic = HANDOFF_MAGIC;
+  hdr.version = HANDOFF_VERSION;
+  hdr.pid = (int32_t)pid;
+  hdr.count = (uint32_t)count;
+  hdr.base = (uint64_t)runtime_base;
+  hdr.payload_size = (uint32_t)(pos - sizeof hdr);
+  hdr.checksum = fnv1a(buf + sizeof hdr, hdr.payload_size);
+  memcpy(buf, &hdr, sizeof hdr);
+
+  // temp file + rename, so the library never sees a partial handoff
+  char tmp[512];
+  snprintf(tmp, sizeof tmp, "%s.%d", path, (int)getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOGE("handoff: cannot create %s", tmp);
+    return false;
+  }
+  bool ok = write(fd, buf, pos) == (ssize_t)pos;
+  close(fd);
+  if (!ok || rename(tmp, path) != 0) {
+    LOGE("handoff: failed to write %s", path);
+    unlink(tmp);
+    return false;
+  }
+  return true;
+}
+
+bool handoff_read(const char* path, pid_t pid, uintptr_t runtime_base,
+                  GnuDebugLookup* lookups, size_t count) {
+  uint8_t buf[HANDOFF_MAX];
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t n = read(fd, buf, sizeof buf);
+  close(fd);
+  if (n < (ssize_t)sizeof(HandoffHeader)) {
+    return false;
+  }
+
+  HandoffHeader hdr;
+  memcpy(&hdr, buf, sizeof hdr);
+  if (hdr.magic != HANDOFF_MAGIC || hdr.version != HANDOFF_VERSION ||
+      hdr.payload_size != (size_t)n - sizeof hdr) {
+    LOGI("handoff %s invalid, ignoring", path);
+    return false;
+  }
+  const uint8_t* payload = buf + sizeof hdr;
+  if (fnv1a(payload, hdr.payload_size) != hdr.checksum) {
+    LOGI("handoff %s checksum mismatch, ignoring", path);
+    return false;
+  }
+  if (hdr.pid != (int32_t)pid || hdr.base != (uint64_t)runtime_base) {
+    LOGI("handoff %s is for another process, ignoring", path);
+    return false;
+  }
+
+  for (size_t j = 0; j < count; j++) {
+    lookups[j].addr = 0;
+    lookups[j].tier = SYM_TIER_NONE;
+  }
+
+  size_t found = 0;
+  const uint8_t* p = payload;
+  const uint8_t* end = payload + hdr.payload_size;
+  for (uint32_t i = 0; i < hdr.count; i++) {
+    uint64_t off;
+    uint16_t len;
+    if (end - p < 12) {
+      return false;
+    }
+    memcpy(&off, p, sizeof off);
+    uint8_t tier = p[8];
+    memcpy(&len, p + 10, sizeof len);
+    p += 12;
+    if (end - p < (ptrdiff_t)len) {
+      return false;
+    }
+    for (size_t j = 0; j < count; j++) {
+      const char* nm = lookups[j].mangled_name;
+      if (strlen(nm) != len || memcmp(nm, p, len) != 0) {
+        continue;
+      }
+      if (off != HANDOFF_ABSENT) {
+        lookups[j].addr = runtime_base + (uintptr_t)off;
+        lookups[j].tier = tier <= SYM_TIER_LAST ? (SymTier)tier : SYM_TIER_NONE;
+      }
+      found++;
+      break;
+    }
+    p += len;
+  }
+  return found == count;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "gnu_debugdata_resolver.h"
+
+// Hook addresses resolved by the injector (dlopen64) before it stops
+// surfaceflinger, passed to the library's constructor through a small
+// file. With a valid handoff the constructor skips symbol resolution
+// entirely; otherwise it resolves in-process as before.
+//
+// A handoff is only accepted by the process it was written for, with
+// surfaceflinger loaded at the same base, so a stale file is ignored.
+#define SFROTATE_HANDOFF "/data/local/tmp/sfrotate.handoff"
+
+// SFROTATE_HANDOFF, or $SFROTATE_HANDOFF (the e2e harness's own file)
+static inline const char* sf_handoff_path() {
+  const char* p = getenv("SFROTATE_HANDOFF");
+  return p && *p ? p : SFROTATE_HANDOFF;
+}
+
+// Write offsets (addr - runtime_base) of the lookups for process pid.
+bool handoff_write(const char* path, pid_t pid, uintptr_t runtime_base,
+                   const GnuDebugLookup* lookups, size_t count);
+
+// Fill every lookup from the handoff. False if it is missing, corrupt, for
+// another process or base, or lacks any of the names.
+bool handoff_read(const char* path, pid_t pid, uintptr_t runtime_base,
+                  GnuDebugLookup* lookups, size_t count);
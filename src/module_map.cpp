@@ -0,0 +1,261 @@
+#include "module_map.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/auxv.h>
+#include <unistd.h>
+#include <algorithm>
+#include "log.h"
+
+bool module_path_matches(const char* path, size_t path_len, const char* needle,
+                         size_t needle_len) {
+  if (needle_len == 0 || path_len < needle_len ||
+      memcmp(path + path_len - needle_len, needle, needle_len) != 0) {
+    return false;
+  }
+  return path_len == needle_len || needle[0] == '/' || path[path_len - needle_len - 1] == '/';
+}
+
+static uintptr_t page_down(uintptr_t a) {
+  return a & ~(uintptr_t)(getpagesize() - 1);
+}
+
+static uintptr_t page_up(uintptr_t a) {
+  return page_down(a + getpagesize() - 1);
+}
+
+struct SelfQuery {
+  const char* needle;
+  size_t      needle_len;
+  ModuleInfo* out;
+  bool        found;
+};
+
+static int self_cb(struct dl_phdr_info* info, size_t, void* data) {
+  SelfQuery& q = *(SelfQuery*)data;
+  const char* name = info->dlpi_name;
+  if ((!name || !*name) && info->dlpi_phdr == (const ElfW(Phdr)*)getauxval(AT_PHDR)) {
+    // glibc leaves the main executable unnamed
+    name = (const char*)getauxval(AT_EXECFN);
+  }
+  if (!name || !module_path_matches(name, strlen(name), q.needle, q.needle_len)) {
+    return 0;
+  }
+
+  ModuleInfo m{ 0, 0, 0 };
+  uintptr_t lowest = UINTPTR_MAX, at_off0 = 0;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+    if (ph.p_type != PT_LOAD) {
+      continue;
+    }
+    const uintptr_t lo = page_down(info->dlpi_addr + ph.p_vaddr);
+    lowest = std::min(lowest, lo);
+    if (ph.p_offset == 0 && !at_off0) {
+      at_off0 = lo;
+    }
+    if (ph.p_flags & PF_X) {
+      const uintptr_t hi = page_up(info->dlpi_addr + ph.p_vaddr + ph.p_memsz);
+      m.text_lo = m.text_lo ? std::min(m.text_lo, lo) : lo;
+      m.text_hi = std::max(m.text_hi, hi);
+    }
+  }
+  if (lowest == UINTPTR_MAX) {
+    return 0;
+  }
+  m.base = at_off0 ? at_off0 : lowest;
+  *q.out = m;
+  q.found = true;
+  return 1;
+}
+
+bool module_self(const char* needle, ModuleInfo* out) {
+  SelfQuery q{ needle, strlen(needle), out, false };
+  dl_iterate_phdr(self_cb, &q);
+  return q.found;
+}
+
+// /proc/<pid>/maps line: "start-end perms offset dev inode   path"
+
+static const char* parse_hex(const char* p, const char* end, uintptr_t* out) {
+  uintptr_t v = 0;
+  const char* start = p;
+  for (; p < end; p++) {
+    const char c = *p;
+    unsigned d;
+    if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+    else if (c >= 'a' && c <= 'f') d = (unsigned)(c - 'a' + 10);
+    else break;
+    v = (v << 4) | d;
+  }
+  *out = v;
+  return p > start ? p : nullptr;
+}
+
+static const char* skip_field(const char* p, const char* end) {
+  while (p < end && *p != ' ') p++;
+  while (p < end && *p == ' ') p++;
+  return p;
+}
+
+bool ModuleTable::add_line(const char* line, size_t len) {
+  const char* end = line + len;
+  uintptr_t start, stop, offset;
+  const char* p = parse_hex(line, end, &start);
+  if (!p || p == end || *p != '-' || !(p = parse_hex(p + 1, end, &stop)) ||
+      end - p < 6 || *p != ' ') {
+    return true; // not a mapping line, skip it
+  }
+  const bool exec = p[3] == 'x';
+  p = skip_field(p + 1, end); // perms
+  if (!(p = parse_hex(p, end, &offset))) {
+    return true;
+  }
+  p = skip_field(p, end); // offset
+  p = skip_field(p, end); // dev
+  p = skip_field(p, end); // inode
+  if (p == end || *p != '/') {
+    return true; // anonymous, [heap], [stack], ...
+  }
+  const size_t path_len = (size_t)(end - p);
+  if (names_.size() + path_len + 1 > UINT32_MAX) {
+    return false;
+  }
+
+  const uint32_t rev = (uint32_t)names_.size();
+  if (!names_.resize(names_.size() + path_len + 1)) {
+    return false;
+  }
+  std::reverse_copy(p, end, names_.data() + rev);
+  return maps_.push_back({ rev, (uint32_t)path_len, start, stop, offset, exec });
+}
+
+void ModuleTable::clear() {
+  names_.clear();
+  maps_.clear();
+  rows_.clear();
+}
+
+bool ModuleTable::add_lines(const char* text, size_t len) {
+  const char* end = text + len;
+  while (text < end) {
+    const char* nl = (const char*)memchr(text, '\n', (size_t)(end - text));
+    const char* eol = nl ? nl : end;
+    if (!add_line(text, (size_t)(eol - text))) {
+      LOGE("out of memory for the module table");
+      return false;
+    }
+    text = nl ? nl + 1 : end;
+  }
+  return true;
+}
+
+bool ModuleTable::parse(const char* text, size_t len) {
+  clear();
+  return add_lines(text, len) && build();
+}
+
+bool ModuleTable::load_file(const char* maps_path) {
+  const int fd = open(maps_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  // /proc files are read in chunks; carry a partial last line over
+  char buf[16384];
+  size_t have = 0;
+  bool ok = true;
+  clear();
+  for (;;) {
+    const ssize_t n = read(fd, buf + have, sizeof buf - have);
+    if (n < 0) {
+      ok = false;
+      break;
+    }
+    have += (size_t)n;
+    const char* last_nl = (const char*)memrchr(buf, '\n', have);
+    if (n == 0 || (!last_nl && have == sizeof buf)) {
+      ok = add_lines(buf, have); // the end, or a line longer than buf
+      break;
+    }
+    if (last_nl) {
+      const size_t whole = (size_t)(last_nl - buf) + 1;
+      if (!(ok = add_lines(buf, whole))) {
+        break;
+      }
+      memmove(buf, buf + whole, have - whole);
+      have -= whole;
+    }
+  }
+  close(fd);
+  return ok && build();
+}
+
+bool ModuleTable::load(pid_t pid) {
+  char path[64];
+  snprintf(path, sizeof path, "/proc/%d/maps", (int)pid);
+  return load_file(path);
+}
+
+bool ModuleTable::build() {
+  const char* names = names_.data();
+  Mapping* m = maps_.data();
+  const size_t n = maps_.size();
+
+  // by path, then address; the mappings of one path become one row
+  std::sort(m, m + n, [names](const Mapping& a, const Mapping& b) {
+    int c = strcmp(names + a.rev, names + b.rev);
+    return c ? c < 0 : a.start < b.start;
+  });
+  rows_.clear();
+  for (size_t i = 0; i < n;) {
+    Row r{ m[i].rev, m[i].rev_len, { 0, 0, 0 } };
+    uintptr_t lowest = m[i].start, at_off0 = 0;
+    size_t j = i;
+    for (; j < n && strcmp(names + m[j].rev, names + m[i].rev) == 0; j++) {
+      if (m[j].offset == 0 && !at_off0) {
+        at_off0 = m[j].start;
+      }
+      if (m[j].exec) {
+        r.info.text_lo = r.info.text_lo ? std::min(r.info.text_lo, m[j].start) : m[j].start;
+        r.info.text_hi = std::max(r.info.text_hi, m[j].end);
+      }
+    }
+    r.info.base = at_off0 ? at_off0 : lowest;
+    if (!rows_.push_back(r)) {
+      LOGE("out of memory for the module table");
+      return false;
+    }
+    i = j;
+  }
+  return true;
+}
+
+const ModuleInfo* ModuleTable::find(const char* needle) const {
+  const size_t len = strlen(needle);
+  char rev[PATH_MAX];
+  if (len == 0 || len >= sizeof rev) {
+    return nullptr;
+  }
+  std::reverse_copy(needle, needle + len, rev);
+  rev[len] = 0;
+
+  // the rows whose reversed path starts with the reversed needle are
+  // contiguous, from the first one not less than it
+  const char* names = names_.data();
+  const Row* r = std::lower_bound(rows_.begin(), rows_.end(), rev,
+                                  [names](const Row& row, const char* key) {
+                                    return strcmp(names + row.rev, key) < 0;
+                                  });
+  const ModuleInfo* best = nullptr;
+  for (; r != rows_.end() && strncmp(names + r->rev, rev, len) == 0; r++) {
+    // the character before the suffix, read backwards
+    const char before = r->rev_len > len ? names[r->rev + len] : '/';
+    if ((before == '/' || needle[0] == '/') && (!best || r->info.base < best->base)) {
+      best = &r->info;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+// Where the ELF modules of a process are loaded.
+//
+// A needle names a module by a suffix of its path that starts at a '/'
+// ("libc.so", "bionic/libc.so", "/system/bin/surfaceflinger").
+
+struct ModuleInfo {
+  uintptr_t base;    // ELF load base: its mapping at file offset 0, else its lowest
+  uintptr_t text_lo; // extent of its executable mappings, 0 / 0 if none
+  uintptr_t text_hi;
+};
+
+// Does path name the module needle refers to?
+bool module_path_matches(const char* path, size_t path_len, const char* needle,
+                         size_t needle_len);
+
+// A module of this process, from the dynamic linker's list
+// (dl_iterate_phdr(), the main executable named by AT_EXECFN): no file I/O
+// and no allocation. False if no loaded object matches.
+bool module_self(const char* needle, ModuleInfo* out);
+
+// The file-backed mappings of a process, read from /proc/<pid>/maps once and
+// merged into one row per path, sorted by reversed path so that a needle
+// lookup is a binary search over the rows that end with it.
+struct ModuleTable {
+  bool load(pid_t pid);
+  bool load_file(const char* maps_path);
+  // the same from maps text already in memory
+  bool parse(const char* text, size_t len);
+
+  // The matching module with the lowest base, or nullptr.
+  const ModuleInfo* find(const char* needle) const;
+  size_t size() const { return rows_.size(); }
+
+private:
+  struct Row {
+    uint32_t   rev;     // reversed path, offset into names_
+    uint32_t   rev_len;
+    ModuleInfo info;
+  };
+  struct Mapping {
+    uint32_t  rev;
+    uint32_t  rev_len;
+    uintptr_t start, end, offset;
+    bool      exec;
+  };
+
+  void clear();
+  bool add_line(const char* line, size_t len);
+  bool add_lines(const char* text, size_t len);
+  bool build();
+
+  ArenaArray<char>    names_;
+  ArenaArray<Mapping> maps_;
+  ArenaArray<Row>     rows_;
+};
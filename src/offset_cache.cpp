@@ -0,0 +1,229 @@
+#include "offset_cache.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "log.h"
+#include "elf_view.h"
+#include "offset_manifest.h"
+#include "sym_resolver.h"
+
+// File layout (native endian, whole file is a few hundred bytes):
+//   CacheHeader
+//   CacheKey
+//   count x { uint64_t value; uint16_t name_len; char name[name_len]; }
+// value is st_value, or CACHE_ABSENT if the symbol does not exist.
+
+static const uint32_t CACHE_MAGIC   = 0x43524653; // "SFRC"
+static const uint32_t CACHE_VERSION = 1;
+static const uint64_t CACHE_ABSENT  = ~0ull;
+static const size_t   CACHE_MAX     = 4096;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t payload_size; // bytes after the header
+  uint32_t checksum;     // FNV-1a over the payload
+  uint32_t reserved;
+};
+
+struct CacheKey {
+  uint8_t  build_id[32];
+  uint32_t build_id_len;
+  uint32_t reserved;
+  uint64_t size;
+  uint64_t ino;      // 0 when a build ID is present
+  uint64_t mtime_ns; // 0 when a build ID is present
+};
+
+static uint32_t fnv1a(const uint8_t* p, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static bool make_key(const char* exe_path, CacheKey& key) {
+  memset(&key, 0, sizeof(key));
+  struct stat st{};
+  if (stat(exe_path, &st) != 0) {
+    return false;
+  }
+  key.size = (uint64_t)st.st_size;
+
+  ElfView elf;
+  const uint8_t* id = nullptr;
+  size_t id_len = 0;
+  if (elf.map_file(exe_path) && elf.build_id(&id, &id_len)) {
+    if (id_len > sizeof(key.build_id)) id_len = sizeof(key.build_id);
+    memcpy(key.build_id, id, id_len);
+    key.build_id_len = (uint32_t)id_len;
+    return true;
+  }
+
+  LOGV("no build ID in %s, keying cache on inode/mtime", exe_path);
+  key.ino = (uint64_t)st.st_ino;
+  key.mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+  return true;
+}
+
+// Fill every lookup from the cache. False if the cache is missing, invalid,
+// for a different binary, or lacks any of the requested names.
+static bool cache_load(const char* cache_path, const CacheKey& key,
+                       GnuDebugLookup* lookups, size_t count,
+                       uintptr_t runtime_base) {
+  uint8_t buf[CACHE_MAX];
+  int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t n = read(fd, buf, sizeof buf);
+  close(fd);
+  if (n < (ssize_t)(sizeof(CacheHeader) + sizeof(CacheKey))) {
+    return false;
+  }
+
+  CacheHeader hdr;
+  memcpy(&hdr, buf, sizeof hdr);
+  if (hdr.magic != CACHE_MAGIC || hdr.version != CACHE_VERSION ||
+      hdr.payload_size != (size_t)n - sizeof hdr) {
+    LOGI("offset cache %s invalid, rebuilding", cache_path);
+    return false;
+  }
+  const uint8_t* payload = buf + sizeof hdr;
+  if (fnv1a(payload, hdr.payload_size) != hdr.checksum) {
+    LOGI("offset cache %s checksum mismatch, rebuilding", cache_path);
+    return false;
+  }
+  if (memcmp(payload, &key, sizeof key) != 0) {
+    LOGI("offset cache %s is for another binary, rebuilding", cache_path);
+    return false;
+  }
+
+  for (size_t j = 0; j < count; j++) {
+    lookups[j].addr = 0;
+    lookups[j].tier = SYM_TIER_NONE;
+  }
+
+  size_t found = 0;
+  const uint8_t* p = payload + sizeof key;
+  const uint8_t* end = payload + hdr.payload_size;
+  for (uint32_t i = 0; i < hdr.count; i++) {
+    uint64_t value;
+    uint16_t len;
+    if (end - p < (ptrdiff_t)(sizeof value + sizeof len)) {
+      return false;
+    }
+    memcpy(&value, p, sizeof value);
+    memcpy(&len, p + sizeof value, sizeof len);
+    p += sizeof value + sizeof len;
+    if (end - p < (ptrdiff_t)len) {
+      return false;
+    }
+    for (size_t j = 0; j < count; j++) {
+      const char* nm = lookups[j].mangled_name;
+      if (strlen(nm) != len || memcmp(nm, p, len) != 0) {
+        continue;
+      }
+      if (value != CACHE_ABSENT) {
+        lookups[j].addr = runtime_base + (uintptr_t)value;
+        lookups[j].tier = SYM_TIER_CACHE;
+      }
+      found++;
+      break;
+    }
+    p += len;
+  }
+  return found == count;
+}
+
+static void cache_store(const char* cache_path, const CacheKey& key,
+                        const GnuDebugLookup* lookups, size_t count,
+                        uintptr_t runtime_base) {
+  uint8_t buf[CACHE_MAX];
+  size_t pos = sizeof(CacheHeader);
+  memcpy(buf + pos, &key, sizeof key);
+  pos += sizeof key;
+
+  for (size_t j = 0; j < count; j++) {
+    size_t len = strlen(lookups[j].mangled_name);
+    if (len > 0xffff || pos + sizeof(uint64_t) + sizeof(uint16_t) + len > sizeof buf) {
+      LOGE("offset cache: too many names, not writing");
+      return;
+    }
+    uint64_t value = lookups[j].addr ? (uint64_t)(lookups[j].addr - runtime_base) : CACHE_ABSENT;
+    uint16_t len16 = (uint16_t)len;
+    memcpy(buf + pos, &value, sizeof value);
+    pos += sizeof value;
+    memcpy(buf + pos, &len16, sizeof len16);
+    pos += sizeof len16;
+    memcpy(buf + pos, lookups[j].mangled_name, len);
+    pos += len;
+  }
+
+  CacheHeader hdr{};
+  hdr.magic = CACHE_MAGIC;
+  hdr.version = CACHE_VERSION;
+  hdr.count = (uint32_t)count;
+  hdr.payload_size = (uint32_t)(pos - sizeof hdr);
+  hdr.checksum = fnv1a(buf + sizeof hdr, hdr.payload_size);
+  memcpy(buf, &hdr, sizeof hdr);
+
+  // write to a temp file and rename so readers never see a partial cache
+  char tmp[512];
+  snprintf(tmp, sizeof tmp, "%s.%d", cache_path, (int)getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOGV("offset cache: cannot create %s", tmp);
+    return;
+  }
+  bool ok = write(fd, buf, pos) == (ssize_t)pos;
+  close(fd);
+  if (!ok || rename(tmp, cache_path) != 0) {
+    LOGV("offset cache: failed to write %s", cache_path);
+    unlink(tmp);
+    return;
+  }
+  LOGV("offset cache written: %s (%zu names)", cache_path, count);
+}
+
+size_t resolve_addrs_cached(const char* exe_path,
+                            const char* cache_path,
+                            const char* manifest_path,
+                            GnuDebugLookup* lookups,
+                            size_t count,
+                            uintptr_t runtime_base) {
+  CacheKey key;
+  bool have_key = (cache_path || manifest_path) && make_key(exe_path, key);
+
+  if (have_key && cache_path && cache_load(cache_path, key, lookups, count, runtime_base)) {
+    size_t found = 0;
+    for (size_t j = 0; j < count; j++) {
+      if (lookups[j].addr) found++;
+    }
+    LOGI("offsets loaded from cache %s", cache_path);
+    return found;
+  }
+
+  // a known build: its row of the manifest, nothing to cache
+  if (have_key && manifest_read(manifest_path, key.build_id, key.build_id_len, lookups, count,
+                                runtime_base)) {
+    size_t found = 0;
+    for (size_t j = 0; j < count; j++) {
+      if (lookups[j].addr) found++;
+    }
+    LOGI("offsets loaded from manifest %s", manifest_path);
+    return found;
+  }
+
+  size_t found = resolve_addrs(exe_path, lookups, count, runtime_base);
+  // don't cache a total failure, it is most likely a read/decode error
+  if (have_key && cache_path && found > 0) {
+    cache_store(cache_path, key, lookups, count, runtime_base);
+  }
+  return found;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gnu_debugdata_resolver.h"
+
+// Small on-disk cache of symbol offsets (st_value) keyed by the binary's
+// NT_GNU_BUILD_ID note, or by inode/size/mtime when it has none.
+//
+// Works like resolve_addrs(), except that a valid cache entry for every
+// lookup is answered with one small read (tier SYM_TIER_CACHE). Next, a
+// build listed in the offset manifest (offset_manifest.h, nullptr for none)
+// is answered from it (SYM_TIER_MANIFEST). Otherwise the layered resolver
+// runs and the cache is rewritten (best-effort, the file may not be
+// writable).
+size_t resolve_addrs_cached(const char* exe_path,
+                            const char* cache_path,
+                            const char* manifest_path,
+                            GnuDebugLookup* lookups,
+                            size_t count,
+                            uintptr_t runtime_base);
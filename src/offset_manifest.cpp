@@ -0,0 +1,231 @@
+#include "offset_manifest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include "log.h"
+
+static const char   MANIFEST_HEADER[] = "sfoffsets 1";
+static const size_t MANIFEST_MAX      = 1 << 20; // a few hundred builds fit in 64 KiB
+
+static void hex_id(const uint8_t* id, size_t len, char* out) {
+  static const char HEX[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; i++) {
+    out[2 * i] = HEX[id[i] >> 4];
+    out[2 * i + 1] = HEX[id[i] & 15];
+  }
+  out[2 * len] = 0;
+}
+
+// Next space-separated token of [p, end), or an empty one at the end of the
+// line or at a '#' comment.
+static const char* next_token(const char* p, const char* end, size_t* len) {
+  while (p < end && *p == ' ') p++;
+  const char* t = p;
+  if (p < end && *p == '#') {
+    *len = 0;
+    return t;
+  }
+  while (p < end && *p != ' ') p++;
+  *len = (size_t)(p - t);
+  return t;
+}
+
+static bool parse_offset(const char* t, size_t len, uint64_t* out) {
+  if (len == 1 && *t == '-') {
+    *out = MANIFEST_ABSENT;
+    return true;
+  }
+  if (len == 0 || len > 16) {
+    return false;
+  }
+  uint64_t v = 0;
+  for (size_t i = 0; i < len; i++) {
+    const char c = t[i];
+    unsigned d;
+    if (c >= '0' && c <= '9') d = (unsigned)(c - '0');
+    else if (c >= 'a' && c <= 'f') d = (unsigned)(c - 'a' + 10);
+    else return false;
+    v = (v << 4) | d;
+  }
+  *out = v;
+  return true;
+}
+
+bool manifest_read(const char* path, const uint8_t* build_id, size_t build_id_len,
+                   GnuDebugLookup* lookups, size_t count, uintptr_t runtime_base) {
+  if (!path || build_id_len == 0 || build_id_len > 32) {
+    return false;
+  }
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st{};
+  ArenaArray<char> text;
+  bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size <= MANIFEST_MAX &&
+            text.resize((size_t)st.st_size);
+  for (size_t have = 0; ok && have < text.size();) {
+    const ssize_t n = read(fd, text.data() + have, text.size() - have);
+    ok = n > 0;
+    have += ok ? (size_t)n : 0;
+  }
+  close(fd);
+  if (!ok) {
+    LOGI("offset manifest %s unreadable, ignoring", path);
+    return false;
+  }
+
+  char want[65];
+  hex_id(build_id, build_id_len, want);
+  const size_t want_len = 2 * build_id_len;
+
+  // column of every lookup, + 1 (0: not in the manifest)
+  ArenaArray<uint32_t> col;
+  if (!col.resize(count)) {
+    return false;
+  }
+  uint32_t ncols = 0;
+  bool header = false;
+
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    const char* eol = nl ? nl : end;
+    const char* line = p;
+    p = nl ? nl + 1 : end;
+    if (line == eol || *line == '#') {
+      continue;
+    }
+
+    if (!header) {
+      if ((size_t)(eol - line) != sizeof(MANIFEST_HEADER) - 1 ||
+          memcmp(line, MANIFEST_HEADER, sizeof(MANIFEST_HEADER) - 1) != 0) {
+        LOGI("offset manifest %s invalid, ignoring", path);
+        return false;
+      }
+      header = true;
+      continue;
+    }
+
+    if (eol - line > 5 && memcmp(line, "name ", 5) == 0) {
+      const char* name = line + 5;
+      const size_t len = (size_t)(eol - name);
+      ncols++;
+      for (size_t j = 0; j < count; j++) {
+        if (strlen(lookups[j].mangled_name) == len &&
+            memcmp(lookups[j].mangled_name, name, len) == 0) {
+          col[j] = ncols;
+        }
+      }
+      continue;
+    }
+
+    size_t len;
+    const char* id = next_token(line, eol, &len);
+    if (len != want_len || memcmp(id, want, len) != 0) {
+      continue;
+    }
+
+    // this build's row
+    for (size_t j = 0; j < count; j++) {
+      if (!col[j]) {
+        LOGI("offset manifest %s has no column for %s", path, lookups[j].mangled_name);
+        return false;
+      }
+      lookups[j].addr = 0;
+      lookups[j].tier = SYM_TIER_NONE;
+    }
+    const char* q = id + len;
+    for (uint32_t c = 1; c <= ncols; c++) {
+      const char* t = next_token(q, eol, &len);
+      uint64_t off;
+      if (!parse_offset(t, len, &off)) {
+        LOGI("offset manifest %s: bad row for %s, ignoring", path, want);
+        return false;
+      }
+      q = t + len;
+      for (size_t j = 0; j < count; j++) {
+        if (col[j] == c && off != MANIFEST_ABSENT) {
+          lookups[j].addr = runtime_base + (uintptr_t)off;
+          lookups[j].tier = SYM_TIER_MANIFEST;
+        }
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+static bool id_less(const ManifestBuild& a, const ManifestBuild& b) {
+  const int c = memcmp(a.build_id, b.build_id, std::min(a.build_id_len, b.build_id_len));
+  return c ? c < 0 : a.build_id_len < b.build_id_len;
+}
+
+static bool id_equal(const ManifestBuild& a, const ManifestBuild& b) {
+  return a.build_id_len == b.build_id_len &&
+         memcmp(a.build_id, b.build_id, a.build_id_len) == 0;
+}
+
+bool manifest_write(const char* path, const char* const* names, size_t nnames,
+                    ManifestBuild* builds, size_t nbuilds) {
+  std::stable_sort(builds, builds + nbuilds, id_less);
+
+  const bool to_stdout = strcmp(path, "-") == 0;
+  char tmp[512];
+  snprintf(tmp, sizeof tmp, "%s.%d", path, (int)getpid());
+  FILE* f = to_stdout ? stdout : fopen(tmp, "we");
+  if (!f) {
+    LOGE("offset manifest: cannot create %s", tmp);
+    return false;
+  }
+
+  bool ok = true;
+  fprintf(f, "%s\n", MANIFEST_HEADER);
+  for (size_t c = 0; c < nnames; c++) {
+    fprintf(f, "name %s\n", names[c]);
+  }
+  char id[65];
+  for (size_t i = 0; i < nbuilds; i++) {
+    const ManifestBuild& b = builds[i];
+    hex_id(b.build_id, b.build_id_len, id);
+    if (i > 0 && id_equal(b, builds[i - 1])) {
+      // the same build under another path: must agree, then it is one row
+      if (memcmp(b.offsets, builds[i - 1].offsets, nnames * sizeof(uint64_t)) != 0) {
+        LOGE("offset manifest: build %s has different offsets in %s and %s", id,
+             b.comment ? b.comment : "?", builds[i - 1].comment ? builds[i - 1].comment : "?");
+        ok = false;
+      }
+      continue;
+    }
+    fputs(id, f);
+    for (size_t c = 0; c < nnames; c++) {
+      if (b.offsets[c] == MANIFEST_ABSENT) {
+        fputs(" -", f);
+      } else {
+        fprintf(f, " %llx", (unsigned long long)b.offsets[c]);
+      }
+    }
+    if (b.comment) {
+      fprintf(f, "  # %s", b.comment);
+    }
+    fputc('\n', f);
+  }
+
+  if (to_stdout) {
+    return fflush(f) == 0 && ok;
+  }
+  // temp file + rename, like the offset cache
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp, path) != 0) {
+    LOGE("offset manifest: failed to write %s", path);
+    unlink(tmp);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gnu_debugdata_resolver.h"
+
+// Symbol offsets of known surfaceflinger builds, keyed by GNU build ID and
+// generated offline by host/sf_offsets from a collection of firmware
+// binaries. Shipped next to the injector, it answers the hook lookups of
+// any listed build without reading the binary's symbols at all.
+//
+// Text, one line each, so it diffs well when builds are added:
+//   sfoffsets 1
+//   name <mangled name>                        (one per column)
+//   <build ID hex> <offset hex | -> ...        [# anything, e.g. the source]
+// '-' is a symbol the build does not have. Lines starting with '#' are
+// comments. Build lines are sorted by build ID.
+
+// Fill every lookup (tier SYM_TIER_MANIFEST) from the manifest's row for
+// build_id. False if the manifest is missing or invalid, has no row for the
+// build, or lacks a column for any of the names.
+bool manifest_read(const char* path, const uint8_t* build_id, size_t build_id_len,
+                   GnuDebugLookup* lookups, size_t count, uintptr_t runtime_base);
+
+// One row of a manifest to write. offsets has one entry per name,
+// MANIFEST_ABSENT for a missing symbol.
+struct ManifestBuild {
+  uint8_t         build_id[32];
+  uint32_t        build_id_len;
+  const uint64_t* offsets;
+  const char*     comment; // optional, written after '#'
+};
+
+static const uint64_t MANIFEST_ABSENT = ~0ull;
+
+// Write names and builds (sorted here by build ID) to path, or to stdout
+// for "-". Rows with the same build ID must be identical and are written
+// once; false if two of them disagree or the file cannot be written.
+bool manifest_write(const char* path, const char* const* names, size_t nnames,
+                    ManifestBuild* builds, size_t nbuilds);
@@ -0,0 +1,266 @@
+#include "sf_config.h"
+
+#include <sys/system_properties.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "sf_stats.h"
+
+// default rotation (can be overridden by prop)
+// 0, 90, 180, 270
+// 270 = portrait
+static const SfConfig DEFAULT_CONFIG = { true, 270, {} };
+
+std::atomic<const SfConfig*> g_sf_config{&DEFAULT_CONFIG};
+
+struct WatchedProp {
+  const char*      name;
+  const prop_info* pi;     // cached handle, nullptr until the property exists
+  uint32_t         serial; // serial of the value last parsed
+};
+
+enum { PROP_ENABLE, PROP_ORIENTATION, PROP_DISPLAY_RESCAN, PROP_COUNT };
+
+static WatchedProp g_props[PROP_COUNT] = {
+  { "persist.sfrotate.enable",       nullptr, 0 },
+  { "persist.panel.rds.orientation", nullptr, 0 },
+  { SFROTATE_DISPLAY_RESCAN_PROP,    nullptr, 0 },
+};
+
+static void copy_value(void* cookie, const char*, const char* value, uint32_t) {
+  char* out = (char*)cookie;
+  strncpy(out, value, PROP_VALUE_MAX - 1);
+  out[PROP_VALUE_MAX - 1] = 0;
+}
+
+// Current value of p, "" if it is unset.
+static void read_prop(WatchedProp& p, char (&out)[PROP_VALUE_MAX]) {
+  out[0] = 0;
+  if (!p.pi) {
+    p.pi = __system_property_find(p.name);
+  }
+  if (!p.pi) {
+    return;
+  }
+  // serial first: a change racing with the read is seen on the next pass
+  p.serial = __system_property_serial(p.pi);
+  __system_property_read_callback(p.pi, copy_value, out);
+}
+
+// Per-display overrides: persist.sfrotate.display.<id> = 0|90|180|270|orig.
+// The IDs are not known up front, so the props are found with one
+// __system_property_foreach() at init, and again only when
+// SFROTATE_DISPLAY_RESCAN_PROP is set. Walking every property on every
+// change in the system would cost far more than the reads it replaces.
+// Between rescans the handles found are watched like the other props.
+static const char   DISPLAY_PREFIX[] = "persist.sfrotate.display.";
+static const size_t DISPLAY_PREFIX_LEN = sizeof(DISPLAY_PREFIX) - 1;
+
+struct DisplayProp {
+  const prop_info* pi;
+  uint32_t         serial; // serial of the value last parsed
+};
+
+static DisplayProp g_display_props[DisplayMap::MAX];
+static size_t      g_display_prop_count;
+static bool        g_display_rescan = true; // find the display props again
+
+bool DisplayMap::put(uint64_t id, int degree) {
+  size_t p = slot_of(id);
+  while (slots[p].used && slots[p].id != id) {
+    p = (p + 1) & (SLOTS - 1);
+  }
+  if (!slots[p].used) {
+    if (count >= MAX) return false;
+    count++;
+  }
+  slots[p] = { id, (int16_t)degree, true };
+  return true;
+}
+
+static void parse_display(SfConfig* cfg, const char* name, const char* value) {
+  const char* id_str = name + DISPLAY_PREFIX_LEN;
+  char* end = nullptr;
+  uint64_t id = strtoull(id_str, &end, 10);
+  if (!*id_str || *end) {
+    LOGE("config: bad display id in %s", name);
+    return;
+  }
+
+  int d;
+  if (!strcmp(value, "orig")) {
+    d = DEGREE_ORIGINAL;
+  } else {
+    d = atoi(value);
+    if (!(d==0 || d==90 || d==180 || d==270)){
+      LOGE("config: bad rotation '%s' for %s", value, name);
+      return;
+    }
+  }
+  if (!cfg->displays.put(id, d)) {
+    LOGE("config: more than %zu displays, ignoring %s", DisplayMap::MAX, name);
+  }
+}
+
+static void on_display(void* cookie, const char* name, const char* value, uint32_t) {
+  if (value[0]) {
+    parse_display((SfConfig*)cookie, name, value);
+  }
+}
+
+struct DisplayFind {
+  const prop_info* pi;
+  bool             match;
+};
+
+static void match_display(void* cookie, const char* name, const char*, uint32_t) {
+  ((DisplayFind*)cookie)->match = strncmp(name, DISPLAY_PREFIX, DISPLAY_PREFIX_LEN) == 0;
+}
+
+static void find_display(const prop_info* pi, void*) {
+  DisplayFind f = { pi, false };
+  __system_property_read_callback(pi, match_display, &f);
+  if (!f.match) {
+    return;
+  }
+  if (g_display_prop_count == DisplayMap::MAX) {
+    LOGE("config: more than %zu display props, ignoring the rest", DisplayMap::MAX);
+    return;
+  }
+  g_display_props[g_display_prop_count++] = { pi, 0 };
+}
+
+static void find_displays() {
+  g_display_prop_count = 0;
+  __system_property_foreach(find_display, nullptr);
+}
+
+// Parse every known display prop into cfg.
+static void read_displays(SfConfig* cfg) {
+  for (size_t i = 0; i < g_display_prop_count; i++) {
+    DisplayProp& d = g_display_props[i];
+    d.serial = __system_property_serial(d.pi);
+    __system_property_read_callback(d.pi, on_display, cfg);
+  }
+}
+
+static bool changed(const WatchedProp& p) {
+  if (!p.pi) {
+    return __system_property_find(p.name) != nullptr;
+  }
+  return __system_property_serial(p.pi) != p.serial;
+}
+
+// A serial compare per watched prop: cheap enough for every wake-up.
+static bool props_changed() {
+  bool any = false;
+  for (auto& p : g_props) {
+    any |= changed(p);
+  }
+  if (changed(g_props[PROP_DISPLAY_RESCAN])) {
+    g_display_rescan = true;
+  }
+  for (size_t i = 0; i < g_display_prop_count && !any; i++) {
+    any = __system_property_serial(g_display_props[i].pi) != g_display_props[i].serial;
+  }
+  return any;
+}
+
+static void publish() {
+  SfConfig* c = new SfConfig(DEFAULT_CONFIG);
+  char v[PROP_VALUE_MAX];
+
+  read_prop(g_props[PROP_ENABLE], v);
+  if (v[0]) {
+    c->enabled = strcmp(v, "0") != 0;
+  }
+
+  read_prop(g_props[PROP_ORIENTATION], v);
+  if (v[0]) {
+    int d = atoi(v);
+    if (d==0 || d==90 || d==180 || d==270){
+      c->degree = d;
+    }
+  }
+
+  // value unused, a set only asks for the rescan
+  read_prop(g_props[PROP_DISPLAY_RESCAN], v);
+  if (g_display_rescan) {
+    find_displays();
+    g_display_rescan = false;
+  }
+  read_displays(c);
+
+  // A hook may still be using the previous snapshot. Snapshots are a few
+  // bytes and only replaced when a property is set, so old ones are leaked
+  // rather than reclaimed.
+  g_sf_config.store(c, std::memory_order_release);
+  LOGI("config: enabled=%d degree=%d displays=%zu", c->enabled, c->degree,
+       c->displays.count);
+}
+
+#ifdef SFROTATE_STATS
+static WatchedProp g_stats_prop = { SFROTATE_STATS_PROP, nullptr, 0 };
+
+// Write the hook stats whenever SFROTATE_STATS_PROP is set.
+static void check_stats_dump() {
+  const uint32_t last = g_stats_prop.serial;
+  char v[PROP_VALUE_MAX];
+  if (!g_stats_prop.pi && !__system_property_find(g_stats_prop.name)) {
+    return;
+  }
+  if (g_stats_prop.pi && __system_property_serial(g_stats_prop.pi) == last) {
+    return;
+  }
+  read_prop(g_stats_prop, v);
+  if (v[0]) {
+    sf_stats_dump(SFROTATE_STATS_FILE, strcmp(v, "reset") == 0);
+  }
+}
+#endif
+
+static uint32_t g_area_serial;
+
+static void* watch_props(void*) {
+  uint32_t serial = g_area_serial;
+  for (;;) {
+    // wakes on any property change in the system, most of which are not
+    // ours: props_changed() only compares the serials of the watched ones
+    if (!__system_property_wait(nullptr, serial, &serial, nullptr)) {
+      LOGE("config watcher: __system_property_wait failed");
+      return nullptr;
+    }
+    if (props_changed()) {
+      publish();
+    }
+#ifdef SFROTATE_STATS
+    check_stats_dump();
+#endif
+  }
+}
+
+void sf_config_init() {
+  static bool started = false;
+  if (started) {
+    return;
+  }
+  started = true;
+
+  // take the area serial before reading, so nothing set in between is missed
+  g_area_serial = __system_property_area_serial();
+  publish();
+#ifdef SFROTATE_STATS
+  // only later sets trigger a dump
+  char v[PROP_VALUE_MAX];
+  read_prop(g_stats_prop, v);
+#endif
+
+  pthread_t t;
+  if (pthread_create(&t, nullptr, watch_props, nullptr) != 0) {
+    LOGE("could not start config watcher, property changes need a restart");
+    return;
+  }
+  pthread_setname_np(t, "sfrotate-cfg");
+  pthread_detach(t);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Setting this (any value) makes the watcher look for new
+// persist.sfrotate.display.<id> props; ones that existed at init, or at the
+// last rescan, are picked up on their own.
+#define SFROTATE_DISPLAY_RESCAN_PROP "debug.sfrotate.display_rescan"
+
+// Rotation for one display, or DEGREE_ORIGINAL to leave it to surfaceflinger.
+static const int DEGREE_ORIGINAL = -1;
+
+// Per-display overrides from persist.sfrotate.display.<PhysicalDisplayId>.
+// Fixed-size open-addressed table (linear probing, at most half full), so
+// the hook can look a display up without locks or allocation.
+struct DisplayMap {
+  static const unsigned SLOT_BITS = 5;
+  static const size_t   SLOTS = (size_t)1 << SLOT_BITS;
+  static const size_t   MAX = SLOTS / 2;
+
+  struct Slot {
+    uint64_t id;
+    int16_t  degree;
+    bool     used;
+  };
+  Slot   slots[SLOTS];
+  size_t count;
+
+  static size_t slot_of(uint64_t id) {
+    // Fibonacci hashing: display IDs differ mostly in the low (port) byte
+    return (size_t)((id * 0x9E3779B97F4A7C15ull) >> (64 - SLOT_BITS));
+  }
+
+  // Add or replace id. False when the table is full.
+  bool put(uint64_t id, int degree);
+
+  // Override for id, or nullptr.
+  const Slot* find(uint64_t id) const {
+    for (size_t p = slot_of(id); slots[p].used; p = (p + 1) & (SLOTS - 1)) {
+      if (slots[p].id == id) return &slots[p];
+    }
+    return nullptr;
+  }
+};
+
+// Immutable snapshot of the sfrotate system properties.
+//
+// sf_config_init() reads the properties once and starts a watcher thread
+// that re-reads them whenever one of their serials changes, publishing a new
+// snapshot each time. The hooks only do sf_config(): one acquire load, no
+// property lookups on surfaceflinger's composition threads.
+struct SfConfig {
+  bool       enabled;  // persist.sfrotate.enable != "0" (default on)
+  int        degree;   // persist.panel.rds.orientation: 0, 90, 180, 270 (default 270)
+  DisplayMap displays; // per-display overrides
+
+  // Rotation for a display: its override if there is one, otherwise the
+  // primary display (id 1) keeps its own orientation and every other
+  // display gets the global degree.
+  int degree_for(uint64_t id) const {
+    if (const DisplayMap::Slot* s = displays.find(id)) return s->degree;
+    return id == 1ULL ? DEGREE_ORIGINAL : degree;
+  }
+};
+
+// Published snapshot, never nullptr (holds the defaults before init).
+extern std::atomic<const SfConfig*> g_sf_config;
+
+static inline const SfConfig& sf_config() {
+  return *g_sf_config.load(std::memory_order_acquire);
+}
+
+// Publish the current properties and start the watcher. Call before the
+// hooks are installed; later calls do nothing.
+void sf_config_init();
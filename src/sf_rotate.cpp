@@ -1,75 +1,61 @@
 #include "sf_rotate.hpp"
 
-// default rotation (can be overridden by prop)
-// 0, 90, 180, 270
-// 270 = portrait
-static int rotation_degree = 270;
-
 static IsSupportedFn origHidlIsSupported = nullptr;
 static IsSupportedFn origAidlIsSupported = nullptr;
 static GetPhysOriFn  origGetPhysicalDisplayOrientation = nullptr;
 
-static bool prop_enabled() {
-  char v[PROP_VALUE_MAX] = {0};
-  if (__system_property_get("persist.sfrotate.enable", v) > 0){
-    return strcmp(v, "0") != 0;
+// Load base of surfaceflinger. text_lo/text_hi (optional) receive the
+// extent of its executable mappings, for checking hook addresses.
+static uintptr_t get_sf_base(uintptr_t* text_lo = nullptr, uintptr_t* text_hi = nullptr) {
+  ModuleInfo m{ 0, 0, 0 };
+  if (!module_self(sf_bin_path(), &m)) {
+    // not in the linker's list under that path (started through a relative
+    // one, say): read the maps instead
+    ModuleTable maps;
+    const ModuleInfo* found = maps.load(getpid()) ? maps.find(sf_bin_path()) : nullptr;
+    if (!found) return 0;
+    m = *found;
   }
-  return true; // default on
+  if (text_lo) *text_lo = m.text_lo;
+  if (text_hi) *text_hi = m.text_hi;
+  return m.base;
 }
 
-static int prop_degree() {
-  char v[PROP_VALUE_MAX] = {0};
-  if (__system_property_get("persist.panel.rds.orientation", v) > 0) {
-    int d = atoi(v);
-    if (d==0 || d==90 || d==180 || d==270){
-      return d;
-    }
-  }
-  return rotation_degree;
-}
-
-static uintptr_t get_sf_base() {
-  FILE* f = fopen("/proc/self/maps", "r");
-  if (!f) return 0;
-
-  char line[512];
-  uintptr_t base_with_off0 = 0;
-  uintptr_t base_min_any   = (uintptr_t)-1;
+// calls into the original functions (through their trampolines)
 
-  while (fgets(line, sizeof line, f)) {
-    if (strstr(line, "/system/bin/surfaceflinger") == nullptr) continue;
-
-    // format: start-end perms offset dev inode pathname
-    unsigned long start = 0, off = 0;
-    if (sscanf(line, "%lx-%*lx %*4s %lx", &start, &off) != 2) continue;
+static bool callOrigHidlIsSupported(void* self, OptionalFeature feature) {
+  SF_STAT_SCOPE(STAT_HIDL_ORIG);
+  return origHidlIsSupported ? origHidlIsSupported(self, feature) : false;
+}
 
-    if (off == 0 && base_with_off0 == 0) base_with_off0 = (uintptr_t) start;
-    if ((uintptr_t) start < base_min_any) base_min_any = (uintptr_t) start;
-  }
-  fclose(f);
+static bool callOrigAidlIsSupported(void* self, OptionalFeature feature) {
+  SF_STAT_SCOPE(STAT_AIDL_ORIG);
+  return origAidlIsSupported ? origAidlIsSupported(self, feature) : false;
+}
 
-  // Prefer the ELF base (offset 0). Fallback to lowest mapping for the file.
-  if (base_with_off0) return base_with_off0;
-  if (base_min_any != (uintptr_t)-1) return base_min_any;
-  return 0;
+static Transform callOrigGetPhysicalDisplayOrientation(void* self, uint64_t id) {
+  SF_STAT_SCOPE(STAT_ORIENT_ORIG);
+  return origGetPhysicalDisplayOrientation ? origGetPhysicalDisplayOrientation(self, id) : Transform::ROT_0;
 }
 
 SF_BRPROT static bool isSupportedHIDLHook(void* self, OptionalFeature feature) {
-  if(!prop_enabled()){
-    return origHidlIsSupported ? origHidlIsSupported(self, feature) : false;
+  SF_STAT_SCOPE(STAT_HIDL_HOOK);
+  if(!sf_config().enabled){
+    return callOrigHidlIsSupported(self, feature);
   }
   if (feature == OptionalFeature::PhysicalDisplayOrientation){
     LOGV("isSupportedHIDL(PhysicalDisplayOrientation) -> true (forced)");
     return true;
   }
   LOGV("isSupportedHIDL(%d)", feature);
-  return origHidlIsSupported ? origHidlIsSupported(self, feature) : false;
+  return callOrigHidlIsSupported(self, feature);
 }
 
 SF_BRPROT static bool isSupportedAIDLHook(void* self, OptionalFeature feature) {
+  SF_STAT_SCOPE(STAT_AIDL_HOOK);
 
-  if(!prop_enabled()){
-    return origAidlIsSupported ? origAidlIsSupported(self, feature) : false;
+  if(!sf_config().enabled){
+    return callOrigAidlIsSupported(self, feature);
   }
 
   if (feature == OptionalFeature::PhysicalDisplayOrientation){
@@ -77,68 +63,227 @@ SF_BRPROT static bool isSupportedAIDLHook(void* self, OptionalFeature feature) {
     return true;
   }
   LOGV("isSupportedAIDL(%d)", feature);
-  return origAidlIsSupported ? origAidlIsSupported(self, feature) : false;
+  return callOrigAidlIsSupported(self, feature);
 }
 
 SF_BRPROT static Transform getPhysicalDisplayOrientationHook(void* self, uint64_t id) {
+  SF_STAT_SCOPE(STAT_ORIENT_HOOK);
+  const SfConfig& cfg = sf_config();
 
-  if (!prop_enabled()) {
-    return origGetPhysicalDisplayOrientation ? origGetPhysicalDisplayOrientation(self, id) : Transform::ROT_0;
+  if (!cfg.enabled) {
+    return callOrigGetPhysicalDisplayOrientation(self, id);
   }
 
-  const bool isPrimary = (id == 1ULL);
-  if(isPrimary) {
-    auto result = origGetPhysicalDisplayOrientation ? origGetPhysicalDisplayOrientation(self, id) : Transform::ROT_0;
+  const int rotation = cfg.degree_for(id);
+  if (rotation == DEGREE_ORIGINAL) {
+    auto result = callOrigGetPhysicalDisplayOrientation(self, id);
     LOGV("getPhysicalDisplayOrientation(%" PRIu64 ") -> %d", id, result); 
     return result;
   }
-  auto rotation = prop_degree();
   LOGV("getPhysicalDisplayOrientation(%" PRIu64 ") -> %d degrees (forced)", id, rotation);
   return get_transform_for_degree(rotation);
 }
 
-SF_BRPROT __attribute__((constructor))
-static void init_sfrotate() {
-  LOGI("sfrotate init");
-  const uintptr_t base = get_sf_base();
+// persist.sfrotate.resolver_kb: memory budget of an in-process resolution
+// in KiB, 0 for no arena (default RESOLVER_BUDGET_DEFAULT)
+static size_t resolver_budget_prop() {
+  char v[PROP_VALUE_MAX] = {0};
+  if (__system_property_get("persist.sfrotate.resolver_kb", v) > 0) {
+    return (size_t)strtoul(v, nullptr, 10) * 1024;
+  }
+  return RESOLVER_BUDGET_DEFAULT;
+}
+
+// Counts the resolved lookups outside surfaceflinger's code [text_lo,
+// text_hi) or not 4-byte aligned, whatever tier answered them (a stale
+// manifest entry or a wrong signature as much as a bad handoff): patching
+// one would crash surfaceflinger. drop clears them.
+static size_t check_text(GnuDebugLookup* lookups, size_t n, uintptr_t text_lo, uintptr_t text_hi,
+                         const char* source, bool drop) {
+  size_t bad = 0;
+  for (size_t i = 0; i < n; i++) {
+    const uintptr_t a = lookups[i].addr;
+    if (!a || (a >= text_lo && a < text_hi && (a & 3) == 0)) {
+      continue;
+    }
+    LOGE("%s address 0x%lx for %s (%s) outside surfaceflinger text or misaligned", source,
+         (unsigned long)a, lookups[i].mangled_name, sym_tier_name(lookups[i].tier));
+    if (drop) {
+      lookups[i].addr = 0;
+      lookups[i].tier = SYM_TIER_NONE;
+    }
+    bad++;
+  }
+  return bad;
+}
+
+// Resolve the hook targets and install the hooks. Returns false if
+// nothing was hooked. live: surfaceflinger is running (async init), so
+// every patch must be a single atomic B.
+SF_BRPROT static bool setup_sfrotate(bool live) {
+  uintptr_t text_lo = 0, text_hi = 0;
+  const uintptr_t base = get_sf_base(&text_lo, &text_hi);
   if (!base) {
     LOGE("could not find surfaceflinger base");
-    return;
+    return false;
   }
 
-  void* hidlIsSupported = (void*)resolve_addr_from_gnu_debugdata(SURFACEFLINGER_BIN,
-                                                        SYM_HIDL_IS_SUPPORTED, base);
-  //void* aidlIsSupported = (void*)(base + OFF_AIDL_IS_SUPPORTED);
-  void* getPhysicalDisplayOrientation = (void*)resolve_addr_from_gnu_debugdata(SURFACEFLINGER_BIN,
-                                                        SYM_IMPL, base);
+  GnuDebugLookup lookups[] = {
+    { SYM_HIDL_IS_SUPPORTED, 0, SYM_TIER_NONE },
+    { SYM_AIDL_IS_SUPPORTED, 0, SYM_TIER_NONE },
+    { SYM_IMPL,              0, SYM_TIER_NONE },
+  };
+  const size_t nlookups = sizeof(lookups) / sizeof(lookups[0]);
+
+  // addresses resolved by dlopen64 before it stopped us; one bad address
+  // means the whole handoff is not to be trusted
+  bool handed_off = handoff_read(sf_handoff_path(), getpid(), base, lookups, nlookups);
+  if (handed_off && check_text(lookups, nlookups, text_lo, text_hi, "handoff", false) > 0) {
+    LOGE("ignoring handoff %s", sf_handoff_path());
+    for (size_t i = 0; i < nlookups; i++) {
+      lookups[i].addr = 0;
+      lookups[i].tier = SYM_TIER_NONE;
+    }
+    handed_off = false;
+  }
 
-  if(!hidlIsSupported) {
-    LOGE("hidlIsSupported symbol not found via .gnu_debugdata");
-    return;
+  if (handed_off) {
+    LOGI("hook addresses from handoff %s", sf_handoff_path());
+  } else {
+    // resolve every hook target: offset cache, the manifest of known
+    // builds, then .dynsym/.symtab, and .gnu_debugdata only for names still
+    // missing
+    resolver_set_budget(resolver_budget_prop());
+    resolve_addrs_cached(sf_bin_path(), sf_offset_cache_path(), sf_offset_manifest_path(),
+                         lookups, nlookups, base);
+    check_text(lookups, nlookups, text_lo, text_hi, "resolved", true);
+  }
+
+  void* hidlIsSupported = (void*)lookups[0].addr;
+  void* aidlIsSupported = (void*)lookups[1].addr;
+  void* getPhysicalDisplayOrientation = (void*)lookups[2].addr;
+
+  // a build has the HIDL composer, the AIDL one, or both
+  if(!hidlIsSupported && !aidlIsSupported) {
+    LOGE("neither hidlIsSupported nor aidlIsSupported symbol found");
+    return false;
   }
 
   if (!getPhysicalDisplayOrientation) {
-    LOGE("getPhysicalDisplayOrientation symbol not found via .gnu_debugdata");
-    return;
+    LOGE("getPhysicalDisplayOrientation symbol not found");
+    return false;
   }
 
   LOGV("surfaceflinger base @ 0x%lx", (unsigned long)base);
+
+  // snapshot the props before any hook can run
+  sf_config_init();
   LOGV("hidlIsSupported @ %p", hidlIsSupported);
+  LOGV("aidlIsSupported @ %p", aidlIsSupported);
   LOGV("getPhysicalDisplayOrientation @ %p", getPhysicalDisplayOrientation);
 
-  // install hooks (best-effort, some symbols may not exist)
-  auto hook = [&](void* sym, void* rep, void** orig, const char* name){
-    // crude probe: avoid crashing if offset is bogus
-    if (((uintptr_t)sym & 0xfff) == 0) {
-      LOGE("skip %s: looks nullish", name);
-      return;
-    }
-    A64HookFunction(sym, rep, orig);
-    LOGI("hooked %s @ %p", name, sym);
+  // install all hooks in one transaction: each code page is made writable
+  // once, gets its protection back afterwards, and either every hook goes
+  // in or none does
+  struct HookSpec { void* sym; void* rep; void** orig; const char* name; };
+  const HookSpec specs[] = {
+    { hidlIsSupported,               (void*)isSupportedHIDLHook,               (void**)&origHidlIsSupported,               SYM_HIDL_IS_SUPPORTED },
+    { aidlIsSupported,               (void*)isSupportedAIDLHook,               (void**)&origAidlIsSupported,               SYM_AIDL_IS_SUPPORTED },
+    { getPhysicalDisplayOrientation, (void*)getPhysicalDisplayOrientationHook, (void**)&origGetPhysicalDisplayOrientation, SYM_IMPL },
   };
 
-  hook(hidlIsSupported, (void*)isSupportedHIDLHook, (void**)&origHidlIsSupported, SYM_HIDL_IS_SUPPORTED);
-  hook(getPhysicalDisplayOrientation, (void*)getPhysicalDisplayOrientationHook,    (void**)&origGetPhysicalDisplayOrientation, SYM_IMPL);
+  A64HookTxn txn;
+  A64HookBegin(&txn);
+  txn.live = live;
+  int index[sizeof(specs) / sizeof(specs[0])];
+  for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+    const HookSpec& h = specs[i];
+    index[i] = -1;
+    if (!h.sym) {
+      continue; // a build has only one of the composers
+    }
+    index[i] = A64HookAdd(&txn, h.sym, h.rep, h.orig);
+  }
+
+  const int status = A64HookCommit(&txn);
+  if (status == A64_HOOK_ENOTATOMIC) {
+    LOGE("a hook needs a multi-word patch, which is not safe while surfaceflinger runs; "
+         "setprop persist.sfrotate.async_init 0 to hook inside the injection");
+  }
+  for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+    if (index[i] < 0) {
+      continue;
+    }
+    const int st = txn.hooks[index[i]].status;
+    if (st == A64_HOOK_OK) {
+      LOGI("hooked %s @ %p", specs[i].name, specs[i].sym);
+    } else {
+      LOGE("failed to hook %s @ %p (status %d)", specs[i].name, specs[i].sym, st);
+    }
+  }
+  return status == A64_HOOK_OK && txn.count > 0;
+}
 
-  LOGI("sfrotate ready");
+static std::atomic<int> g_init_state{SF_INIT_PENDING};
+
+extern "C" __attribute__((visibility("default")))
+int sfrotate_init_state() {
+  return g_init_state.load(std::memory_order_acquire);
+}
+
+static void run_init(bool live) {
+  bool ok = setup_sfrotate(live);
+  g_init_state.store(ok ? SF_INIT_READY : SF_INIT_FAILED, std::memory_order_release);
+  if (ok) {
+    LOGI("sfrotate ready");
+  } else {
+    LOGE("sfrotate init failed");
+  }
+}
+
+SF_BRPROT static void* init_worker(void*) {
+  // nice 10: the resolution work overlaps with composition instead of
+  // competing with it (0 = this thread)
+  setpriority(PRIO_PROCESS, 0, 10);
+  run_init(true);
+  return nullptr;
+}
+
+// persist.sfrotate.async_init: anything but "0" (default on)
+static bool async_init_enabled() {
+  char v[PROP_VALUE_MAX] = {0};
+  if (__system_property_get("persist.sfrotate.async_init", v) > 0){
+    return strcmp(v, "0") != 0;
+  }
+  return true;
+}
+
+// Runs under the linker lock inside the injector's dlopen(), while the
+// calling surfaceflinger thread is ptrace-stopped. In async mode it only
+// starts the init worker and returns; sfrotate_init_state() reports
+// progress.
+//
+// Async mode patches the hook targets after the injector has let
+// surfaceflinger go, while compositor threads may be running them. That
+// is only safe when every patch is one atomic B instruction, so the
+// worker's hook transaction is live: a hook that would need the multi-word
+// LDR/BR patch fails with A64_HOOK_ENOTATOMIC and nothing is hooked. Only
+// the inline path, inside the injector's stop window, may use that patch
+// (as it did before async init).
+SF_BRPROT __attribute__((constructor))
+static void init_sfrotate() {
+  LOGI("sfrotate init");
+  if (!async_init_enabled()) {
+    run_init(false);
+    return;
+  }
+
+  pthread_t t;
+  if (pthread_create(&t, nullptr, init_worker, nullptr) != 0) {
+    LOGE("could not start init worker, initializing inline");
+    run_init(false);
+    return;
+  }
+  pthread_setname_np(t, "sfrotate-init");
+  pthread_detach(t);
 }
@@ -6,9 +6,19 @@
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <atomic>
 
 #include "log.h"
 #include "gnu_debugdata_resolver.h"
+#include "sf_symbols.h"
+#include "module_map.h"
+#include "offset_cache.h"
+#include "sym_resolver.h"
+#include "handoff.h"
+#include "sf_config.h"
+#include "sf_stats.h"
 #include "And64InlineHook.hpp"
 
 #if defined(__aarch64__)
@@ -17,8 +27,6 @@
     #define SF_BRPROT
 #endif
 
-#define SURFACEFLINGER_BIN "/system/bin/surfaceflinger"
-
 // Hwc2::Composer::OptionalFeature::PhysicalDisplayOrientation
 enum OptionalFeature {
   PhysicalDisplayOrientation = 4,
@@ -38,16 +46,16 @@ enum Transform {
   ROT_270 = TF_ROT_90 | TF_FLIP_H | TF_FLIP_V
 };
 
-// symbols to hook - may vary between Android versions
-
-static const char* SYM_IMPL =
-  "_ZNK7android4impl10HWComposer29getPhysicalDisplayOrientationENS_17PhysicalDisplayIdE";
-
-static const char* SYM_HIDL_IS_SUPPORTED =
-  "_ZNK7android4Hwc212HidlComposer11isSupportedENS0_8Composer15OptionalFeatureE";
+// initialization progress, see sfrotate_init_state()
+enum SfInitState {
+  SF_INIT_PENDING = 0, // worker still resolving / hooking
+  SF_INIT_READY   = 1, // hooks installed
+  SF_INIT_FAILED  = 2, // nothing hooked, surfaceflinger is untouched
+};
 
-// (legacy, unused) - offsets
-static const uintptr_t OFF_AIDL_IS_SUPPORTED = 0x10f204; // _ZNK7android4Hwc212AidlComposer11isSupportedENS0_8Composer15OptionalFeatureE
+// Exported, so it can be queried with dlsym() (e.g. by
+// `dlopen64 <pid> libsf_rotate.so@sfrotate_init_state`).
+extern "C" int sfrotate_init_state();
 
 // hook function prototypes
 
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "sf_symbols.h"
+#include "sig_scan.h"
+
+// Byte signatures of the hook targets, for builds that ship without any
+// symbol for them (no .gnu_debugdata). Only consulted for names the symbol
+// tiers could not resolve; each row applies to one surfaceflinger build,
+// identified by its GNU build ID (`readelf -n`), or to every build if
+// build_id is nullptr. A signature must match exactly once in the
+// executable sections, otherwise it is ignored.
+//
+// To add a build: disassemble the function, take enough of its prologue to
+// be unique (typically 16-32 bytes), and replace immediates and registers
+// that change with the build by '?'. `offset` is the distance from the
+// start of the match to the function start.
+
+static const SigEntry SF_SIGNATURES[] = {
+  // { "<build id>", SYM_IMPL, "fd 7b bf a9 fd 03 00 91 ?? ?? ?? 94", 0 },
+  { nullptr, nullptr, nullptr, 0 },
+};
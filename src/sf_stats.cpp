@@ -0,0 +1,132 @@
+#include "sf_stats.h"
+
+#ifdef SFROTATE_STATS
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include "log.h"
+
+static const size_t STAT_SHARDS  = 8;
+static const size_t STAT_BUCKETS = 32; // bucket b: ticks in [2^(b-1), 2^b)
+
+static const char* const STAT_NAMES[STAT_COUNT] = {
+  "hidl.isSupported",
+  "hidl.isSupported.orig",
+  "aidl.isSupported",
+  "aidl.isSupported.orig",
+  "getPhysicalDisplayOrientation",
+  "getPhysicalDisplayOrientation.orig",
+};
+
+struct StatCell {
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> ticks;
+  std::atomic<uint64_t> hist[STAT_BUCKETS];
+};
+
+struct alignas(64) StatShard {
+  StatCell cells[STAT_COUNT];
+};
+
+static StatShard g_shards[STAT_SHARDS];
+static std::atomic<unsigned> g_next_shard{0};
+
+static size_t my_shard() {
+  // threads are spread round-robin the first time they record
+  static thread_local size_t shard = g_next_shard.fetch_add(1, std::memory_order_relaxed) % STAT_SHARDS;
+  return shard;
+}
+
+static size_t bucket_of(uint64_t ticks) {
+  size_t b = ticks ? (size_t)(64 - __builtin_clzll(ticks)) : 0;
+  return b < STAT_BUCKETS ? b : STAT_BUCKETS - 1;
+}
+
+void sf_stat_record(SfStat stat, uint64_t ticks) {
+  StatCell& c = g_shards[my_shard()].cells[stat];
+  c.calls.fetch_add(1, std::memory_order_relaxed);
+  c.ticks.fetch_add(ticks, std::memory_order_relaxed);
+  c.hist[bucket_of(ticks)].fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint64_t tick_hz() {
+#if defined(__aarch64__)
+  uint64_t hz;
+  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(hz));
+  return hz ? hz : 1;
+#else
+  return 1000000000ull;
+#endif
+}
+
+// Upper bound (ns) of the bucket holding the q-th quantile.
+static uint64_t quantile_ns(const uint64_t* hist, uint64_t calls, double q, uint64_t hz) {
+  uint64_t want = (uint64_t)((double)calls * q);
+  uint64_t seen = 0;
+  for (size_t b = 0; b < STAT_BUCKETS; b++) {
+    seen += hist[b];
+    if (seen > want) {
+      return (uint64_t)((double)(1ull << b) * 1e9 / (double)hz);
+    }
+  }
+  return 0;
+}
+
+bool sf_stats_dump(const char* path, bool reset) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    LOGE("stats: cannot write %s", path);
+    return false;
+  }
+  const uint64_t hz = tick_hz();
+  fprintf(f, "# sfrotate hook stats (timer %llu Hz)\n", (unsigned long long)hz);
+  fprintf(f, "%-36s %12s %10s %10s %10s\n", "path", "calls", "mean_ns", "p50_ns<=", "p99_ns<=");
+
+  for (size_t s = 0; s < STAT_COUNT; s++) {
+    uint64_t calls = 0, ticks = 0, hist[STAT_BUCKETS] = {};
+    for (auto& shard : g_shards) {
+      StatCell& c = shard.cells[s];
+      calls += c.calls.load(std::memory_order_relaxed);
+      ticks += c.ticks.load(std::memory_order_relaxed);
+      for (size_t b = 0; b < STAT_BUCKETS; b++) {
+        hist[b] += c.hist[b].load(std::memory_order_relaxed);
+      }
+    }
+    double mean = calls ? (double)ticks * 1e9 / (double)hz / (double)calls : 0;
+    fprintf(f, "%-36s %12llu %10.0f %10llu %10llu\n", STAT_NAMES[s],
+            (unsigned long long)calls, mean,
+            (unsigned long long)quantile_ns(hist, calls, 0.50, hz),
+            (unsigned long long)quantile_ns(hist, calls, 0.99, hz));
+    if (!calls) {
+      continue;
+    }
+    // histogram: <= bucket upper bound in ns, count
+    fprintf(f, "  hist");
+    for (size_t b = 0; b < STAT_BUCKETS; b++) {
+      if (hist[b]) {
+        fprintf(f, " %llu:%llu",
+                (unsigned long long)((double)(1ull << b) * 1e9 / (double)hz),
+                (unsigned long long)hist[b]);
+      }
+    }
+    fprintf(f, "\n");
+  }
+  fclose(f);
+
+  if (reset) {
+    // not atomic with respect to concurrent hooks: a call recorded while
+    // clearing may be split between the old and new counts
+    for (auto& shard : g_shards) {
+      for (auto& c : shard.cells) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.ticks.store(0, std::memory_order_relaxed);
+        for (auto& h : c.hist) h.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+  LOGI("stats written to %s%s", path, reset ? " (reset)" : "");
+  return true;
+}
+
+#endif
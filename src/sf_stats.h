@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+
+// Call counters and latency histograms for the hooks, and for the original
+// functions called through their trampolines. Built only with
+// -DSFROTATE_STATS=ON; otherwise SF_STAT_SCOPE() compiles to nothing, like
+// LOGV.
+//
+// Recording is lock-free: each thread adds to one of a few cache-line
+// aligned shards with relaxed atomics. Setting SFROTATE_STATS_PROP makes
+// the config watcher write the summed report to SFROTATE_STATS_FILE
+// ("reset" also clears the counters afterwards).
+
+#define SFROTATE_STATS_PROP "debug.sfrotate.stats_dump"
+#define SFROTATE_STATS_FILE "/data/local/tmp/sfrotate.stats"
+
+enum SfStat {
+  STAT_HIDL_HOOK,
+  STAT_HIDL_ORIG,
+  STAT_AIDL_HOOK,
+  STAT_AIDL_ORIG,
+  STAT_ORIENT_HOOK,
+  STAT_ORIENT_ORIG,
+  STAT_COUNT
+};
+
+#ifdef SFROTATE_STATS
+
+#include <time.h>
+
+// Raw timestamp: the arm64 generic timer (cntvct_el0, no vDSO call), or
+// CLOCK_MONOTONIC in ns elsewhere. The report converts ticks to ns.
+static inline uint64_t sf_stat_ticks() {
+#if defined(__aarch64__)
+  uint64_t t;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void sf_stat_record(SfStat stat, uint64_t ticks);
+
+struct SfStatScope {
+  SfStat   stat;
+  uint64_t t0;
+  explicit SfStatScope(SfStat s) : stat(s), t0(sf_stat_ticks()) {}
+  ~SfStatScope() { sf_stat_record(stat, sf_stat_ticks() - t0); }
+};
+
+#define SF_STAT_CAT_(a, b) a##b
+#define SF_STAT_CAT(a, b) SF_STAT_CAT_(a, b)
+// Count one call and time the rest of the enclosing scope.
+#define SF_STAT_SCOPE(stat) SfStatScope SF_STAT_CAT(sf_stat_scope_, __LINE__)(stat)
+
+// Write the report to path; reset clears the counters afterwards.
+bool sf_stats_dump(const char* path, bool reset);
+
+#else
+
+#define SF_STAT_SCOPE(stat) ((void)0)
+
+#endif
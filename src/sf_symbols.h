@@ -0,0 +1,44 @@
+#pragma once
+
+// shared by the library, the injector and the host tools
+
+#include <stdlib.h>
+
+#define SURFACEFLINGER_BIN "/system/bin/surfaceflinger"
+
+// resolved symbol offsets, reused across boots until surfaceflinger changes
+#define SFROTATE_OFFSET_CACHE "/data/local/tmp/sfrotate.cache"
+
+// offsets of known builds, generated offline by host/sf_offsets and copied
+// here by inject.sh along with the injector
+#define SFROTATE_OFFSET_MANIFEST "/data/local/tmp/sfrotate.offsets"
+
+// All three can be overridden from the environment, as can the handoff file
+// (handoff.h), so the e2e harness can point the injector and the library at
+// a stand-in surfaceflinger (see e2e/).
+
+static inline const char* sf_bin_path() {
+  const char* p = getenv("SFROTATE_SF_BIN");
+  return p && *p ? p : SURFACEFLINGER_BIN;
+}
+
+static inline const char* sf_offset_cache_path() {
+  const char* p = getenv("SFROTATE_OFFSET_CACHE");
+  return p && *p ? p : SFROTATE_OFFSET_CACHE;
+}
+
+static inline const char* sf_offset_manifest_path() {
+  const char* p = getenv("SFROTATE_OFFSET_MANIFEST");
+  return p && *p ? p : SFROTATE_OFFSET_MANIFEST;
+}
+
+// symbols to hook - may vary between Android versions
+
+static const char* const SYM_IMPL =
+  "_ZNK7android4impl10HWComposer29getPhysicalDisplayOrientationENS_17PhysicalDisplayIdE";
+
+static const char* const SYM_HIDL_IS_SUPPORTED =
+  "_ZNK7android4Hwc212HidlComposer11isSupportedENS0_8Composer15OptionalFeatureE";
+
+static const char* const SYM_AIDL_IS_SUPPORTED =
+  "_ZNK7android4Hwc212AidlComposer11isSupportedENS0_8Composer15OptionalFeatureE";
@@ -0,0 +1,393 @@
+#include "sig_scan.h"
+
+#include <elf.h>
+#include <link.h>
+#include <string.h>
+#include "log.h"
+#include "elf_view.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SIG_SCAN_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIG_SCAN_SSE2 1
+#endif
+
+static int hex_nibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// How likely a fixed byte is to be a poor filter in arm64 code, lower is
+// better. The top byte of an instruction (offset 3) is mostly opcode and
+// repeats a lot; 0x00 / 0xff are everywhere (zero immediates, xzr/sp).
+static int anchor_cost(const SigPattern& p, size_t i) {
+  int cost = (i & 3) == 3 ? 4 : (i & 3) == 2 ? 2 : 0;
+  if (p.bytes[i] == 0x00 || p.bytes[i] == 0xff) cost += 8;
+  return cost;
+}
+
+bool sig_parse(const char* text, SigPattern* out) {
+  memset(out, 0, sizeof(*out));
+  const char* s = text;
+  while (*s) {
+    if (*s == ' ') {
+      s++;
+      continue;
+    }
+    if (!s[1] || out->len == SIG_MAX_LEN) {
+      LOGE("bad signature \"%s\"", text);
+      return false;
+    }
+    uint8_t b = 0, m = 0;
+    for (int k = 0; k < 2; k++) {
+      const char c = s[k];
+      b <<= 4;
+      m <<= 4;
+      if (c == '?') {
+        continue;
+      }
+      int v = hex_nibble(c);
+      if (v < 0) {
+        LOGE("bad signature \"%s\"", text);
+        return false;
+      }
+      b |= (uint8_t)v;
+      m |= 0xf;
+    }
+    out->bytes[out->len] = b;
+    out->mask[out->len] = m;
+    out->len++;
+    s += 2;
+  }
+
+  // the two cheapest fully specified bytes
+  int best0 = -1, best1 = -1;
+  for (size_t i = 0; i < out->len; i++) {
+    if (out->mask[i] != 0xff) continue;
+    if (best0 < 0 || anchor_cost(*out, i) < anchor_cost(*out, (size_t)best0)) {
+      best1 = best0;
+      best0 = (int)i;
+    } else if (best1 < 0 || anchor_cost(*out, i) < anchor_cost(*out, (size_t)best1)) {
+      best1 = (int)i;
+    }
+  }
+  if (best0 < 0) {
+    LOGE("signature \"%s\" has no fixed byte", text);
+    return false;
+  }
+  out->a0 = (uint16_t)best0;
+  out->a1 = (uint16_t)(best1 < 0 ? best0 : best1);
+  return true;
+}
+
+static bool match_at(const uint8_t* d, const SigPattern& p) {
+  for (size_t i = 0; i < p.len; i++) {
+    if ((d[i] & p.mask[i]) != p.bytes[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void record(size_t pos, size_t* out, size_t max_out, size_t& found) {
+  if (found < max_out) {
+    out[found] = pos;
+  }
+  found++;
+}
+
+// Positions [from, to) one by one, memchr on the first anchor.
+static size_t scan_range(const uint8_t* data, size_t from, size_t to, const SigPattern& p,
+                         size_t align, size_t* out, size_t max_out, size_t found) {
+  const uint8_t b0 = p.bytes[p.a0];
+  size_t pos = from;
+  while (pos < to) {
+    const uint8_t* hit = (const uint8_t*)memchr(data + pos + p.a0, b0, to - pos);
+    if (!hit) {
+      break;
+    }
+    pos = (size_t)(hit - data) - p.a0;
+    if ((pos & (align - 1)) == 0 && match_at(data + pos, p)) {
+      record(pos, out, max_out, found);
+    }
+    pos++;
+  }
+  return found;
+}
+
+size_t sig_scan_scalar(const uint8_t* data, size_t size, const SigPattern& p, size_t align,
+                       size_t* out, size_t max_out) {
+  if (!p.len || size < p.len || align == 0) {
+    return 0;
+  }
+  return scan_range(data, 0, size - p.len + 1, p, align, out, max_out, 0);
+}
+
+#if SIG_SCAN_NEON || SIG_SCAN_SSE2
+
+// Bitmask of the lanes of d[0, 16) equal to b. NEON has no movemask: the
+// narrowing shift packs each lane into a nibble, so lanes are 4 bits apart.
+#if SIG_SCAN_NEON
+static const unsigned LANE_BITS = 4;
+
+static inline uint64_t eq_lanes(const uint8_t* d, uint8x16_t b) {
+  uint8x16_t eq = vceqq_u8(vld1q_u8(d), b);
+  return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+}
+#else
+static const unsigned LANE_BITS = 1;
+
+static inline uint64_t eq_lanes(const uint8_t* d, __m128i b) {
+  __m128i v = _mm_loadu_si128((const __m128i*)d);
+  return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, b));
+}
+#endif
+
+// lanes of a 16-byte block at an aligned start that are multiples of align
+static uint64_t aligned_lanes(size_t align) {
+  const uint64_t lane = LANE_BITS == 4 ? 0xf : 0x1;
+  uint64_t m = 0;
+  for (size_t i = 0; i < 16; i += align) {
+    m |= lane << (i * LANE_BITS);
+  }
+  return m;
+}
+
+size_t sig_scan(const uint8_t* data, size_t size, const SigPattern& p, size_t align,
+                size_t* out, size_t max_out) {
+  if (!p.len || size < p.len || align == 0) {
+    return 0;
+  }
+  const size_t end = size - p.len + 1; // one past the last start
+#if SIG_SCAN_NEON
+  const uint8x16_t b0 = vdupq_n_u8(p.bytes[p.a0]);
+  const uint8x16_t b1 = vdupq_n_u8(p.bytes[p.a1]);
+#else
+  const __m128i b0 = _mm_set1_epi8((char)p.bytes[p.a0]);
+  const __m128i b1 = _mm_set1_epi8((char)p.bytes[p.a1]);
+#endif
+  const uint64_t keep = align < 16 ? aligned_lanes(align) : (LANE_BITS == 4 ? 0xf : 0x1);
+
+  size_t found = 0;
+  size_t pos = 0;
+  // 16 starts per block; every byte the block reads lies inside the pattern
+  // extent of one of them, so a block is safe while its last start fits
+  for (; pos + 16 <= end; pos += 16) {
+    uint64_t m = eq_lanes(data + pos + p.a0, b0) & eq_lanes(data + pos + p.a1, b1) & keep;
+    while (m) {
+      const size_t lane = (size_t)__builtin_ctzll(m) / LANE_BITS;
+      if (match_at(data + pos + lane, p)) {
+        record(pos + lane, out, max_out, found);
+      }
+      m &= ~((LANE_BITS == 4 ? 0xfull : 0x1ull) << (lane * LANE_BITS));
+    }
+  }
+  return scan_range(data, pos, end, p, align, out, max_out, found);
+}
+
+const char* sig_scan_impl() {
+#if SIG_SCAN_NEON
+  return "neon";
+#else
+  return "sse2";
+#endif
+}
+
+#else
+
+size_t sig_scan(const uint8_t* data, size_t size, const SigPattern& p, size_t align,
+                size_t* out, size_t max_out) {
+  return sig_scan_scalar(data, size, p, align, out, max_out);
+}
+
+const char* sig_scan_impl() {
+  return "scalar";
+}
+
+#endif
+
+static void hex(const uint8_t* id, size_t len, char* out, size_t cap) {
+  static const char HEX[] = "0123456789abcdef";
+  size_t n = 0;
+  for (size_t i = 0; i < len && n + 2 < cap; i++) {
+    out[n++] = HEX[id[i] >> 4];
+    out[n++] = HEX[id[i] & 15];
+  }
+  out[n] = 0;
+}
+
+// Code to scan: size bytes at data, which the binary places at vaddr.
+struct CodeRange {
+  const uint8_t* data;
+  size_t         size;
+  uint64_t       vaddr;
+};
+
+static const size_t SIG_MAX_RANGES = 16;
+
+// The executable sections of elf.
+static size_t file_code_ranges(const ElfView& elf, CodeRange* out) {
+  const auto* eh = elf.as_ehdr();
+  size_t n = 0;
+  for (uint16_t i = 0; eh && i < eh->e_shnum && n < SIG_MAX_RANGES; i++) {
+    const auto* sh = elf.shdr(i);
+    if (!sh || sh->sh_type != SHT_PROGBITS || !(sh->sh_flags & SHF_EXECINSTR)) {
+      continue;
+    }
+    const uint8_t* d = elf.section_data(sh);
+    if (d) {
+      out[n++] = { d, sh->sh_size, sh->sh_addr };
+    }
+  }
+  return n;
+}
+
+struct MemQuery {
+  uintptr_t      base;
+  const uint8_t* build_id; // the file's
+  size_t         build_id_len;
+  CodeRange*     out;
+  size_t         n;
+};
+
+// NT_GNU_BUILD_ID in the PT_NOTE segments of a loaded module.
+static bool mem_build_id(const struct dl_phdr_info* info, const uint8_t** id, size_t* len) {
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+    if (ph.p_type != PT_NOTE) {
+      continue;
+    }
+    const uint8_t* p = (const uint8_t*)(info->dlpi_addr + ph.p_vaddr);
+    const uint8_t* end = p + ph.p_memsz;
+    while (p + sizeof(Elf64_Nhdr) <= end) {
+      const auto* nh = (const Elf64_Nhdr*)p;
+      const uint8_t* name = p + sizeof(Elf64_Nhdr);
+      const uint8_t* desc = name + ((nh->n_namesz + 3) & ~3u);
+      const uint8_t* next = desc + ((nh->n_descsz + 3) & ~3u);
+      if (next > end) {
+        break;
+      }
+      if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+        *id = desc;
+        *len = nh->n_descsz;
+        return true;
+      }
+      p = next;
+    }
+  }
+  return false;
+}
+
+static int mem_cb(struct dl_phdr_info* info, size_t, void* data) {
+  MemQuery& q = *(MemQuery*)data;
+  if (info->dlpi_addr != q.base) {
+    return 0;
+  }
+  // the same base in another process (dlopen64) is a different module
+  const uint8_t* id;
+  size_t len;
+  if (!mem_build_id(info, &id, &len) || len != q.build_id_len ||
+      memcmp(id, q.build_id, len) != 0) {
+    return 1;
+  }
+  size_t n = 0;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+    if (ph.p_type != PT_LOAD || !(ph.p_flags & PF_X)) {
+      continue;
+    }
+    if (!(ph.p_flags & PF_R) || n == SIG_MAX_RANGES) {
+      return 1; // execute-only code cannot be read: use the file
+    }
+    q.out[n++] = { (const uint8_t*)(info->dlpi_addr + ph.p_vaddr), (size_t)ph.p_filesz, ph.p_vaddr };
+  }
+  q.n = n;
+  return 1;
+}
+
+// The executable segments of the module loaded at runtime_base, where this
+// process has them mapped, if it has that module loaded and its build ID is
+// the file's. This is the code as it runs, including binaries whose section
+// headers are stripped or do not describe all of it.
+static size_t mem_code_ranges(uintptr_t runtime_base, const uint8_t* build_id, size_t build_id_len,
+                              CodeRange* out) {
+  if (!runtime_base || !build_id_len) {
+    return 0;
+  }
+  MemQuery q{ runtime_base, build_id, build_id_len, out, 0 };
+  dl_iterate_phdr(mem_cb, &q);
+  return q.n;
+}
+
+// Total number of matches of p in ranges, and the vaddr of the first one.
+static size_t scan_ranges(const CodeRange* ranges, size_t n, const SigPattern& p, uint64_t* vaddr) {
+  size_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t pos;
+    size_t found = sig_scan(ranges[i].data, ranges[i].size, p, 4, &pos, 1);
+    if (found && !total) {
+      *vaddr = ranges[i].vaddr + pos;
+    }
+    total += found;
+  }
+  return total;
+}
+
+size_t resolve_addrs_by_signature(const char* exe_path,
+                                  const SigEntry* table,
+                                  GnuDebugLookup* lookups,
+                                  size_t count,
+                                  uintptr_t runtime_base) {
+  ElfView elf;
+  if (!table || !elf.map_file(exe_path)) {
+    return 0;
+  }
+  const uint8_t* id = nullptr;
+  size_t id_len = 0;
+  char build_id[2 * 32 + 1] = "";
+  if (elf.build_id(&id, &id_len)) {
+    hex(id, id_len, build_id, sizeof build_id);
+  }
+
+  CodeRange ranges[SIG_MAX_RANGES];
+  size_t nranges = mem_code_ranges(runtime_base, id, id_len, ranges);
+  const bool in_memory = nranges > 0;
+  if (!in_memory) {
+    nranges = file_code_ranges(elf, ranges);
+  }
+
+  size_t resolved = 0;
+  for (const SigEntry* e = table; e->pattern; e++) {
+    if (e->build_id && strcmp(e->build_id, build_id) != 0) {
+      continue;
+    }
+    GnuDebugLookup* l = nullptr;
+    for (size_t j = 0; j < count; j++) {
+      if (!lookups[j].addr && strcmp(lookups[j].mangled_name, e->symbol) == 0) {
+        l = &lookups[j];
+        break;
+      }
+    }
+    SigPattern p;
+    if (!l || !sig_parse(e->pattern, &p)) {
+      continue;
+    }
+
+    uint64_t vaddr = 0;
+    size_t n = scan_ranges(ranges, nranges, p, &vaddr);
+    if (n != 1) {
+      LOGE("signature for %s matched %zu times, ignoring it", e->symbol, n);
+      continue;
+    }
+    l->addr = runtime_base + (uintptr_t)(vaddr + e->offset);
+    l->tier = SYM_TIER_SIGNATURE;
+    resolved++;
+    LOGV("  %s  vaddr=0x%lx (signature, %s)", l->mangled_name, (unsigned long)(vaddr + e->offset),
+         in_memory ? "mapped code" : "file");
+  }
+  return resolved;
+}
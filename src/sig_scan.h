@@ -0,0 +1,59 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gnu_debugdata_resolver.h"
+
+// Masked byte-pattern search over code, for builds whose hook targets have
+// no symbol anywhere (no .dynsym entry, no .symtab, no .gnu_debugdata).
+
+#define SIG_MAX_LEN 64
+
+// A parsed pattern. a0 / a1 are two fully specified bytes picked as
+// anchors: candidates are the positions where both match, and only those
+// are compared in full.
+struct SigPattern {
+  uint8_t  bytes[SIG_MAX_LEN];
+  uint8_t  mask[SIG_MAX_LEN];
+  uint16_t len;
+  uint16_t a0, a1;
+};
+
+// Parses "fd 7b bf a9 ?? 03 00 91 1?" style text: two hex digits per byte,
+// '?' for an unknown nibble. At least one byte must be fully specified.
+bool sig_parse(const char* text, SigPattern* out);
+
+// Positions (multiples of align, a power of two) in data[0, size) where p
+// matches. Writes the first max_out of them to out and returns the total
+// number of matches. Uses NEON (SSE2 on x86 hosts) where available.
+size_t sig_scan(const uint8_t* data, size_t size, const SigPattern& p, size_t align,
+                size_t* out, size_t max_out);
+
+// Same result, scalar only (memchr on the first anchor).
+size_t sig_scan_scalar(const uint8_t* data, size_t size, const SigPattern& p, size_t align,
+                       size_t* out, size_t max_out);
+
+// Name of the vector path sig_scan() uses, or "scalar".
+const char* sig_scan_impl();
+
+// One row of a signature table (see sf_signatures.h).
+struct SigEntry {
+  const char* build_id; // lowercase hex NT_GNU_BUILD_ID, nullptr for any build
+  const char* symbol;   // mangled name of the lookup it answers
+  const char* pattern;  // sig_parse() syntax
+  int32_t     offset;   // function start relative to the start of the match
+};
+
+// Resolves the lookups still missing from the rows of table (terminated by
+// a row with a null pattern) that apply to exe_path's build ID. If this
+// process has that build loaded at runtime_base (the library resolving
+// surfaceflinger from inside it), its executable segments are scanned where
+// they are mapped; otherwise (dlopen64, host tools) the executable sections
+// of the file. A pattern must match exactly once. Lookups found get tier
+// SYM_TIER_SIGNATURE and addr runtime_base + vaddr.
+// Returns the number of lookups it resolved.
+size_t resolve_addrs_by_signature(const char* exe_path,
+                                  const SigEntry* table,
+                                  GnuDebugLookup* lookups,
+                                  size_t count,
+                                  uintptr_t runtime_base);
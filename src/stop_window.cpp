@@ -0,0 +1,46 @@
+#include "stop_window.h"
+
+#include <stdio.h>
+#include "log.h"
+
+void StopWindow::start(uint64_t t) {
+  nphases = 0;
+  t_start = t_mark = t;
+}
+
+void StopWindow::phase(uint64_t t, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vphase(t, fmt, ap);
+  va_end(ap);
+}
+
+void StopWindow::vphase(uint64_t t, const char* fmt, va_list ap) {
+  if (nphases < MAX_PHASES) {
+    Phase& ph = phases[nphases++];
+    vsnprintf(ph.name, sizeof ph.name, fmt, ap);
+    ph.ns = t - t_mark;
+  } else {
+    Phase& ph = phases[MAX_PHASES - 1];
+    snprintf(ph.name, sizeof ph.name, "(later phases)");
+    ph.ns += t - t_mark;
+  }
+  t_mark = t;
+}
+
+void StopWindow::report() const {
+  LOGI("stopped time per phase:");
+  for (size_t i = 0; i < nphases; i++) {
+    LOGI("  %-40s %9.3f ms", phases[i].name, (double)phases[i].ns / 1e6);
+  }
+  LOGI("  %-40s %9.3f ms", "stop window (interrupt to detach)", (double)stopped_ns() / 1e6);
+}
+
+int StopWindow::budget_status(int rc, double budget_ms) const {
+  const double stopped_ms = (double)stopped_ns() / 1e6;
+  if (budget_ms <= 0 || stopped_ms <= budget_ms) {
+    return rc;
+  }
+  LOGE("stop window %.3f ms over budget of %.3f ms", stopped_ms, budget_ms);
+  return rc == 0 ? STOP_OVER_BUDGET : rc;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Time an injected process spends stopped (dlopen64), split into named
+// phases. Timestamps are passed in rather than read here, so the accounting
+// can be checked with made-up timings on a host (host/stop_window_check.cpp).
+
+// dlopen64's exit status for a stop window over --budget-ms
+static const int STOP_OVER_BUDGET = 13;
+
+struct StopWindow {
+  static const size_t MAX_PHASES = 64;
+  struct Phase { char name[96]; uint64_t ns; };
+
+  Phase    phases[MAX_PHASES];
+  size_t   nphases{0};
+  uint64_t t_start{0};
+  uint64_t t_mark{0};
+
+  // The target stopped at t; clears any earlier phases.
+  void start(uint64_t t);
+
+  // Close the current phase at t: the time since the previous mark. Past
+  // MAX_PHASES the rest is added up in the last one, so the phases always
+  // sum to the stop window.
+  void phase(uint64_t t, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+  void vphase(uint64_t t, const char* fmt, va_list ap) __attribute__((format(printf, 3, 0)));
+
+  // Start to the last phase.
+  uint64_t stopped_ns() const { return t_mark - t_start; }
+
+  // One line per phase and the total, with LOGI.
+  void report() const;
+
+  // rc, or STOP_OVER_BUDGET if rc is 0 and the window took longer than
+  // budget_ms (0: no budget).
+  int budget_status(int rc, double budget_ms) const;
+};
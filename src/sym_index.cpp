@@ -0,0 +1,143 @@
+#include "sym_index.h"
+
+#include <string.h>
+#include "log.h"
+
+const char* SymtabView::func_name(size_t i) const {
+  const Elf64_Sym& s = sym[i];
+  if (s.st_name == 0 || s.st_name >= str_size) {
+    return nullptr;
+  }
+  if (ELF64_ST_TYPE(s.st_info) != STT_FUNC) {
+    return nullptr;
+  }
+  if (s.st_shndx == SHN_UNDEF) {
+    return nullptr;
+  }
+  const char* nm = str + s.st_name;
+  // the name must end inside .strtab
+  if (!*nm || !memchr(nm, 0, str_size - s.st_name)) {
+    return nullptr;
+  }
+  return nm;
+}
+
+bool SymIndex::build(const SymtabView& view) {
+  st = view;
+  entries = 0;
+  if (st.count >= UINT32_MAX) {
+    LOGE("symbol table too large to index");
+    return false;
+  }
+
+  size_t funcs = 0;
+  for (size_t i = 0; i < st.count; i++) {
+    if (st.func_name(i)) funcs++;
+  }
+
+  // keep the load factor at or below 1/2
+  size_t cap = 16;
+  while (cap < funcs * 2) cap <<= 1;
+  slots.clear();
+  if (!slots.resize(cap)) {
+    LOGE("no memory for a %zu slot symbol index", cap);
+    return false;
+  }
+  mask = cap - 1;
+
+  // insert in symbol order; linear probing keeps the first duplicate first
+  for (size_t i = 0; i < st.count; i++) {
+    const char* nm = st.func_name(i);
+    if (!nm) {
+      continue;
+    }
+    uint32_t h = elf_gnu_hash(nm);
+    size_t p = h & mask;
+    while (slots[p].idx != 0) {
+      p = (p + 1) & mask;
+    }
+    slots[p].hash = h;
+    slots[p].idx = (uint32_t)(i + 1);
+    entries++;
+  }
+  LOGV("symbol index: %zu functions, %zu slots", entries, cap);
+  return entries > 0;
+}
+
+const Elf64_Sym* SymIndex::find(const char* name) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+  uint32_t h = elf_gnu_hash(name);
+  for (size_t p = h & mask; slots[p].idx != 0; p = (p + 1) & mask) {
+    if (slots[p].hash != h) {
+      continue;
+    }
+    const Elf64_Sym* s = &st.sym[slots[p].idx - 1];
+    if (strcmp(st.str + s->st_name, name) == 0) {
+      return s;
+    }
+  }
+  return nullptr;
+}
+
+bool GnuHashView::init(const uint8_t* data, size_t size, const SymtabView& dynsym) {
+  st = dynsym;
+  nbuckets = 0;
+  if (!data || size < 16 || ((uintptr_t)data & 7) != 0) {
+    return false;
+  }
+  const uint32_t* hdr = (const uint32_t*)data;
+  uint32_t nb = hdr[0], off = hdr[1], bsize = hdr[2], shift = hdr[3];
+  if (nb == 0 || bsize == 0 || off > st.count) {
+    LOGE(".gnu.hash header invalid");
+    return false;
+  }
+  uint64_t need = 16 + (uint64_t)bsize * 8 + (uint64_t)nb * 4 + (uint64_t)(st.count - off) * 4;
+  if (need > size) {
+    LOGE(".gnu.hash truncated");
+    return false;
+  }
+  bloom       = (const uint64_t*)(data + 16);
+  buckets     = (const uint32_t*)(bloom + bsize);
+  chain       = buckets + nb;
+  symoffset   = off;
+  bloom_size  = bsize;
+  bloom_shift = shift;
+  nbuckets    = nb;
+  return true;
+}
+
+const Elf64_Sym* GnuHashView::find(const char* name) const {
+  if (nbuckets == 0) {
+    return nullptr;
+  }
+  uint32_t h = elf_gnu_hash(name);
+
+  uint64_t word = bloom[(h / 64) % bloom_size];
+  uint64_t bits = (1ull << (h % 64)) | (1ull << ((h >> bloom_shift) % 64));
+  if ((word & bits) != bits) {
+    return nullptr;
+  }
+
+  // bucket 0 is empty (symbol 0 is the null symbol, even when the chain
+  // covers it: symoffset 0); chain entries are the symbol hashes with bit 0
+  // marking the chain end
+  const size_t first = buckets[h % nbuckets];
+  if (first == 0) {
+    return nullptr;
+  }
+  for (size_t i = first; i >= symoffset && i < st.count; i++) {
+    uint32_t h2 = chain[i - symoffset];
+    if ((h | 1) == (h2 | 1)) {
+      const char* nm = st.func_name(i);
+      if (nm && strcmp(nm, name) == 0) {
+        return &st.sym[i];
+      }
+    }
+    if (h2 & 1) {
+      break;
+    }
+  }
+  return nullptr;
+}
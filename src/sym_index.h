@@ -0,0 +1,66 @@
+#pragma once
+#include <elf.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Hash function of DT_GNU_HASH sections (h * 33 + c).
+static inline uint32_t elf_gnu_hash(const char* s) {
+  uint32_t h = 5381;
+  for (const uint8_t* p = (const uint8_t*)s; *p; p++) {
+    h = h * 33 + *p;
+  }
+  return h;
+}
+
+// A .symtab and its .strtab inside some ELF image (borrowed, no copies).
+struct SymtabView {
+  const Elf64_Sym* sym{nullptr};
+  size_t           count{0};
+  const char*      str{nullptr};
+  size_t           str_size{0};
+
+  // Name of symbol i if it is a defined function, otherwise nullptr.
+  const char* func_name(size_t i) const;
+};
+
+// Open-addressed hash table over the defined STT_FUNC symbols of a
+// SymtabView. Slots only hold a hash and a symbol index; names are compared
+// in place in .strtab, so building the index is a single allocation
+// (arena_alloc(), see arena.h).
+// The SymtabView (and the image behind it) must outlive the index.
+struct SymIndex {
+  bool build(const SymtabView& st);
+  // First defined function called name, or nullptr.
+  const Elf64_Sym* find(const char* name) const;
+  size_t size() const { return entries; }
+
+private:
+  struct Slot {
+    uint32_t hash;
+    uint32_t idx;   // symbol index + 1, 0 = empty slot
+  };
+  SymtabView        st;
+  ArenaArray<Slot>  slots;
+  size_t            mask{0};
+  size_t            entries{0};
+};
+
+// DT_GNU_HASH table (.gnu.hash) over its .dynsym, read in place. Lookups
+// check the bloom filter first, so most misses never touch .dynstr.
+struct GnuHashView {
+  bool init(const uint8_t* data, size_t size, const SymtabView& dynsym);
+  // Defined function called name, or nullptr.
+  const Elf64_Sym* find(const char* name) const;
+
+private:
+  SymtabView      st;
+  uint32_t        nbuckets{0};
+  uint32_t        symoffset{0};
+  uint32_t        bloom_size{0};
+  uint32_t        bloom_shift{0};
+  const uint64_t* bloom{nullptr};
+  const uint32_t* buckets{nullptr};
+  const uint32_t* chain{nullptr}; // hash values of symbols symoffset..count
+};
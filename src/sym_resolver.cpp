@@ -0,0 +1,173 @@
+#include "sym_resolver.h"
+
+#include <elf.h>
+#include <string.h>
+#include "arena.h"
+#include "log.h"
+#include "elf_view.h"
+#include "sf_signatures.h"
+#include "sym_index.h"
+
+// Symbol table in section sh, with its string table from sh_link.
+static bool symtab_of(const ElfView& elf, const Elf64_Shdr* sh, SymtabView& out) {
+  if (!sh || sh->sh_entsize != sizeof(Elf64_Sym)) {
+    return false;
+  }
+  const Elf64_Shdr* strsec = elf.shdr(sh->sh_link);
+  const uint8_t* symdat = elf.section_data(sh);
+  const uint8_t* strdat = elf.section_data(strsec);
+  if (!symdat || !strdat) {
+    return false;
+  }
+  out.sym      = (const Elf64_Sym*)symdat;
+  out.count    = sh->sh_size / sizeof(Elf64_Sym);
+  out.str      = (const char*)strdat;
+  out.str_size = strsec->sh_size;
+  return true;
+}
+
+static const Elf64_Shdr* find_section_type(const ElfView& elf, uint32_t type) {
+  const auto* eh = elf.as_ehdr();
+  if (!eh) return nullptr;
+  for (uint16_t i = 0; i < eh->e_shnum; i++) {
+    const auto* sh = elf.shdr(i);
+    if (sh && sh->sh_type == type) {
+      return sh;
+    }
+  }
+  return nullptr;
+}
+
+static void set(GnuDebugLookup& l, const Elf64_Sym* s, uintptr_t runtime_base, SymTier tier) {
+  l.addr = runtime_base + (uintptr_t)s->st_value;
+  l.tier = tier;
+  LOGV("  %s  value=0x%lx (%s)", l.mangled_name, (unsigned long)s->st_value, sym_tier_name(tier));
+}
+
+// Single pass over st for the lookups still unresolved, stopping once all
+// are found. Returns how many are left.
+static size_t scan_symtab(const SymtabView& st, GnuDebugLookup* lookups, size_t count,
+                          size_t remaining, uintptr_t runtime_base, SymTier tier) {
+  for (size_t i = 0; i < st.count && remaining > 0; i++) {
+    const char* nm = st.func_name(i);
+    if (!nm) {
+      continue;
+    }
+    for (size_t j = 0; j < count; j++) {
+      if (lookups[j].addr || strcmp(nm, lookups[j].mangled_name) != 0) {
+        continue;
+      }
+      set(lookups[j], &st.sym[i], runtime_base, tier);
+      remaining--;
+      break;
+    }
+  }
+  return remaining;
+}
+
+// Tier 1: the dynamic symbol table.
+static size_t lookup_dynsym(const ElfView& elf, GnuDebugLookup* lookups, size_t count,
+                            size_t remaining, uintptr_t runtime_base) {
+  SymtabView dyn;
+  if (!symtab_of(elf, find_section_type(elf, SHT_DYNSYM), dyn)) {
+    return remaining;
+  }
+
+  const Elf64_Shdr* gh = find_section_type(elf, SHT_GNU_HASH);
+  GnuHashView hash;
+  if (!gh || !hash.init(elf.section_data(gh), gh->sh_size, dyn)) {
+    return scan_symtab(dyn, lookups, count, remaining, runtime_base, SYM_TIER_DYNSYM);
+  }
+
+  for (size_t j = 0; j < count && remaining > 0; j++) {
+    if (lookups[j].addr) {
+      continue;
+    }
+    if (const Elf64_Sym* s = hash.find(lookups[j].mangled_name)) {
+      set(lookups[j], s, runtime_base, SYM_TIER_DYNSYM);
+      remaining--;
+    }
+  }
+  return remaining;
+}
+
+// Tier 2: a .symtab left in the binary (not stripped).
+static size_t lookup_symtab(const ElfView& elf, GnuDebugLookup* lookups, size_t count,
+                            size_t remaining, uintptr_t runtime_base) {
+  SymtabView st;
+  if (!symtab_of(elf, find_section_type(elf, SHT_SYMTAB), st)) {
+    return remaining;
+  }
+  return scan_symtab(st, lookups, count, remaining, runtime_base, SYM_TIER_SYMTAB);
+}
+
+// Tier 3: .gnu_debugdata, for just the names still missing.
+static size_t lookup_debugdata(const char* exe_path, GnuDebugLookup* lookups, size_t count,
+                               size_t remaining, uintptr_t runtime_base) {
+  ArenaArray<GnuDebugLookup> missing;
+  ArenaArray<size_t> slot;
+  if (!missing.reserve(remaining) || !slot.reserve(remaining)) {
+    return remaining;
+  }
+  for (size_t j = 0; j < count; j++) {
+    if (!lookups[j].addr) {
+      missing.push_back(lookups[j]);
+      slot.push_back(j);
+    }
+  }
+
+  size_t found = resolve_addrs_from_gnu_debugdata(exe_path, missing.data(), missing.size(),
+                                                  runtime_base);
+  for (size_t k = 0; k < missing.size(); k++) {
+    lookups[slot[k]] = missing[k];
+  }
+  return remaining - found;
+}
+
+static size_t g_budget = RESOLVER_BUDGET_DEFAULT;
+
+void resolver_set_budget(size_t bytes) {
+  g_budget = bytes;
+}
+
+size_t resolver_budget() {
+  return g_budget;
+}
+
+size_t resolve_addrs(const char* exe_path,
+                     GnuDebugLookup* lookups,
+                     size_t count,
+                     uintptr_t runtime_base) {
+  ArenaScope arena("resolver", g_budget);
+  for (size_t j = 0; j < count; j++) {
+    lookups[j].addr = 0;
+    lookups[j].tier = SYM_TIER_NONE;
+  }
+  size_t remaining = count;
+
+  {
+    ElfView elf;
+    if (elf.map_file(exe_path)) {
+      remaining = lookup_dynsym(elf, lookups, count, remaining, runtime_base);
+      if (remaining > 0) {
+        remaining = lookup_symtab(elf, lookups, count, remaining, runtime_base);
+      }
+    }
+  }
+
+  if (remaining > 0) {
+    LOGV("%zu of %zu names not in .dynsym/.symtab, trying .gnu_debugdata", remaining, count);
+    remaining = lookup_debugdata(exe_path, lookups, count, remaining, runtime_base);
+  }
+
+  if (remaining > 0) {
+    LOGV("%zu of %zu names have no symbol, trying signatures", remaining, count);
+    remaining -= resolve_addrs_by_signature(exe_path, SF_SIGNATURES, lookups, count,
+                                            runtime_base);
+  }
+
+  for (size_t j = 0; j < count; j++) {
+    LOGI("%s: %s", lookups[j].mangled_name, sym_tier_name(lookups[j].tier));
+  }
+  return count - remaining;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gnu_debugdata_resolver.h"
+
+// Layered symbol resolution for an on-disk binary, cheapest tier first:
+//   1. .gnu.hash / .dynsym (O(1) per name; plain .dynsym scan without it)
+//   2. an uncompressed .symtab, if the binary still has one
+//   3. .gnu_debugdata, decompressed only when names are still missing
+//   4. byte signatures of the code (sf_signatures.h), for stripped builds,
+//      scanned where it is mapped when resolving in-process
+// Each lookup's tier records which one answered it.
+// Everything it allocates comes from one arena (see arena.h) of
+// resolver_budget() bytes, unmapped before it returns. A tier that would
+// need more fails, and the next one is tried.
+// Returns the number of lookups that were resolved.
+size_t resolve_addrs(const char* exe_path,
+                     GnuDebugLookup* lookups,
+                     size_t count,
+                     uintptr_t runtime_base);
+
+// A full .gnu_debugdata decode of surfaceflinger needs a few MB; streaming a
+// few names (the hooks) well under 1 MB.
+static const size_t RESOLVER_BUDGET_DEFAULT = 32 << 20;
+
+// Memory budget of resolve_addrs(), RESOLVER_BUDGET_DEFAULT until set. 0
+// turns the arena off (plain malloc, no limit).
+void resolver_set_budget(size_t bytes);
+size_t resolver_budget();
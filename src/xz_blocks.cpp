@@ -0,0 +1,248 @@
+#include "xz_blocks.h"
+
+#include <string.h>
+#include <time.h>
+#include "log.h"
+
+extern "C" {
+#include "xz.h"
+}
+
+static const size_t XZ_HEADER_SIZE  = 12;         // Stream Header / Footer
+static const uint64_t XZ_MAX_OUTPUT = 1ull << 28; // sanity cap for the index
+static const uint32_t XZ_DICT_MAX   = 1u << 26;   // larger declared dictionaries fail
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void xz_init_once() {
+  // a function-local static is initialized once, even with several threads
+  static const bool xz_inited = (xz_crc32_init(), xz_crc64_init(), true);
+  (void)xz_inited;
+}
+
+static uint32_t get_le32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// .xz variable-length integer (7 bits per byte, at most 9 bytes)
+static bool xz_varint(const uint8_t* p, size_t len, size_t* pos, uint64_t* out) {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < 9 && *pos < len; i++) {
+    uint8_t c = p[(*pos)++];
+    v |= (uint64_t)(c & 0x7f) << (i * 7);
+    if (!(c & 0x80)) {
+      *out = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool xz_read_index(const uint8_t* in, size_t in_len, ArenaArray<XzBlock>& blocks) {
+  blocks.clear();
+  xz_init_once();
+
+  // drop Stream Padding (multiple of four NUL bytes) after the footer
+  while (in_len >= XZ_HEADER_SIZE + 4 && get_le32(in + in_len - 4) == 0) {
+    in_len -= 4;
+  }
+  if (in_len < 2 * XZ_HEADER_SIZE) {
+    return false;
+  }
+
+  const uint8_t* footer = in + in_len - XZ_HEADER_SIZE;
+  if (footer[10] != 'Y' || footer[11] != 'Z') {
+    return false;
+  }
+  if (xz_crc32(footer + 4, 6, 0) != get_le32(footer)) {
+    return false;
+  }
+
+  const uint64_t index_size = ((uint64_t)get_le32(footer + 4) + 1) * 4;
+  if (index_size > in_len - 2 * XZ_HEADER_SIZE) {
+    return false;
+  }
+  const uint8_t* index = footer - index_size;
+  const size_t crc_pos = (size_t)index_size - 4;
+  if (index[0] != 0x00 || xz_crc32(index, crc_pos, 0) != get_le32(index + crc_pos)) {
+    return false;
+  }
+
+  size_t pos = 1;
+  uint64_t records = 0, in_off = XZ_HEADER_SIZE, out_off = 0;
+  if (!xz_varint(index, crc_pos, &pos, &records) || records > crc_pos) {
+    return false;
+  }
+  if (!blocks.reserve((size_t)records)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < records; i++) {
+    uint64_t unpadded = 0, uncompressed = 0;
+    if (!xz_varint(index, crc_pos, &pos, &unpadded) ||
+        !xz_varint(index, crc_pos, &pos, &uncompressed)) {
+      blocks.clear();
+      return false;
+    }
+    const uint64_t padded = (unpadded + 3) & ~3ull;
+    if (padded > in_len || in_off + padded > in_len ||
+        uncompressed > XZ_MAX_OUTPUT || out_off + uncompressed > XZ_MAX_OUTPUT) {
+      blocks.clear();
+      return false;
+    }
+    blocks.push_back({ (size_t)in_off, (size_t)padded, out_off, uncompressed });
+    in_off += padded;
+    out_off += uncompressed;
+  }
+
+  // header + blocks + index + footer must cover the whole buffer, otherwise
+  // this is a concatenation of streams and the index only describes the last
+  if (in_off + index_size + XZ_HEADER_SIZE != in_len) {
+    blocks.clear();
+    return false;
+  }
+  return true;
+}
+
+XzBlockReader::~XzBlockReader() {
+  if (dec_) {
+    xz_dec_end(dec_);
+  }
+}
+
+bool XzBlockReader::init(const uint8_t* in, size_t in_len) {
+  if (!xz_read_index(in, in_len, blocks_)) {
+    return false;
+  }
+  in_ = in;
+  if (!dec_) {
+    dec_ = xz_dec_init(XZ_DYNALLOC, XZ_DICT_MAX);
+  }
+  return dec_ != nullptr;
+}
+
+uint64_t XzBlockReader::size() const {
+  return blocks_.empty() ? 0 : blocks_.back().out_offset + blocks_.back().out_size;
+}
+
+uint64_t XzBlockReader::largest_block() const {
+  uint64_t n = 0;
+  for (const XzBlock& b : blocks_) {
+    n = b.out_size > n ? b.out_size : n;
+  }
+  return n;
+}
+
+// Decodes one Block on its own: the Stream Header (for the check type) and
+// then just this Block's bytes. The decoder stops when it runs out of input
+// where the next Block Header would start, so the Index is never needed.
+bool XzBlockReader::decode_block(const XzBlock& blk, uint64_t from, uint64_t to,
+                                 XzSink sink, void* ctx, bool* stopped) {
+  xz_dec_reset(dec_);
+  if (blk.out_size > max_block) {
+    max_block = blk.out_size;
+  }
+
+  xz_buf b{};
+  b.in = in_;
+  b.in_size = XZ_HEADER_SIZE;
+  b.out = window_;
+  b.out_size = 0;
+  uint64_t t0 = now_ns();
+  xz_ret ret = xz_dec_run(dec_, &b);
+  if (ret != XZ_OK || b.in_pos != XZ_HEADER_SIZE) {
+    LOGE("xz stream header: ret=%d", ret);
+    return false;
+  }
+
+  b.in = in_ + blk.in_offset;
+  b.in_pos = 0;
+  b.in_size = blk.in_size;
+  b.out_size = WINDOW;
+  uint64_t out = blk.out_offset;
+  for (;;) {
+    b.out_pos = 0;
+    const size_t in_before = b.in_pos;
+    ret = xz_dec_run(dec_, &b);
+    if (ret != XZ_OK) {
+      LOGE("xz block at 0x%zx: ret=%d", blk.in_offset, ret);
+      decode_ns += now_ns() - t0;
+      return false;
+    }
+    decoded_bytes += b.out_pos;
+
+    // the part of this window inside [from, to)
+    const uint64_t lo = out > from ? out : from;
+    const uint64_t hi = out + b.out_pos < to ? out + b.out_pos : to;
+    out += b.out_pos;
+    if (lo < hi) {
+      decode_ns += now_ns() - t0;
+      if (!sink(ctx, lo, window_ + (lo - (out - b.out_pos)), (size_t)(hi - lo))) {
+        *stopped = true;
+        return true;
+      }
+      t0 = now_ns();
+    }
+    if (out >= to) {
+      break;
+    }
+    if (b.out_pos == 0 && b.in_pos == in_before) {
+      // out of input: the Block is complete (its Check was verified)
+      break;
+    }
+  }
+  decode_ns += now_ns() - t0;
+
+  if (out < to && out != blk.out_offset + blk.out_size) {
+    LOGE("xz block at 0x%zx: %llu bytes, index says %llu", blk.in_offset,
+         (unsigned long long)(out - blk.out_offset), (unsigned long long)blk.out_size);
+    return false;
+  }
+  return true;
+}
+
+bool XzBlockReader::read(uint64_t from, uint64_t to, XzSink sink, void* ctx) {
+  if (!dec_ || from > to || to > size()) {
+    return false;
+  }
+  // first Block that ends after from
+  size_t lo = 0, hi = blocks_.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (blocks_[mid].out_offset + blocks_[mid].out_size <= from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  for (size_t i = lo; i < blocks_.size() && blocks_[i].out_offset < to; i++) {
+    bool stopped = false;
+    if (!decode_block(blocks_[i], from, to, sink, ctx, &stopped)) {
+      return false;
+    }
+    if (stopped) {
+      break;
+    }
+  }
+  return true;
+}
+
+struct CopyCtx {
+  uint8_t* dst;
+  uint64_t base;
+};
+
+static bool copy_sink(void* ctx, uint64_t offset, const uint8_t* data, size_t len) {
+  CopyCtx* c = (CopyCtx*)ctx;
+  memcpy(c->dst + (offset - c->base), data, len);
+  return true;
+}
+
+bool XzBlockReader::copy(uint64_t off, void* dst, size_t len) {
+  CopyCtx c{ (uint8_t*)dst, off };
+  return read(off, off + len, copy_sink, &c);
+}
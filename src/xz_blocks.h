@@ -0,0 +1,72 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Block-level access to a single-stream .xz buffer through its Index.
+// LZMA2 resets the dictionary at the start of every Block, so a Block can be
+// decoded without the ones before it, and the decoder's dictionary only
+// needs to cover one Block (see xz_dec_lzma2_reset()).
+
+struct XzBlock {
+  size_t   in_offset;  // Block Header position in the .xz buffer
+  size_t   in_size;    // Block Header .. Check, including Block Padding
+  uint64_t out_offset; // where its data starts in the uncompressed stream
+  uint64_t out_size;
+};
+
+// CRC tables used by xz_dec_run() and the Index check. Thread-safe.
+void xz_init_once();
+
+// Blocks of in, from its Stream Footer and Index. False if there is no
+// usable Index (or more than one stream), in which case the stream can only
+// be decoded front to back.
+bool xz_read_index(const uint8_t* in, size_t in_len, ArenaArray<XzBlock>& blocks);
+
+// Receives consecutive pieces of the uncompressed stream; offset is the
+// position of data[0]. Return false to stop decoding.
+typedef bool (*XzSink)(void* ctx, uint64_t offset, const uint8_t* data, size_t len);
+
+// Decodes ranges of an indexed .xz buffer through a fixed output window, so
+// memory stays at the window plus one Block's dictionary however large the
+// uncompressed data is.
+struct XzBlockReader {
+  static const size_t WINDOW = 16 * 1024;
+
+  XzBlockReader() = default;
+  ~XzBlockReader();
+  XzBlockReader(const XzBlockReader&) = delete;
+  XzBlockReader& operator=(const XzBlockReader&) = delete;
+
+  // False if in has no usable Index.
+  bool init(const uint8_t* in, size_t in_len);
+
+  // Uncompressed size of the whole stream, and of its largest Block.
+  uint64_t size() const;
+  uint64_t largest_block() const;
+
+  // Decodes the Blocks covering [from, to) and hands sink the bytes of that
+  // range, at most WINDOW at a time. Returns false on a decode error; a
+  // sink that stops early is not an error.
+  bool read(uint64_t from, uint64_t to, XzSink sink, void* ctx);
+
+  // Copies [off, off + len) into dst.
+  bool copy(uint64_t off, void* dst, size_t len);
+
+  // Uncompressed bytes produced so far (whole Blocks, including the parts
+  // outside the requested ranges), the time spent in xz_dec_run() and the
+  // largest Block decoded, which bounds the dictionary.
+  uint64_t decoded_bytes = 0;
+  uint64_t decode_ns = 0;
+  uint64_t max_block = 0;
+
+private:
+  bool decode_block(const XzBlock& blk, uint64_t from, uint64_t to, XzSink sink, void* ctx,
+                    bool* stopped);
+
+  const uint8_t*       in_ = nullptr;
+  ArenaArray<XzBlock>  blocks_;
+  struct xz_dec*       dec_ = nullptr;
+  uint8_t              window_[WINDOW];
+};
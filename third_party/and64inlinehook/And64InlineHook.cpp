@@ -28,13 +28,17 @@
  */
 #define  __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <android/log.h>
 
-#if defined(__aarch64__)
+// A64_HOOK_HOST: built on another architecture for host/hook_sim, which runs
+// the generated code in an interpreter
+#if defined(__aarch64__) || defined(A64_HOOK_HOST)
 
 #include "And64InlineHook.hpp"
 #define   A64_MAX_INSTRUCTIONS 5
@@ -299,7 +303,8 @@ static bool __fix_loadlit(instruction inpp, instruction outpp, context *ctxp)
     } //if
 
     intptr_t current_idx  = ctxp->get_and_set_current_index(*inpp, *outpp);
-    int64_t absolute_addr = reinterpret_cast<int64_t>(*inpp) + ((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3u);
+    // & ~3, not ~3u: an unsigned mask would zero-extend a negative offset
+    int64_t absolute_addr = reinterpret_cast<int64_t>(*inpp) + ((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3);
     int64_t new_pc_offset = static_cast<int64_t>(absolute_addr - reinterpret_cast<int64_t>(*outpp)) >> 2; // shifted
     bool special_fix_type = ctxp->is_in_fixing_range(absolute_addr);
     // special_fix_type may encounter issue when there are mixed data and code
@@ -355,7 +360,7 @@ static bool __fix_pcreladdr(instruction inpp, instruction outpp, context *ctxp)
         {
             current_idx           = ctxp->get_and_set_current_index(*inpp, *outpp);
             int64_t lsb_bytes     = static_cast<uint32_t>(ins << 1u) >> 30u;
-            int64_t absolute_addr = reinterpret_cast<int64_t>(*inpp) + (((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3u) | lsb_bytes);
+            int64_t absolute_addr = reinterpret_cast<int64_t>(*inpp) + (((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3) | lsb_bytes); // signed, as in __fix_loadlit
             int64_t new_pc_offset = static_cast<int64_t>(absolute_addr - reinterpret_cast<int64_t>(*outpp));
             bool special_fix_type = ctxp->is_in_fixing_range(absolute_addr);
             if (!special_fix_type && llabs(new_pc_offset) >= (max_val >> 1)) {
@@ -389,7 +394,8 @@ static bool __fix_pcreladdr(instruction inpp, instruction outpp, context *ctxp)
         {
             current_idx           = ctxp->get_and_set_current_index(*inpp, *outpp);
             int32_t lsb_bytes     = static_cast<uint32_t>(ins << 1u) >> 30u;
-            int64_t absolute_addr = (reinterpret_cast<int64_t>(*inpp) & ~0xfffll) + ((((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3u) | lsb_bytes) << 12);
+            // signed page count, widened before scaling: ADRP reaches +-4GB
+            int64_t absolute_addr = (reinterpret_cast<int64_t>(*inpp) & ~0xfffll) + static_cast<int64_t>(((static_cast<int32_t>(ins << msb) >> (msb + lsb - 2u)) & ~3) | lsb_bytes) * 0x1000;
             A64_LOGI("ins = 0x%.8X, pc = %p, abs_addr = %p",
                      ins, *inpp, reinterpret_cast<int64_t *>(absolute_addr));
             if (ctxp->is_in_fixing_range(absolute_addr)) {
@@ -477,36 +483,178 @@ static void __fix_instructions(uint32_t *__restrict inp, int32_t count, uint32_t
 
 //-------------------------------------------------------------------------
 
-extern "C" {
-    static __attribute__((__aligned__(__page_size))) uint32_t __insns_pool[A64_MAX_BACKUPS][A64_MAX_INSTRUCTIONS * 10];
+// Trampolines live in RWX pages mapped within B range (+-128MB) of the hooked
+// code, so the jump back and relocated PC-relative instructions stay single
+// instructions. Pages are carved up on demand instead of reserving a pool.
 
-    //-------------------------------------------------------------------------
+#define   A64_B_RANGE          0x08000000ll // +-128MB, ADDR_PCREL26
+#define   A64_NEAR_RANGE       (A64_B_RANGE - 2 * __page_size) // whole page in range
+#define   A64_NEAR_MIN_ADDR    0x10000u     // stay above mmap_min_addr
+#define   A64_TRAMPOLINE_SIZE  (A64_MAX_INSTRUCTIONS * 10 * sizeof(uint32_t))
+#define   A64_THUNK_SIZE       (4 * sizeof(uint32_t))
 
-    class A64HookInit
-    {
-    public:
-        A64HookInit()
-        {
-            __make_rwx(__insns_pool, sizeof(__insns_pool));
-            A64_LOGI("insns pool initialized.");
-        }
-    };
-    static A64HookInit __init;
+struct near_page
+{
+    near_page *next;
+    uintptr_t  used; // bytes, including this header
+};
+static_assert(sizeof(near_page) <= 32, "near_page header too large");
 
-    //-------------------------------------------------------------------------
+static near_page       *__near_pages = NULL;
+static pthread_mutex_t  __near_lock  = PTHREAD_MUTEX_INITIALIZER;
 
-    static uint32_t *FastAllocateTrampoline()
-    {
-        static_assert((A64_MAX_INSTRUCTIONS * 10 * sizeof(uint32_t)) % 8 == 0, "8-byte align");
-        static volatile int32_t __index = -1;
+//-------------------------------------------------------------------------
 
-        int32_t i = __atomic_increase(&__index);
-        if (__predict_true(i >= 0 && i < __countof(__insns_pool))) {
-            return __insns_pool[i];
-        } //if
+static inline bool __is_near(const uintptr_t a, const uintptr_t b)
+{
+    return llabs(static_cast<int64_t>(a - b)) < A64_NEAR_RANGE;
+}
+
+//-------------------------------------------------------------------------
 
-        A64_LOGE("failed to allocate trampoline!");
+static void *__map_page_in_gap(uintptr_t gs, uintptr_t ge, const uintptr_t lo, const uintptr_t hi,
+                               const uintptr_t target)
+{
+    gs = __align_up(gs > lo ? gs : lo, __page_size);
+    ge = __align_down(ge < hi ? ge : hi, __page_size);
+    if (gs >= ge) return NULL;
+
+    // the page inside the gap closest to target
+    uintptr_t hint = __align_down(target, __page_size);
+    if (hint < gs) {
+        hint = gs;
+    } else if (hint > ge - __page_size) {
+        hint = ge - __page_size;
+    } //if
+
+    void *p = ::mmap(__ptr(hint), __page_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (!__is_near(__uintval(p), target)) {
+        // the hint is only a hint, the kernel placed it elsewhere
+        ::munmap(p, __page_size);
+        return NULL;
+    } //if
+    return p;
+}
+
+//-------------------------------------------------------------------------
+
+static void *__map_page_near(const uintptr_t target)
+{
+    const uintptr_t lo = target > A64_NEAR_RANGE + A64_NEAR_MIN_ADDR ? target - A64_NEAR_RANGE : A64_NEAR_MIN_ADDR;
+    const uintptr_t hi = target + A64_NEAR_RANGE;
+
+    FILE *fp = fopen("/proc/self/maps", "re");
+    if (fp == NULL) {
+        A64_LOGE("failed to open /proc/self/maps, errno = %d", errno);
         return NULL;
+    } //if
+
+    // walk the gaps between mappings, in address order
+    char      line[512];
+    bool      bol      = true; // at the beginning of a line
+    uintptr_t prev_end = 0;
+    void     *page     = NULL;
+    while (page == NULL && fgets(line, sizeof(line), fp) != NULL) {
+        const bool line_start = bol;
+        bol = strchr(line, '\n') != NULL;
+        if (!line_start) continue; // tail of an overlong line
+
+        uintptr_t start, end;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &start, &end) != 2) continue;
+        if (start >= hi) {
+            page = __map_page_in_gap(prev_end, start, lo, hi, target);
+            break;
+        } //if
+        if (start > prev_end && start > lo) {
+            page = __map_page_in_gap(prev_end, start, lo, hi, target);
+        } //if
+        prev_end = end;
+    }
+    if (page == NULL && prev_end < hi && feof(fp)) {
+        page = __map_page_in_gap(prev_end, hi, lo, hi, target);
+    } //if
+    fclose(fp);
+    return page;
+}
+
+//-------------------------------------------------------------------------
+
+static uint32_t *__near_alloc(void *const target, uintptr_t size)
+{
+    static constexpr uintptr_t header = 32u; // keeps allocations 8-byte aligned
+    size = __align_up(size, 8u);
+
+    const uintptr_t t   = __uintval(target);
+    uint32_t       *res = NULL;
+    pthread_mutex_lock(&__near_lock);
+
+    near_page *far = NULL;
+    for (near_page *pg = __near_pages; pg != NULL; pg = pg->next) {
+        if (pg->used + size > __page_size) continue;
+        if (__is_near(__uintval(pg), t)) {
+            res = reinterpret_cast<uint32_t *>(__uintval(pg) + pg->used);
+            pg->used += size;
+            break;
+        } //if
+        if (far == NULL) far = pg;
+    }
+
+    if (res == NULL) {
+        void *p = __map_page_near(t);
+        if (p == NULL && far != NULL) {
+            // nothing free near target, any page with room will do
+            A64_LOGI("no free page near %p, using far page %p", target, far);
+            res = reinterpret_cast<uint32_t *>(__uintval(far) + far->used);
+            far->used += size;
+        } else {
+            if (p == NULL) {
+                A64_LOGI("no free page near %p, mapping anywhere", target);
+                p = ::mmap(NULL, __page_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED) p = NULL;
+            } //if
+            if (p != NULL) {
+                near_page *pg = static_cast<near_page *>(p);
+                pg->next      = __near_pages;
+                pg->used      = header + size;
+                __near_pages  = pg;
+                res = reinterpret_cast<uint32_t *>(__uintval(p) + header);
+            } //if
+        } //if
+    } //if
+
+    pthread_mutex_unlock(&__near_lock);
+    if (res == NULL) {
+        A64_LOGE("failed to allocate %zu bytes near %p, errno = %d", static_cast<size_t>(size), target, errno);
+    } //if
+    return res;
+}
+
+//-------------------------------------------------------------------------
+
+extern "C" {
+    static uint32_t *FastAllocateTrampoline(void *const symbol)
+    {
+        static_assert(A64_TRAMPOLINE_SIZE % 8 == 0, "8-byte align");
+        return __near_alloc(symbol, A64_TRAMPOLINE_SIZE);
+    }
+
+    //-------------------------------------------------------------------------
+
+    // LDR/BR to replace, placed within B range of symbol
+    static void *AllocateThunk(void *const symbol, void *const replace)
+    {
+        uint32_t *thunk = __near_alloc(symbol, A64_THUNK_SIZE);
+        if (thunk == NULL) return NULL;
+        if (!__is_near(__uintval(thunk), __uintval(symbol))) return NULL; // wasted, but harmless
+
+        thunk[0] = 0x58000051u; // LDR X17, #0x8
+        thunk[1] = 0xd61f0220u; // BR X17
+        *reinterpret_cast<int64_t *>(thunk + 2) = __intval(replace); // 8-byte aligned
+        __flush_cache(thunk, A64_THUNK_SIZE);
+        return thunk;
     }
 
     //-------------------------------------------------------------------------
@@ -574,23 +722,248 @@ extern "C" {
 
     //-------------------------------------------------------------------------
 
-    A64_JNIEXPORT void A64HookFunction(void *const symbol, void *const replace, void **result)
+    // Relocates the prologue into a fresh trampoline and computes the patch
+    // words. Reads the code at symbol but does not modify it.
+    static int PrepareHook(A64HookEntry *h, const bool live)
     {
-        void *trampoline = NULL;
-        if (result != NULL) {
-            trampoline = FastAllocateTrampoline();
-            *result = trampoline;
-            if (trampoline == NULL) return;
+        static constexpr uint_fast64_t mask = 0x03ffffffu; // 0b00000011111111111111111111111111
+
+        uint32_t *trampoline = NULL, *original = static_cast<uint32_t *>(h->symbol);
+        if (h->result != NULL) {
+            trampoline = FastAllocateTrampoline(h->symbol);
+            if (trampoline == NULL) return A64_HOOK_ENOMEM;
         } //if
 
-        // fix Android 10 .text segment is read-only by default
-        __make_rwx(symbol, 5 * sizeof(size_t));
+        // a replacement out of B range would need the 5-instruction LDR/BR patch;
+        // route it through a near thunk instead so the patch is a single B
+        void *target = h->replace;
+        if (!__is_near(__uintval(target), __uintval(h->symbol))) {
+            void *thunk = AllocateThunk(h->symbol, target);
+            if (thunk != NULL) target = thunk;
+        } //if
 
-        trampoline = A64HookFunctionV(symbol, replace, trampoline, A64_MAX_INSTRUCTIONS * 10u);
-        if (trampoline == NULL && result != NULL) {
-            *result = NULL;
+        auto pc_offset = static_cast<int64_t>(__intval(target) - __intval(h->symbol)) >> 2;
+        if (llabs(pc_offset) >= (mask >> 1)) {
+            // several words cannot be replaced atomically: a thread running
+            // the prologue meanwhile could execute half old, half new code
+            if (live) {
+                A64_LOGE("%p: replacement out of B range and no near thunk, "
+                         "refusing a multi-word patch of live code", h->symbol);
+                return A64_HOOK_ENOTATOMIC;
+            } //if
+            int32_t count = (reinterpret_cast<uint64_t>(original + 2) & 7u) != 0u ? 5 : 4;
+            if (trampoline) __fix_instructions(original, count, trampoline);
+
+            uint32_t *p = h->patch;
+            if (count == 5) *(p++) = A64_NOP;
+            p[0] = 0x58000051u; // LDR X17, #0x8
+            p[1] = 0xd61f0220u; // BR X17
+            memcpy(p + 2, &target, sizeof(target));
+            h->npatch = count;
+        } else {
+            if (trampoline) __fix_instructions(original, 1, trampoline);
+            h->patch[0] = 0x14000000u | (pc_offset & mask); // "B" ADDR_PCREL26
+            h->npatch   = 1;
+        } //if
+
+        if (h->result != NULL) *h->result = trampoline;
+        return A64_HOOK_OK;
+    }
+
+    //-------------------------------------------------------------------------
+
+    struct txn_page
+    {
+        uintptr_t addr;
+        int       prot; // original protection, -1 if unknown
+        uintptr_t lo, hi; // patched bytes, for the cache flush
+    };
+
+    // fills in the current protection of each page from /proc/self/maps
+    static void __read_page_prots(txn_page *pages, const int npages)
+    {
+        FILE *fp = fopen("/proc/self/maps", "re");
+        if (fp == NULL) return;
+
+        char line[512];
+        bool bol = true;
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            const bool line_start = bol;
+            bol = strchr(line, '\n') != NULL;
+            if (!line_start) continue;
+
+            uintptr_t start, end;
+            char      perms[5];
+            if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %4s", &start, &end, perms) != 3) continue;
+            const int prot = (perms[0] == 'r' ? PROT_READ : 0) |
+                             (perms[1] == 'w' ? PROT_WRITE : 0) |
+                             (perms[2] == 'x' ? PROT_EXEC : 0);
+            for (int i = 0; i < npages; ++i) {
+                if (pages[i].addr >= start && pages[i].addr < end) pages[i].prot = prot;
+            }
+        }
+        fclose(fp);
+    }
+
+    //-------------------------------------------------------------------------
+
+    static void __restore_page_prots(const txn_page *pages, const int npages)
+    {
+        for (int i = 0; i < npages; ++i) {
+            // text we could not look up was r-x before Android 10 made it r--
+            const int prot = pages[i].prot >= 0 ? pages[i].prot : PROT_READ | PROT_EXEC;
+            if (::mprotect(__ptr(pages[i].addr), __page_size, prot) != 0) {
+                A64_LOGE("failed to restore protection of %p, errno = %d", __ptr(pages[i].addr), errno);
+            } //if
+        }
+    }
+
+    //-------------------------------------------------------------------------
+
+    A64_JNIEXPORT void A64HookBegin(A64HookTxn *txn)
+    {
+        txn->count = 0;
+        txn->live  = 0;
+    }
+
+    //-------------------------------------------------------------------------
+
+    A64_JNIEXPORT int A64HookAdd(A64HookTxn *txn, void *const symbol, void *const replace, void **result)
+    {
+        if (txn->count >= A64_TXN_MAX_HOOKS) {
+            A64_LOGE("too many hooks in one transaction!");
+            return -1;
         } //if
+
+        A64HookEntry *h = &txn->hooks[txn->count];
+        memset(h, 0, sizeof(*h));
+        h->symbol  = symbol;
+        h->replace = replace;
+        h->result  = result;
+        h->status  = A64_HOOK_PENDING;
+        return txn->count++;
+    }
+
+    //-------------------------------------------------------------------------
+
+    A64_JNIEXPORT int A64HookCommit(A64HookTxn *txn)
+    {
+        static constexpr uintptr_t max_patch = 5 * sizeof(uint32_t);
+
+        // pages touched by the patches; a patch may straddle two
+        txn_page pages[A64_TXN_MAX_HOOKS * 2];
+        int      npages = 0;
+        int      err    = A64_HOOK_OK;
+        for (int i = 0; i < txn->count; ++i) {
+            A64HookEntry *h = &txn->hooks[i];
+            if (h->result != NULL) *h->result = NULL;
+            if (h->symbol == NULL || h->replace == NULL) {
+                h->status = A64_HOOK_EINVAL;
+            } else {
+                for (int j = 0; j < i; ++j) {
+                    if (txn->hooks[j].symbol == h->symbol) h->status = A64_HOOK_EINVAL;
+                }
+            } //if
+            if (h->status != A64_HOOK_PENDING) {
+                if (err == A64_HOOK_OK) err = h->status;
+                continue;
+            } //if
+
+            const uintptr_t first = __align_down(__uintval(h->symbol), __page_size);
+            const uintptr_t last  = __align_down(__uintval(h->symbol) + max_patch - 1, __page_size);
+            for (uintptr_t pg = first; pg <= last; pg += __page_size) {
+                bool seen = false;
+                for (int j = 0; j < npages && !seen; ++j) seen = pages[j].addr == pg;
+                if (!seen) pages[npages++] = { pg, -1, ~uintptr_t(0), 0 };
+            }
+        }
+
+        // one mprotect per page; it stays executable, other threads may be
+        // running code on it
+        int nwritable = 0;
+        if (err == A64_HOOK_OK) {
+            __read_page_prots(pages, npages);
+            for (; nwritable < npages; ++nwritable) {
+                if (::mprotect(__ptr(pages[nwritable].addr), __page_size,
+                               PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+                    A64_LOGE("mprotect failed with errno = %d, p = %p", errno, __ptr(pages[nwritable].addr));
+                    for (int i = 0; i < txn->count; ++i) {
+                        A64HookEntry *h = &txn->hooks[i];
+                        const uintptr_t s = __uintval(h->symbol);
+                        if (s + max_patch > pages[nwritable].addr && s < pages[nwritable].addr + __page_size) {
+                            h->status = A64_HOOK_EPROT;
+                        } //if
+                    }
+                    err = A64_HOOK_EPROT;
+                    break;
+                } //if
+            }
+        } //if
+
+        // relocate every prologue before touching any of them, so a failure
+        // leaves nothing to undo in the code itself (trampolines are not
+        // reclaimed)
+        for (int i = 0; err == A64_HOOK_OK && i < txn->count; ++i) {
+            A64HookEntry *h = &txn->hooks[i];
+            int st = PrepareHook(h, txn->live != 0);
+            if (st != A64_HOOK_OK) {
+                h->status = st;
+                err = st;
+            } //if
+        }
+
+        if (err != A64_HOOK_OK) {
+            __restore_page_prots(pages, nwritable);
+            for (int i = 0; i < txn->count; ++i) {
+                A64HookEntry *h = &txn->hooks[i];
+                if (h->status == A64_HOOK_PENDING) h->status = A64_HOOK_ABORTED;
+                if (h->result != NULL) *h->result = NULL;
+            }
+            A64_LOGE("hook transaction of %d hooks rolled back, status = %d", txn->count, err);
+            return err;
+        } //if
+
+        // *result is already set, so a hook that runs right after its patch
+        // lands can call the original
+        for (int i = 0; i < txn->count; ++i) {
+            A64HookEntry *h = &txn->hooks[i];
+            uint32_t *original = static_cast<uint32_t *>(h->symbol);
+            if (h->npatch == 1) {
+                __sync_cmpswap(original, *original, h->patch[0]);
+            } else {
+                // only in a transaction that is not live (see PrepareHook)
+                memcpy(original, h->patch, h->npatch * sizeof(uint32_t));
+            } //if
+            h->status = A64_HOOK_OK;
+
+            const uintptr_t s = __uintval(original), e = s + h->npatch * sizeof(uint32_t);
+            for (int j = 0; j < npages; ++j) {
+                const uintptr_t lo = s > pages[j].addr ? s : pages[j].addr;
+                const uintptr_t hi = e < pages[j].addr + __page_size ? e : pages[j].addr + __page_size;
+                if (lo >= hi) continue;
+                if (lo < pages[j].lo) pages[j].lo = lo;
+                if (hi > pages[j].hi) pages[j].hi = hi;
+            }
+            A64_LOGI("inline hook %p->%p successfully! %zu bytes overwritten",
+                     h->symbol, h->replace, h->npatch * sizeof(uint32_t));
+        }
+
+        for (int j = 0; j < npages; ++j) {
+            if (pages[j].lo < pages[j].hi) __flush_cache(pages[j].lo, pages[j].hi - pages[j].lo);
+        }
+        __restore_page_prots(pages, npages);
+        return A64_HOOK_OK;
+    }
+
+    //-------------------------------------------------------------------------
+
+    A64_JNIEXPORT void A64HookFunction(void *const symbol, void *const replace, void **result)
+    {
+        A64HookTxn txn;
+        A64HookBegin(&txn);
+        A64HookAdd(&txn, symbol, replace, result);
+        A64HookCommit(&txn);
     }
 }
 
-#endif // defined(__aarch64__)
\ No newline at end of file
+#endif // defined(__aarch64__) || defined(A64_HOOK_HOST)
\ No newline at end of file
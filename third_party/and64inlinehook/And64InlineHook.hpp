@@ -27,12 +27,61 @@
  SOFTWARE.
  */
 #pragma once
-#define A64_MAX_BACKUPS 256
+#include <stdint.h>
+
+#define A64_TXN_MAX_HOOKS 16
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+    // per-hook status, see A64HookCommit()
+    enum {
+        A64_HOOK_OK = 0,
+        A64_HOOK_PENDING,   // added, not committed yet
+        A64_HOOK_EINVAL,    // NULL symbol / replacement, or symbol added twice
+        A64_HOOK_ENOMEM,    // no trampoline could be allocated
+        A64_HOOK_EPROT,     // the code page could not be made writable
+        A64_HOOK_ABORTED,   // fine by itself, rolled back because another hook failed
+        A64_HOOK_ENOTATOMIC, // live transaction, but only the multi-word LDR/BR patch
+                             // reaches the replacement (no near thunk could be allocated)
+    };
+
+    typedef struct A64HookEntry
+    {
+        void  *symbol;
+        void  *replace;
+        void **result;
+        int    status;
+        // filled in by A64HookCommit()
+        uint32_t patch[5];
+        int      npatch;
+    } A64HookEntry;
+
+    // A batch of hooks installed together: A64HookBegin(), A64HookAdd() for
+    // each hook, then A64HookCommit(). Touched code pages are made writable
+    // once each and get their original protection back afterwards.
+    //
+    // Set live (after A64HookBegin(), which clears it) when other threads
+    // may be executing the hooked prologues during the commit. Only a
+    // single-instruction B patch can then be written atomically; a hook
+    // that would need the 4-5 word LDR/BR patch fails with
+    // A64_HOOK_ENOTATOMIC instead, and the transaction is rolled back.
+    typedef struct A64HookTxn
+    {
+        int          count;
+        int          live;
+        A64HookEntry hooks[A64_TXN_MAX_HOOKS];
+    } A64HookTxn;
+
+    void A64HookBegin(A64HookTxn *txn);
+    // returns the hook's index in txn, or -1 if the transaction is full
+    int A64HookAdd(A64HookTxn *txn, void *const symbol, void *const replace, void **result);
+    // All or nothing: either every hook is installed and A64_HOOK_OK is
+    // returned, or no code is modified and the first failing status is
+    // returned. Each entry's status says what happened to it.
+    int A64HookCommit(A64HookTxn *txn);
+
     void A64HookFunction(void *const symbol, void *const replace, void **result);
     void *A64HookFunctionV(void *const symbol, void *const replace,
                            void *const rwx, const uintptr_t rwx_size);
@@ -12,6 +12,13 @@
 /* Uncomment to enable building of xz_dec_catrun(). */
 /* #define XZ_DEC_CONCATENATED */
 
+/*
+ * Uncomment to use the faster user-space LZMA decode loop (branchless bit
+ * tree and literal decoding, word-sized match copies) instead of the
+ * size-optimized upstream one. See XZ_DEC_FAST in xz_dec_lzma2.c.
+ */
+/* #define XZ_DEC_FAST */
+
 /* Uncomment to enable CRC64 support. */
 /* #define XZ_USE_CRC64 */
 
@@ -39,10 +46,23 @@
 
 #include "xz.h"
 
-#define kmalloc(size, flags) malloc(size)
-#define kfree(ptr) free(ptr)
-#define vmalloc(size) malloc(size)
-#define vfree(ptr) free(ptr)
+/*
+ * With XZ_ARENA, memory comes from the arena of the symbol resolution in
+ * progress (src/arena.h), or from malloc() when there is none.
+ */
+#ifdef XZ_ARENA
+void *xz_arena_alloc(size_t size);
+void xz_arena_free(void *ptr);
+#	define kmalloc(size, flags) xz_arena_alloc(size)
+#	define kfree(ptr) xz_arena_free(ptr)
+#	define vmalloc(size) xz_arena_alloc(size)
+#	define vfree(ptr) xz_arena_free(ptr)
+#else
+#	define kmalloc(size, flags) malloc(size)
+#	define kfree(ptr) free(ptr)
+#	define vmalloc(size) malloc(size)
+#	define vfree(ptr) free(ptr)
+#endif
 
 #define memeq(a, b, size) (memcmp(a, b, size) == 0)
 #define memzero(buf, size) memset(buf, 0, size)
@@ -3,7 +3,10 @@
 /*
  * CRC64 using the polynomial from ECMA-182
  *
- * This file is similar to xz_crc32.c. See the comments there.
+ * This file is similar to xz_crc32.c. See the comments there. On arm64 with
+ * PMULL the bulk of the input is folded with carry-less multiplies (see
+ * xz_crc_arm64.c) and only the last 16 folded bytes and the tail go through
+ * the tables.
  *
  * Authors: Lasse Collin <lasse.collin@tukaani.org>
  *          Igor Pavlov <https://7-zip.org/>
@@ -15,7 +18,11 @@
 #	define STATIC_RW_DATA static
 #endif
 
-STATIC_RW_DATA uint64_t xz_crc64_table[256];
+STATIC_RW_DATA uint64_t xz_crc64_table[8][256];
+
+#ifdef XZ_CRC_ARM64
+STATIC_RW_DATA bool xz_crc64_use_pmull;
+#endif
 
 XZ_EXTERN void xz_crc64_init(void)
 {
@@ -34,20 +41,77 @@ XZ_EXTERN void xz_crc64_init(void)
 		for (j = 0; j < 8; ++j)
 			r = (r >> 1) ^ (poly & ~((r & 1) - 1));
 
-		xz_crc64_table[i] = r;
+		xz_crc64_table[0][i] = r;
 	}
 
+	for (i = 0; i < 256; ++i) {
+		r = xz_crc64_table[0][i];
+		for (j = 1; j < 8; ++j) {
+			r = xz_crc64_table[0][r & 0xFF] ^ (r >> 8);
+			xz_crc64_table[j][i] = r;
+		}
+	}
+
+#ifdef XZ_CRC_ARM64
+	xz_crc64_use_pmull = xz_crc_arm64_have_pmull();
+#endif
+
 	return;
 }
 
-XZ_EXTERN uint64_t xz_crc64(const uint8_t *buf, size_t size, uint64_t crc)
+/* Table-driven update of the raw (already inverted) CRC state. */
+static uint64_t crc64_slice8(const uint8_t *buf, size_t size, uint64_t crc)
 {
-	crc = ~crc;
+	while (size != 0 && ((uintptr_t)buf & 3) != 0) {
+		crc = xz_crc64_table[0][*buf++ ^ (crc & 0xFF)] ^ (crc >> 8);
+		--size;
+	}
+
+	while (size >= 8) {
+		const uint64_t v = ((uint64_t)get_unaligned_le32(buf)
+				| ((uint64_t)get_unaligned_le32(buf + 4) << 32))
+				^ crc;
+
+		crc = xz_crc64_table[7][v & 0xFF]
+				^ xz_crc64_table[6][(v >> 8) & 0xFF]
+				^ xz_crc64_table[5][(v >> 16) & 0xFF]
+				^ xz_crc64_table[4][(v >> 24) & 0xFF]
+				^ xz_crc64_table[3][(v >> 32) & 0xFF]
+				^ xz_crc64_table[2][(v >> 40) & 0xFF]
+				^ xz_crc64_table[1][(v >> 48) & 0xFF]
+				^ xz_crc64_table[0][v >> 56];
+		buf += 8;
+		size -= 8;
+	}
 
 	while (size != 0) {
-		crc = xz_crc64_table[*buf++ ^ (crc & 0xFF)] ^ (crc >> 8);
+		crc = xz_crc64_table[0][*buf++ ^ (crc & 0xFF)] ^ (crc >> 8);
 		--size;
 	}
 
-	return ~crc;
+	return crc;
+}
+
+XZ_EXTERN uint64_t xz_crc64_generic(const uint8_t *buf, size_t size,
+				    uint64_t crc)
+{
+	return ~crc64_slice8(buf, size, ~crc);
+}
+
+XZ_EXTERN uint64_t xz_crc64(const uint8_t *buf, size_t size, uint64_t crc)
+{
+	crc = ~crc;
+
+#ifdef XZ_CRC_ARM64
+	if (xz_crc64_use_pmull && size >= 32) {
+		uint8_t folded[16];
+		size_t n = xz_crc64_pmull_fold(buf, size, crc, folded);
+
+		crc = crc64_slice8(folded, sizeof(folded), 0);
+		buf += n;
+		size -= n;
+	}
+#endif
+
+	return ~crc64_slice8(buf, size, crc);
 }
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: 0BSD
+
+/*
+ * CRC32 and CRC64 kernels for arm64
+ *
+ * This file is built with the CRC and crypto extensions enabled, so nothing
+ * in here may be called unless the matching xz_crc_arm64_have_*() check
+ * succeeded. xz_crc32_init() and xz_crc64_init() do that once and pick
+ * either these kernels or the slicing-by-8 tables.
+ *
+ * CRC32 uses the CRC32X/CRC32B instructions directly.
+ *
+ * CRC64 folds 16 bytes per step with two PMULLs:
+ *
+ *     x' = lo(x) * K1 + hi(x) * K2 + next 16 bytes   (carry-less)
+ *
+ * with K1 = x^191 mod P and K2 = x^127 mod P, bit-reflected to match the
+ * reflected ECMA-182 polynomial used by .xz. The last folded 16 bytes are
+ * then run through the tables by xz_crc64().
+ *
+ * With XZ_CRC_ARM64_HOST the kernels are built on another architecture
+ * against C versions of the intrinsics (host/a64_shim), so that
+ * host/crc_bench.cpp can check them without arm64 hardware. The
+ * xz_crc_arm64_have_*() checks are left out then.
+ */
+
+#include "xz_private.h"
+
+#if defined(XZ_CRC_ARM64) \
+		&& (defined(__aarch64__) || defined(XZ_CRC_ARM64_HOST))
+
+#include <arm_acle.h>
+#include <arm_neon.h>
+
+#ifdef __aarch64__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+XZ_EXTERN bool xz_crc_arm64_have_crc32(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+XZ_EXTERN bool xz_crc_arm64_have_pmull(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_PMULL) != 0;
+}
+#endif
+
+XZ_EXTERN uint32_t xz_crc32_arm64(const uint8_t *buf, size_t size,
+				  uint32_t crc)
+{
+	crc = ~crc;
+
+	while (size != 0 && ((uintptr_t)buf & 7) != 0) {
+		crc = __crc32b(crc, *buf++);
+		--size;
+	}
+
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, buf, sizeof(v));
+		crc = __crc32d(crc, v);
+		buf += 8;
+		size -= 8;
+	}
+
+	while (size != 0) {
+		crc = __crc32b(crc, *buf++);
+		--size;
+	}
+
+	return ~crc;
+}
+
+static inline uint64x2_t clmul_lo(uint64x2_t a, uint64x2_t b)
+{
+	return vreinterpretq_u64_p128(vmull_p64(
+			(poly64_t)vgetq_lane_u64(a, 0),
+			(poly64_t)vgetq_lane_u64(b, 0)));
+}
+
+static inline uint64x2_t clmul_hi(uint64x2_t a, uint64x2_t b)
+{
+	return vreinterpretq_u64_p128(vmull_high_p64(
+			vreinterpretq_p64_u64(a), vreinterpretq_p64_u64(b)));
+}
+
+static inline uint64x2_t load128(const uint8_t *p)
+{
+	return vreinterpretq_u64_u8(vld1q_u8(p));
+}
+
+XZ_EXTERN size_t xz_crc64_pmull_fold(const uint8_t *buf, size_t size,
+				     uint64_t crc, uint8_t folded[16])
+{
+	/* lane 0 multiplies the low half, lane 1 the high half */
+	const uint64x2_t k = vcombine_u64(vcreate_u64(0xE05DD497CA393AE4ULL),
+					  vcreate_u64(0xDABE95AFC7875F40ULL));
+	uint64x2_t x;
+	size_t n = 16;
+
+	x = veorq_u64(load128(buf), vcombine_u64(vcreate_u64(crc),
+						 vcreate_u64(0)));
+
+	while (size - n >= 16) {
+		x = veorq_u64(veorq_u64(clmul_lo(x, k), clmul_hi(x, k)),
+			      load128(buf + n));
+		n += 16;
+	}
+
+	vst1q_u8(folded, vreinterpretq_u8_u64(x));
+	return n;
+}
+
+#endif
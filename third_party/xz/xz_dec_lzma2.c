@@ -361,6 +361,44 @@ static bool dict_repeat(struct dictionary *dict, uint32_t *len, uint32_t dist)
 	if (dist >= dict->pos)
 		back += dict->end;
 
+#ifdef XZ_DEC_FAST
+	/*
+	 * The source is behind the destination unless it wraps around the
+	 * end of a multi-call dictionary. Then the copy only has to go byte
+	 * by byte where the two overlap closer than a word: a match repeats
+	 * the bytes it has just written.
+	 */
+	if (back < dict->pos) {
+		uint8_t *dst = dict->buf + dict->pos;
+		const uint8_t *src = dict->buf + back;
+
+		dict->pos += left;
+		if (dist >= left) {
+			memcpy(dst, src, left);
+		} else if (dist >= 7) {
+			while (left >= 8) {
+				memcpy(dst, src, 8);
+				dst += 8;
+				src += 8;
+				left -= 8;
+			}
+			while (left-- > 0)
+				*dst++ = *src++;
+		} else if (dist == 0) {
+			memset(dst, *src, left);
+		} else {
+			do
+				*dst++ = *src++;
+			while (--left > 0);
+		}
+
+		if (dict->full < dict->pos)
+			dict->full = dict->pos;
+
+		return true;
+	}
+#endif
+
 	do {
 		dict->buf[dict->pos++] = dict->buf[back++];
 		if (back == dict->end)
@@ -546,6 +584,58 @@ static __always_inline int rc_bit(struct rc_dec *rc, uint16_t *prob)
 	return bit;
 }
 
+#ifdef XZ_DEC_FAST
+/*
+ * rc_bit() without branches, for bit trees and literals where the bit only
+ * picks the next probability: the bits of a symbol are close to random, so
+ * branching on them mispredicts about half the time.
+ */
+static __always_inline uint32_t rc_bit_nb(struct rc_dec *rc, uint16_t *prob)
+{
+	uint32_t p = *prob;
+	uint32_t bound;
+	uint32_t mask;
+
+	rc_normalize(rc);
+	bound = (rc->range >> RC_BIT_MODEL_TOTAL_BITS) * p;
+	mask = 0U - (uint32_t)(rc->code >= bound);
+	rc->range = ((rc->range - bound) & mask) | (bound & ~mask);
+	rc->code -= bound & mask;
+	*prob = (uint16_t)(p + (((RC_BIT_MODEL_TOTAL - p) >> RC_MOVE_BITS) & ~mask)
+			- ((p >> RC_MOVE_BITS) & mask));
+
+	return mask & 1;
+}
+
+/* Decode a bittree starting from the most significant bit. */
+static __always_inline uint32_t rc_bittree(struct rc_dec *rc,
+					   uint16_t *probs, uint32_t limit)
+{
+	uint32_t symbol = 1;
+
+	do
+		symbol = (symbol << 1) + rc_bit_nb(rc, &probs[symbol]);
+	while (symbol < limit);
+
+	return symbol;
+}
+
+/* Decode a bittree starting from the least significant bit. */
+static __always_inline void rc_bittree_reverse(struct rc_dec *rc,
+					       uint16_t *probs,
+					       uint32_t *dest, uint32_t limit)
+{
+	uint32_t symbol = 1;
+	uint32_t bit;
+	uint32_t i = 0;
+
+	do {
+		bit = rc_bit_nb(rc, &probs[symbol]);
+		symbol = (symbol << 1) + bit;
+		*dest += bit << i;
+	} while (++i < limit);
+}
+#else
 /* Decode a bittree starting from the most significant bit. */
 static __always_inline uint32_t rc_bittree(struct rc_dec *rc,
 					   uint16_t *probs, uint32_t limit)
@@ -579,6 +669,7 @@ static __always_inline void rc_bittree_reverse(struct rc_dec *rc,
 		}
 	} while (++i < limit);
 }
+#endif
 
 /* Decode direct bits (fixed fifty-fifty probability) */
 static inline void rc_direct(struct rc_dec *rc, uint32_t *dest, uint32_t limit)
@@ -620,6 +711,34 @@ static void lzma_literal(struct xz_dec_lzma2 *s)
 
 	probs = lzma_literal_probs(s);
 
+#ifdef XZ_DEC_FAST
+	/*
+	 * Always eight bits, so both loops are counted and get unrolled. In
+	 * a matched literal, offset drops to zero at the first bit that
+	 * differs from the match byte; after that the plain probabilities
+	 * are used.
+	 */
+	symbol = 1;
+	if (lzma_state_is_literal(s->lzma.state)) {
+		for (i = 0; i < 8; ++i)
+			symbol = (symbol << 1)
+					+ rc_bit_nb(&s->rc, &probs[symbol]);
+	} else {
+		uint32_t bit;
+
+		match_byte = dict_get(&s->dict, s->lzma.rep0) << 1;
+		offset = 0x100;
+
+		for (i = 0; i < 8; ++i) {
+			match_bit = match_byte & offset;
+			match_byte <<= 1;
+			bit = rc_bit_nb(&s->rc,
+					&probs[offset + match_bit + symbol]);
+			symbol = (symbol << 1) + bit;
+			offset &= ~(match_bit ^ (0U - bit));
+		}
+	}
+#else
 	if (lzma_state_is_literal(s->lzma.state)) {
 		symbol = rc_bittree(&s->rc, probs, 0x100);
 	} else {
@@ -641,6 +760,7 @@ static void lzma_literal(struct xz_dec_lzma2 *s)
 			}
 		} while (symbol < 0x100);
 	}
+#endif
 
 	dict_put(&s->dict, (uint8_t)symbol);
 	lzma_state_literal(&s->lzma.state);
@@ -1161,7 +1281,8 @@ XZ_EXTERN struct xz_dec_lzma2 *xz_dec_lzma2_create(enum xz_mode mode,
 	return s;
 }
 
-XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s, uint8_t props)
+XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s, uint8_t props,
+					 uint64_t uncompressed)
 {
 	/* This limits dictionary size to 3 GiB to keep parsing simpler. */
 	if (props > 39)
@@ -1170,6 +1291,17 @@ XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s, uint8_t props)
 	s->dict.size = 2 + (props & 1);
 	s->dict.size <<= (props >> 1) + 11;
 
+	/*
+	 * The dictionary is reset at the start of every Block, so a Block
+	 * never refers back further than its own size. When the Block Header
+	 * stores that size, don't allocate more: xz --block-size=64k output
+	 * still declares the preset's 8 MiB dictionary. A wrong size in the
+	 * header can only make the data fail to decode (distances are checked
+	 * against dict.size), never read out of bounds.
+	 */
+	if (uncompressed < s->dict.size)
+		s->dict.size = uncompressed < 4096 ? 4096 : (uint32_t)uncompressed;
+
 	if (DEC_IS_MULTI(s->dict.mode)) {
 		if (s->dict.size > s->dict.size_max)
 			return XZ_MEMLIMIT_ERROR;
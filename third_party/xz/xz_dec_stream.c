@@ -577,7 +577,8 @@ static enum xz_ret dec_block_header(struct xz_dec *s)
 	if (s->temp.size - s->temp.pos < 1)
 		return XZ_DATA_ERROR;
 
-	ret = xz_dec_lzma2_reset(s->lzma2, s->temp.buf[s->temp.pos++]);
+	ret = xz_dec_lzma2_reset(s->lzma2, s->temp.buf[s->temp.pos++],
+				 s->block_header.uncompressed);
 	if (ret != XZ_OK)
 		return ret;
 
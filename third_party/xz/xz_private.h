@@ -111,6 +111,35 @@
 #	endif
 #endif
 
+/*
+ * xz_crc32() and xz_crc64() without the arm64 kernels (slicing-by-8 only),
+ * to check those against.
+ */
+XZ_EXTERN uint32_t xz_crc32_generic(const uint8_t *buf, size_t size,
+				    uint32_t crc);
+XZ_EXTERN uint64_t xz_crc64_generic(const uint8_t *buf, size_t size,
+				    uint64_t crc);
+
+#ifdef XZ_CRC_ARM64
+/*
+ * arm64 CRC kernels from xz_crc_arm64.c. They must only be called after the
+ * matching xz_crc_arm64_have_*() check returned true.
+ */
+XZ_EXTERN bool xz_crc_arm64_have_crc32(void);
+XZ_EXTERN bool xz_crc_arm64_have_pmull(void);
+XZ_EXTERN uint32_t xz_crc32_arm64(const uint8_t *buf, size_t size,
+				  uint32_t crc);
+
+/*
+ * Fold whole 16-byte blocks of buf (size >= 32) into 16 bytes, starting from
+ * the raw (inverted) CRC64 state crc. Returns the number of input bytes
+ * consumed; the CRC64 state is then the table CRC of the folded bytes
+ * followed by the remaining input.
+ */
+XZ_EXTERN size_t xz_crc64_pmull_fold(const uint8_t *buf, size_t size,
+				     uint64_t crc, uint8_t folded[16]);
+#endif
+
 struct xz_sha256 {
 	/* Buffered input data */
 	uint8_t data[64];
@@ -143,13 +172,15 @@ XZ_EXTERN struct xz_dec_lzma2 *xz_dec_lzma2_create(enum xz_mode mode,
 						   uint32_t dict_max);
 
 /*
- * Decode the LZMA2 properties (one byte) and reset the decoder. Return
- * XZ_OK on success, XZ_MEMLIMIT_ERROR if the preallocated dictionary is not
- * big enough, and XZ_OPTIONS_ERROR if props indicates something that this
- * decoder doesn't support.
+ * Decode the LZMA2 properties (one byte) and reset the decoder. uncompressed
+ * is the Block's Uncompressed Size from its header (VLI_UNKNOWN if absent);
+ * the dictionary is not made larger than that. Return XZ_OK on success,
+ * XZ_MEMLIMIT_ERROR if the preallocated dictionary is not big enough, and
+ * XZ_OPTIONS_ERROR if props indicates something that this decoder doesn't
+ * support.
  */
 XZ_EXTERN enum xz_ret xz_dec_lzma2_reset(struct xz_dec_lzma2 *s,
-					 uint8_t props);
+					 uint8_t props, uint64_t uncompressed);
 
 /* Decode raw LZMA2 stream from b->in to b->out. */
 XZ_EXTERN enum xz_ret xz_dec_lzma2_run(struct xz_dec_lzma2 *s,